@@ -3,9 +3,14 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <search.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "cap2hccapx.h"
 
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 #define BIG_ENDIAN_HOST
@@ -57,6 +62,21 @@ typedef uint64_t u64;
 #define DLT_IEEE802_11_RADIO 127
 #define DLT_IEEE802_11_PPI_HDR 192
 
+// from the pcapng specification
+
+#define PCAPNG_BLOCK_TYPE_SHB 0x0a0d0d0a /* section header, a palindrome: the same in both byte orders */
+#define PCAPNG_BLOCK_TYPE_IDB 0x00000001 /* interface description */
+#define PCAPNG_BLOCK_TYPE_SPB 0x00000003 /* simple packet */
+#define PCAPNG_BLOCK_TYPE_EPB 0x00000006 /* enhanced packet */
+
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define PCAPNG_BYTE_ORDER_CIGAM 0x4d3c2b1a
+
+#define PCAPNG_OPT_ENDOFOPT   0
+#define PCAPNG_OPT_IF_TSRESOL 9
+
+#define PCAPNG_BLOCK_MAX (16 * 1024 * 1024) // sanity limit, far beyond any block holding a single frame
+
 struct pcap_file_header {
     u32 magic;
     u16 version_major;
@@ -177,6 +197,13 @@ typedef struct ieee80211_llc_snap_header ieee80211_llc_snap_header_t;
 #define WPA_KEY_INFO_REQUEST WBIT(11)
 #define WPA_KEY_INFO_ENCR_KEY_DATA WBIT(12) /* IEEE 802.11i/RSN only */
 
+// key data encapsulation (IEEE 802.11i)
+
+#define WPA_KEY_DATA_TYPE_KDE 0xdd
+#define RSN_KDE_OUI "\x00\x0f\xac"
+#define RSN_KDE_TYPE_PMKID 4
+#define PMKID_LEN 16
+
 // radiotap header from http://www.radiotap.org/
 
 struct ieee80211_radiotap_header {
@@ -356,42 +383,121 @@ typedef struct {
     u8 keyver;
     u8 keymic[16];
 
+    u8 pmkid[PMKID_LEN];
+
 } excpkt_t;
 
-// databases
+// databases, growable arrays kept in insertion order and indexed by open addressing hash tables
 
-#define DB_ESSID_MAX  50000
-#define DB_EXCPKT_MAX 100000
+#define DB_INITIAL_SIZE 1024
 
-essid_t *essids = NULL;
-lsearch_cnt_t essids_cnt = 0;
+typedef struct {
+    lsearch_cnt_t *slots; // position in the database + 1, 0 for an empty slot
+    lsearch_cnt_t mask;   // number of slots - 1, a power of 2 - 1
 
-excpkt_t *excpkts = NULL;
-lsearch_cnt_t excpkts_cnt = 0;
+} db_index_t;
 
-// output
+typedef struct {
+    essid_t *essids;
+    lsearch_cnt_t essids_cnt;
+    lsearch_cnt_t essids_size;
+    db_index_t essids_index;
 
-#define HCCAPX_VERSION   4
-#define HCCAPX_SIGNATURE 0x58504348 // HCPX
+    excpkt_t *excpkts;
+    lsearch_cnt_t excpkts_cnt;
+    lsearch_cnt_t excpkts_size;
+    db_index_t excpkts_index;
 
-struct hccapx {
-    u32 signature;
-    u32 version;
-    u8 message_pair;
-    u8 essid_len;
-    u8 essid[32];
-    u8 keyver;
-    u8 keymic[16];
-    u8 mac_ap[6];
-    u8 nonce_ap[32];
-    u8 mac_sta[6];
-    u8 nonce_sta[32];
-    u16 eapol_len;
-    u8 eapol[256];
+} db_t;
 
-} __attribute__((packed));
+// capture reader: regular files are memory mapped and the packets are processed in place, anything else (pipes,
+// character devices) is streamed through a single packet buffer
+
+typedef enum {
+    CAPTURE_FORMAT_PCAP = 0,
+    CAPTURE_FORMAT_PCAPNG = 1,
+
+} capture_format_t;
+
+typedef struct {
+    u32 linktype;
+    u64 tsresol; // timestamp units per second
+
+} pcapng_interface_t;
+
+typedef struct {
+    FILE *fp;
+    u8 *map;         // whole file, NULL when streaming
+    size_t map_size;
+    size_t offset;   // next byte of the mapping
+    u8 *buf;         // packet buffer when streaming
+    size_t buf_size;
+
+    int format;      // capture_format_t
+
+    // pcap: the file header
+
+    u32 linktype;
+    int bitness;     // 1 if written in the other byte order
 
-typedef struct hccapx hccapx_t;
+    // pcapng: the current section
+
+    int swap;        // 1 if written in the other byte order
+    pcapng_interface_t *interfaces;
+    u32 interfaces_cnt;
+    u32 interfaces_size;
+    u32 tv_sec;      // timestamp of the last enhanced packet, simple packets have none
+    u32 tv_usec;
+
+    // follow mode: the file is still being written, a record is only read once complete
+
+    int follow;
+    int incomplete;  // set when the reader stopped before an incomplete record
+
+} pcap_reader_t;
+
+// parser context, see cap2hccapx.h
+
+typedef enum {
+    FOLLOW_CLOSED = 0,
+    FOLLOW_HEADER = 1,  // opened, waiting for the file header
+    FOLLOW_RECORDS = 2,
+    FOLLOW_STOPPED = 3, // damaged record, nothing past it is read
+
+} follow_state_t;
+
+struct cap_ctx {
+    db_t db;     // the decoding threads fill databases of their own and merge them in
+    int threads;
+
+    // follow mode: the capture stays open between calls, which resume after the last complete record, and the
+    // handshakes already returned are remembered so that only new ones are returned
+
+    pcap_reader_t follow;
+    int follow_state; // follow_state_t
+
+    hccapx_t *returned;
+    lsearch_cnt_t returned_cnt;
+    lsearch_cnt_t returned_size;
+    db_index_t returned_index;
+};
+
+// decoding: the records of a mapped capture are indexed in batches by a sequential pass over their headers, then
+// decoded by threads filling databases of their own, merged in capture order
+
+#define DECODE_BATCH        (1 << 20) // records per batch
+#define DECODE_PARALLEL_MIN 4096      // records per thread, smaller batches are decoded sequentially
+
+typedef struct {
+    pcap_pkthdr_t header; // link layer header stripped
+    u8 *frame;
+
+} pcap_record_t;
+
+// output
+
+#define HCCAPX_VERSION   4
+#define HCCAPX_SIGNATURE 0x58504348 // HCPX
 
 // functions
 
@@ -457,6 +563,160 @@ int comp_excpkt(const void *p1, const void *p2) {
     return 0;
 }
 
+static int pcap_reader_open(pcap_reader_t *reader, const char *in) {
+    memset(reader, 0, sizeof(pcap_reader_t));
+
+    reader->fp = fopen(in, "rb");
+
+    if (reader->fp == NULL) return -1;
+
+    struct stat st;
+
+    if ((fstat(fileno(reader->fp), &st) == -1) || !S_ISREG(st.st_mode) || (st.st_size == 0)) return 0;
+
+    // private mapping: the big endian conversions write into the packets, the file itself is never modified
+
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(reader->fp), 0);
+
+    if (map == MAP_FAILED) return 0;
+
+    madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+    reader->map = (u8 *) map;
+    reader->map_size = (size_t) st.st_size;
+
+    return 0;
+}
+
+// copies the next len bytes (the file and record headers) into dst, returns 1 on success, 0 at end of file
+
+static int pcap_reader_read(pcap_reader_t *reader, void *dst, const size_t len) {
+    if (reader->map == NULL) return (fread(dst, len, 1, reader->fp) == 1) ? 1 : 0;
+
+    if (reader->map_size - reader->offset < len) {
+        reader->offset = reader->map_size;
+
+        return 0;
+    }
+
+    memcpy(dst, reader->map + reader->offset, len);
+
+    reader->offset += len;
+
+    return 1;
+}
+
+// returns the next len bytes (the packet data), pointing into the mapping or the packet buffer, NULL if truncated
+
+static u8 *pcap_reader_data(pcap_reader_t *reader, const size_t len) {
+    if (reader->map == NULL) {
+        if (len > reader->buf_size) {
+            u8 *buf = (u8 *) realloc(reader->buf, len);
+
+            if (buf == NULL) return NULL;
+
+            reader->buf = buf;
+            reader->buf_size = len;
+        }
+
+        if (fread(reader->buf, sizeof(u8), len, reader->fp) != len) return NULL;
+
+        return reader->buf;
+    }
+
+    if (reader->map_size - reader->offset < len) return NULL;
+
+    u8 *data = reader->map + reader->offset;
+
+    reader->offset += len;
+
+    return data;
+}
+
+// follow mode: maps the bytes appended to the file since it was last mapped, returns 0 on success, -1 on error
+
+static int pcap_reader_remap(pcap_reader_t *reader, const char *in) {
+    struct stat st;
+
+    if (fstat(fileno(reader->fp), &st) == -1) {
+        fprintf(stderr, "%s: %s\n", in, strerror(errno));
+
+        return -1;
+    }
+
+    const size_t size = (size_t) st.st_size;
+
+    if (size < reader->offset) {
+        fprintf(stderr, "%s: Capture truncated while being followed\n", in);
+
+        return -1;
+    }
+
+    if (size == reader->map_size) return 0;
+
+    if (reader->map != NULL) munmap(reader->map, reader->map_size);
+
+    reader->map = NULL;
+    reader->map_size = 0;
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(reader->fp), 0);
+
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", in, strerror(errno));
+
+        return -1;
+    }
+
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    reader->map = (u8 *) map;
+    reader->map_size = size;
+
+    return 0;
+}
+
+static void pcap_reader_close(pcap_reader_t *reader) {
+    if (reader->map != NULL) munmap(reader->map, reader->map_size);
+
+    if (reader->fp != NULL) fclose(reader->fp);
+
+    free(reader->buf);
+    free(reader->interfaces);
+
+    memset(reader, 0, sizeof(pcap_reader_t));
+}
+
+static int get_pmkid_from_kde(const u8 *key_data, const u16 key_data_len, u8 pmkid[PMKID_LEN]) {
+    const u8 *cur = key_data;
+    const u8 *end = key_data + key_data_len;
+
+    while ((cur + 2) <= end) {
+        const u8 kdetype = cur[0];
+        const u8 kdelen = cur[1];
+
+        cur += 2;
+
+        if ((cur + kdelen) > end) break;
+
+        // a zero pmkid is sent by some APs as a placeholder, it can't be cracked
+
+        if ((kdetype == WPA_KEY_DATA_TYPE_KDE) && (kdelen >= 4 + PMKID_LEN)
+            && (memcmp(cur, RSN_KDE_OUI, 3) == 0) && (cur[3] == RSN_KDE_TYPE_PMKID)) {
+            const u8 zero[PMKID_LEN] = {0};
+
+            if (memcmp(cur + 4, zero, PMKID_LEN) == 0) return -1;
+
+            memcpy(pmkid, cur + 4, PMKID_LEN);
+
+            return 0;
+        }
+
+        cur += kdelen;
+    }
+
+    return -1;
+}
+
 int comp_bssid(const void *p1, const void *p2) {
     essid_t *e1 = (essid_t *) p1;
     essid_t *e2 = (essid_t *) p2;
@@ -464,44 +724,163 @@ int comp_bssid(const void *p1, const void *p2) {
     return memcmp(e1->bssid, e2->bssid, 6);
 }
 
-static void
-db_excpkt_add(excpkt_t *excpkt, const u32 tv_sec, const u32 tv_usec, const u8 mac_ap[6], const u8 mac_sta[6]) {
-    if (essids_cnt == DB_EXCPKT_MAX) {
-        fprintf(stderr, "Too many excpkt in dumpfile, aborting...\n");
+// FNV-1a, chained over the fields of a key
+
+static u64 hash_fnv1a(const void *data, const size_t len, u64 hash) {
+    const u8 *ptr = (const u8 *) data;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= ptr[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+#define HASH_FNV1A_OFFSET 0xcbf29ce484222325ULL
+
+static u64 hash_essid(const essid_t *essid) {
+    return hash_fnv1a(essid->bssid, 6, HASH_FNV1A_OFFSET);
+}
+
+static u64 hash_excpkt(const excpkt_t *excpkt) {
+    u64 hash = HASH_FNV1A_OFFSET;
+
+    hash = hash_fnv1a(excpkt->mac_ap, 6, hash);
+    hash = hash_fnv1a(excpkt->mac_sta, 6, hash);
+    hash = hash_fnv1a(&excpkt->excpkt_num, sizeof(excpkt->excpkt_num), hash);
+    hash = hash_fnv1a(&excpkt->replay_counter, sizeof(excpkt->replay_counter), hash);
+
+    return hash;
+}
+
+// returns the slot holding the element equal to item, or the empty slot it has to be stored in
+
+static lsearch_cnt_t *db_index_find(const db_index_t *index, const void *item, const u64 hash, const void *base,
+                                    const size_t item_size, int (*comp)(const void *, const void *)) {
+    lsearch_cnt_t slot = (lsearch_cnt_t) hash & index->mask;
+
+    while (index->slots[slot] != 0) {
+        const void *stored = (const u8 *) base + (index->slots[slot] - 1) * item_size;
+
+        if (comp(item, stored) == 0) break;
+
+        slot = (slot + 1) & index->mask;
+    }
+
+    return &index->slots[slot];
+}
+
+// grows the array and its index so that one more element fits, keeping the index at most half full
+
+static void db_reserve(void **base, lsearch_cnt_t *size, const lsearch_cnt_t cnt, const size_t item_size,
+                       db_index_t *index, u64 (*hash)(const void *), int (*comp)(const void *, const void *)) {
+    if (cnt == *size) {
+        *size = (*size == 0) ? DB_INITIAL_SIZE : *size * 2;
+
+        void *base_new = realloc(*base, *size * item_size);
+
+        if (base_new == NULL) {
+            fprintf(stderr, "Not enough memory for the packets of the dumpfile, aborting...\n");
+
+            exit(-1);
+        }
+
+        *base = base_new;
+    }
+
+    if ((cnt + 1) * 2 <= index->mask + 1) return;
+
+    free(index->slots);
+
+    index->mask = (index->mask == 0) ? (DB_INITIAL_SIZE * 2 - 1) : (index->mask * 2 + 1);
+    index->slots = (lsearch_cnt_t *) calloc(index->mask + 1, sizeof(lsearch_cnt_t));
+
+    if (index->slots == NULL) {
+        fprintf(stderr, "Not enough memory for the packets of the dumpfile, aborting...\n");
 
         exit(-1);
     }
 
+    for (lsearch_cnt_t pos = 0; pos < cnt; pos++) {
+        const void *item = (const u8 *) *base + pos * item_size;
+
+        *db_index_find(index, item, hash(item), *base, item_size, comp) = pos + 1;
+    }
+}
+
+static u64 hash_essid_item(const void *item) {
+    return hash_essid((const essid_t *) item);
+}
+
+static u64 hash_excpkt_item(const void *item) {
+    return hash_excpkt((const excpkt_t *) item);
+}
+
+static void db_free(db_t *db) {
+    free(db->essids);
+    free(db->essids_index.slots);
+
+    db->essids = NULL;
+    db->essids_cnt = 0;
+    db->essids_size = 0;
+    db->essids_index.slots = NULL;
+    db->essids_index.mask = 0;
+
+    free(db->excpkts);
+    free(db->excpkts_index.slots);
+
+    db->excpkts = NULL;
+    db->excpkts_cnt = 0;
+    db->excpkts_size = 0;
+    db->excpkts_index.slots = NULL;
+    db->excpkts_index.mask = 0;
+}
+
+static void db_excpkt_add(db_t *db, excpkt_t *excpkt, const u32 tv_sec, const u32 tv_usec, const u8 mac_ap[6],
+                          const u8 mac_sta[6]) {
     excpkt->tv_sec = tv_sec;
     excpkt->tv_usec = tv_usec;
 
     memcpy(excpkt->mac_ap, mac_ap, 6);
     memcpy(excpkt->mac_sta, mac_sta, 6);
 
-    lsearch(excpkt, excpkts, &excpkts_cnt, sizeof(excpkt_t), comp_excpkt);
-}
+    db_reserve((void **) &db->excpkts, &db->excpkts_size, db->excpkts_cnt, sizeof(excpkt_t), &db->excpkts_index,
+               hash_excpkt_item, comp_excpkt);
 
-static void db_essid_add(essid_t *essid, const u8 addr3[6], const int essid_source) {
-    if (essids_cnt == DB_ESSID_MAX) {
-        fprintf(stderr, "Too many essid in dumpfile, aborting...\n");
+    // retransmissions are stored once, the nonce being part of the identity of a packet
 
-        exit(-1);
-    }
+    lsearch_cnt_t *slot = db_index_find(&db->excpkts_index, excpkt, hash_excpkt(excpkt), db->excpkts,
+                                        sizeof(excpkt_t), comp_excpkt);
+
+    if (*slot != 0) return;
+
+    memcpy(db->excpkts + db->excpkts_cnt, excpkt, sizeof(excpkt_t));
+
+    *slot = ++db->excpkts_cnt;
+}
 
+static void db_essid_add(db_t *db, essid_t *essid, const u8 addr3[6], const int essid_source) {
     if (essid->essid_len == 0) return;
 
     if (essid->essid[0] == 0) return;
 
     memcpy(essid->bssid, addr3, 6);
 
-    void *ptr = lfind(essid, essids, &essids_cnt, sizeof(essid_t), comp_bssid);
+    db_reserve((void **) &db->essids, &db->essids_size, db->essids_cnt, sizeof(essid_t), &db->essids_index,
+               hash_essid_item, comp_bssid);
+
+    lsearch_cnt_t *slot = db_index_find(&db->essids_index, essid, hash_essid(essid), db->essids, sizeof(essid_t),
+                                        comp_bssid);
 
-    if (ptr == NULL) {
+    if (*slot == 0) {
         essid->essid_source = essid_source;
 
-        lsearch(essid, essids, &essids_cnt, sizeof(essid_t), comp_bssid);
+        memcpy(db->essids + db->essids_cnt, essid, sizeof(essid_t));
+
+        *slot = ++db->essids_cnt;
     } else {
-        essid_t *essid_old = (essid_t *) ptr;
+        essid_t *essid_old = db->essids + (*slot - 1);
 
         if (essid_source > essid_old->essid_source) {
             memcpy(essid_old, essid, sizeof(essid_t));
@@ -511,6 +890,25 @@ static void db_essid_add(essid_t *essid, const u8 addr3[6], const int essid_sour
     }
 }
 
+// adds the elements of part as if its packets had been processed after the ones of db
+
+static void db_merge(db_t *db, const db_t *part) {
+    for (lsearch_cnt_t essids_pos = 0; essids_pos < part->essids_cnt; essids_pos++) {
+        essid_t essid = part->essids[essids_pos];
+
+        db_essid_add(db, &essid, part->essids[essids_pos].bssid, essid.essid_source);
+    }
+
+    for (lsearch_cnt_t excpkts_pos = 0; excpkts_pos < part->excpkts_cnt; excpkts_pos++) {
+        const excpkt_t *excpkt_part = part->excpkts + excpkts_pos;
+
+        excpkt_t excpkt = *excpkt_part;
+
+        db_excpkt_add(db, &excpkt, excpkt_part->tv_sec, excpkt_part->tv_usec, excpkt_part->mac_ap,
+                      excpkt_part->mac_sta);
+    }
+}
+
 static int handle_llc(const ieee80211_llc_snap_header_t *ieee80211_llc_snap_header) {
     if (ieee80211_llc_snap_header->dsap != IEEE80211_LLC_DSAP) return -1;
     if (ieee80211_llc_snap_header->ssap != IEEE80211_LLC_SSAP) return -1;
@@ -589,6 +987,12 @@ static int handle_auth(const auth_packet_t *auth_packet, const int pkt_offset, c
 
     excpkt->keyver = ap_key_information & WPA_KEY_INFO_TYPE_MASK;
 
+    // message 1 may carry the PMKID of the AP in its (unencrypted) key data
+
+    if ((excpkt_num == EXC_PKT_NUM_1) && ((ap_key_information & WPA_KEY_INFO_ENCR_KEY_DATA) == 0)) {
+        get_pmkid_from_kde((const u8 *) (auth_packet + 1), ap_wpa_key_data_length, excpkt->pmkid);
+    }
+
     if ((excpkt_num == EXC_PKT_NUM_3) || (excpkt_num == EXC_PKT_NUM_4)) {
         excpkt->replay_counter--;
     }
@@ -596,7 +1000,7 @@ static int handle_auth(const auth_packet_t *auth_packet, const int pkt_offset, c
     return 0;
 }
 
-static int get_essid_from_user(char *s, essid_t *essid) {
+static int get_essid_from_user(db_t *db, char *s, essid_t *essid) {
     char *man_essid = s;
     char *man_bssid = strchr(man_essid, ':');
 
@@ -641,7 +1045,7 @@ static int get_essid_from_user(char *s, essid_t *essid) {
     bssid[5] = hex_to_u8((u8 *) man_bssid);
     man_bssid += 2;
 
-    db_essid_add(essid, bssid, ESSID_SOURCE_USER);
+    db_essid_add(db, essid, bssid, ESSID_SOURCE_USER);
 
     return 0;
 }
@@ -680,7 +1084,7 @@ static int get_essid_from_tag(const u8 *packet, const pcap_pkthdr_t *header, u32
     return -1;
 }
 
-static void process_packet(const u8 *packet, const pcap_pkthdr_t *header) {
+static void process_packet(db_t *db, const u8 *packet, const pcap_pkthdr_t *header) {
     if (header->caplen < sizeof(ieee80211_hdr_3addr_t)) return;
 
     // our first header: ieee80211
@@ -711,7 +1115,7 @@ static void process_packet(const u8 *packet, const pcap_pkthdr_t *header) {
 
             if (rc_beacon == -1) return;
 
-            db_essid_add(&essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_BEACON);
+            db_essid_add(db, &essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_BEACON);
         } else if (stype == IEEE80211_STYPE_PROBE_REQ) {
             const u32 length_skip = sizeof(ieee80211_hdr_3addr_t);
 
@@ -719,7 +1123,7 @@ static void process_packet(const u8 *packet, const pcap_pkthdr_t *header) {
 
             if (rc_beacon == -1) return;
 
-            db_essid_add(&essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_PROBE);
+            db_essid_add(db, &essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_PROBE);
         } else if (stype == IEEE80211_STYPE_PROBE_RESP) {
             const u32 length_skip = sizeof(ieee80211_hdr_3addr_t) + sizeof(beacon_t);
 
@@ -727,7 +1131,7 @@ static void process_packet(const u8 *packet, const pcap_pkthdr_t *header) {
 
             if (rc_beacon == -1) return;
 
-            db_essid_add(&essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_PROBE);
+            db_essid_add(db, &essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_PROBE);
         } else if (stype == IEEE80211_STYPE_ASSOC_REQ) {
             const u32 length_skip = sizeof(ieee80211_hdr_3addr_t) + sizeof(assocreq_t);
 
@@ -735,7 +1139,7 @@ static void process_packet(const u8 *packet, const pcap_pkthdr_t *header) {
 
             if (rc_beacon == -1) return;
 
-            db_essid_add(&essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_ASSOC);
+            db_essid_add(db, &essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_ASSOC);
         } else if (stype == IEEE80211_STYPE_REASSOC_REQ) {
             const u32 length_skip = sizeof(ieee80211_hdr_3addr_t) + sizeof(reassocreq_t);
 
@@ -743,7 +1147,7 @@ static void process_packet(const u8 *packet, const pcap_pkthdr_t *header) {
 
             if (rc_beacon == -1) return;
 
-            db_essid_add(&essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_REASSOC);
+            db_essid_add(db, &essid, ieee80211_hdr_3addr->addr3, ESSID_SOURCE_REASSOC);
         }
     } else if ((frame_control & IEEE80211_FCTL_FTYPE) == IEEE80211_FTYPE_DATA) {
         // process header: ieee80211
@@ -801,429 +1205,1371 @@ static void process_packet(const u8 *packet, const pcap_pkthdr_t *header) {
         if (rc_auth == -1) return;
 
         if ((excpkt.excpkt_num == EXC_PKT_NUM_1) || (excpkt.excpkt_num == EXC_PKT_NUM_3)) {
-            db_excpkt_add(&excpkt, header->tv_sec, header->tv_usec, ieee80211_hdr_3addr->addr2,
+            db_excpkt_add(db, &excpkt, header->tv_sec, header->tv_usec, ieee80211_hdr_3addr->addr2,
                           ieee80211_hdr_3addr->addr1);
         } else if ((excpkt.excpkt_num == EXC_PKT_NUM_2) || (excpkt.excpkt_num == EXC_PKT_NUM_4)) {
-            db_excpkt_add(&excpkt, header->tv_sec, header->tv_usec, ieee80211_hdr_3addr->addr1,
+            db_excpkt_add(db, &excpkt, header->tv_sec, header->tv_usec, ieee80211_hdr_3addr->addr1,
                           ieee80211_hdr_3addr->addr2);
         }
     }
 }
 
-int cap2hccapx(int argc, char *argv[]) {
-    if ((argc != 3) && (argc != 4) && (argc != 5)) {
-        fprintf(stderr, "usage: %s input.pcap output.hccapx [filter by essid] [additional network essid:bssid]\n",
-                argv[0]);
-
-        return -1;
-    }
+typedef struct {
+    const pcap_record_t *records;
+    size_t records_cnt;
+    db_t db;
 
-    char *in = argv[1];
-    char *out = argv[2];
+} decode_worker_t;
 
-    char *essid_filter = NULL;
+static void *decode_worker(void *arg) {
+    decode_worker_t *worker = (decode_worker_t *) arg;
 
-    if (argc >= 4) essid_filter = argv[3];
+    for (size_t i = 0; i < worker->records_cnt; i++) {
+        process_packet(&worker->db, worker->records[i].frame, &worker->records[i].header);
+    }
 
-    // database initializations
+    return NULL;
+}
 
-    essids = (essid_t *) calloc(DB_ESSID_MAX, sizeof(essid_t));
-    essids_cnt = 0;
+// decodes a batch of records into db, with as many threads as the batch is worth
 
-    excpkts = (excpkt_t *) calloc(DB_EXCPKT_MAX, sizeof(excpkt_t));
-    excpkts_cnt = 0;
+static void decode_records(db_t *db, const pcap_record_t *records, const size_t records_cnt, const int threads) {
+    size_t workers_cnt = records_cnt / DECODE_PARALLEL_MIN;
 
-    // manual beacon
+    if (workers_cnt > (size_t) threads) workers_cnt = (size_t) threads;
 
-    if (argc >= 5) {
-        essid_t essid;
+    decode_worker_t *workers = (workers_cnt > 1) ? (decode_worker_t *) calloc(workers_cnt, sizeof(decode_worker_t))
+                                                 : NULL;
+    pthread_t *tids = (workers != NULL) ? (pthread_t *) calloc(workers_cnt, sizeof(pthread_t)) : NULL;
 
-        memset(&essid, 0, sizeof(essid_t));
+    if (tids == NULL) {
+        free(workers);
 
-        const int rc = get_essid_from_user(argv[4], &essid);
+        for (size_t i = 0; i < records_cnt; i++) process_packet(db, records[i].frame, &records[i].header);
 
-        if (rc == -1) return -1;
+        return;
     }
 
-    // start with pcap handling
+    // contiguous slices, so that merging the workers in order keeps the capture order
 
-    FILE *pcap = fopen(in, "rb");
+    size_t records_pos = 0;
 
-    if (pcap == NULL) {
-        fprintf(stderr, "%s: %s\n", in, strerror(errno));
-
-        return -1;
-    }
+    for (size_t i = 0; i < workers_cnt; i++) {
+        const size_t slice = (records_cnt - records_pos) / (workers_cnt - i);
 
-    // check pcap header
+        workers[i].records = records + records_pos;
+        workers[i].records_cnt = slice;
 
-    pcap_file_header_t pcap_file_header;
+        records_pos += slice;
 
-    const int nread = fread(&pcap_file_header, sizeof(pcap_file_header_t), 1, pcap);
+        // a thread that can't be started leaves its slice to the main thread
 
-    if (nread != 1) {
-        fprintf(stderr, "%s: Could not read pcap header\n", in);
+        if (pthread_create(&tids[i], NULL, decode_worker, &workers[i]) != 0) {
+            decode_worker(&workers[i]);
 
-        return -1;
+            workers[i].records = NULL;
+        }
     }
 
-#ifdef BIG_ENDIAN_HOST
-    pcap_file_header.magic          = byte_swap_32 (pcap_file_header.magic);
-  pcap_file_header.version_major  = byte_swap_16 (pcap_file_header.version_major);
-  pcap_file_header.version_minor  = byte_swap_16 (pcap_file_header.version_minor);
-  pcap_file_header.thiszone       = byte_swap_32 (pcap_file_header.thiszone);
-  pcap_file_header.sigfigs        = byte_swap_32 (pcap_file_header.sigfigs);
-  pcap_file_header.snaplen        = byte_swap_32 (pcap_file_header.snaplen);
-  pcap_file_header.linktype       = byte_swap_32 (pcap_file_header.linktype);
-#endif
-
-    int bitness = 0;
+    for (size_t i = 0; i < workers_cnt; i++) {
+        if (workers[i].records != NULL) pthread_join(tids[i], NULL);
 
-    if (pcap_file_header.magic == TCPDUMP_MAGIC) {
-        bitness = 0;
-    } else if (pcap_file_header.magic == TCPDUMP_CIGAM) {
-        bitness = 1;
-    } else {
-        fprintf(stderr, "%s: Invalid pcap header\n", in);
+        db_merge(db, &workers[i].db);
 
-        return 1;
+        db_free(&workers[i].db);
     }
 
-    if (bitness == 1) {
-        pcap_file_header.magic = byte_swap_32(pcap_file_header.magic);
-        pcap_file_header.version_major = byte_swap_16(pcap_file_header.version_major);
-        pcap_file_header.version_minor = byte_swap_16(pcap_file_header.version_minor);
-        pcap_file_header.thiszone = byte_swap_32(pcap_file_header.thiszone);
-        pcap_file_header.sigfigs = byte_swap_32(pcap_file_header.sigfigs);
-        pcap_file_header.snaplen = byte_swap_32(pcap_file_header.snaplen);
-        pcap_file_header.linktype = byte_swap_32(pcap_file_header.linktype);
-    }
+    free(tids);
+    free(workers);
+}
 
-    if ((pcap_file_header.linktype != DLT_IEEE802_11)
-        && (pcap_file_header.linktype != DLT_IEEE802_11_PRISM)
-        && (pcap_file_header.linktype != DLT_IEEE802_11_RADIO)
-        && (pcap_file_header.linktype != DLT_IEEE802_11_PPI_HDR)) {
-        fprintf(stderr, "%s: Unsupported linktype detected\n", in);
+// pairing index entry, see comp_excpkt_ref
 
-        return -1;
-    }
+typedef struct {
+    u8 mac_ap[6];
+    u8 mac_sta[6];
+    u32 tv_sec;
+    lsearch_cnt_t pos;
 
-    // walk the packets
+} excpkt_ref_t;
 
-    while (!feof(pcap)) {
-        pcap_pkthdr_t header;
+static int comp_excpkt_ref(const void *p1, const void *p2) {
+    const excpkt_ref_t *r1 = (const excpkt_ref_t *) p1;
+    const excpkt_ref_t *r2 = (const excpkt_ref_t *) p2;
 
-        const int nread1 = fread(&header, sizeof(pcap_pkthdr_t), 1, pcap);
+    const int rc_mac_ap = memcmp(r1->mac_ap, r2->mac_ap, 6);
 
-        if (nread1 != 1) continue;
+    if (rc_mac_ap != 0) return rc_mac_ap;
 
-#ifdef BIG_ENDIAN_HOST
-        header.tv_sec   = byte_swap_32 (header.tv_sec);
-    header.tv_usec  = byte_swap_32 (header.tv_usec);
-    header.caplen   = byte_swap_32 (header.caplen);
-    header.len      = byte_swap_32 (header.len);
-#endif
+    const int rc_mac_sta = memcmp(r1->mac_sta, r2->mac_sta, 6);
 
-        if (bitness == 1) {
-            header.tv_sec = byte_swap_32(header.tv_sec);
-            header.tv_usec = byte_swap_32(header.tv_usec);
-            header.caplen = byte_swap_32(header.caplen);
-            header.len = byte_swap_32(header.len);
-        }
+    if (rc_mac_sta != 0) return rc_mac_sta;
 
-        if ((header.tv_sec == 0) && (header.tv_usec == 0)) {
-            fprintf(stderr, "Zero value timestamps detected in file: %s.\n", in);
-            fprintf(stderr, "This prevents correct EAPOL-Key timeout calculation.\n");
-            fprintf(stderr, "Do not use preprocess the capture file with tools such as wpaclean.\n");
+    if (r1->tv_sec != r2->tv_sec) return (r1->tv_sec < r2->tv_sec) ? -1 : 1;
 
-            return -1;
-        }
+    if (r1->pos != r2->pos) return (r1->pos < r2->pos) ? -1 : 1;
 
-        u8 packet[TCPDUMP_DECODE_LEN];
+    return 0;
+}
 
-        if (header.caplen >= TCPDUMP_DECODE_LEN || (signed) header.caplen < 0) {
-            fprintf(stderr, "%s: Oversized packet detected\n", in);
+static int comp_pos(const void *p1, const void *p2) {
+    const lsearch_cnt_t pos1 = *(const lsearch_cnt_t *) p1;
+    const lsearch_cnt_t pos2 = *(const lsearch_cnt_t *) p2;
 
-            break;
-        }
+    return (pos1 < pos2) ? -1 : (pos1 > pos2);
+}
 
-        const u32 nread2 = fread(&packet, sizeof(u8), header.caplen, pcap);
+// first reference of [lo, hi) not sorted before key
 
-        if (nread2 != header.caplen) {
-            fprintf(stderr, "%s: Could not read pcap packet data\n", in);
+static lsearch_cnt_t excpkt_refs_lower_bound(const excpkt_ref_t *refs, lsearch_cnt_t lo, lsearch_cnt_t hi,
+                                             const excpkt_ref_t *key) {
+    while (lo < hi) {
+        const lsearch_cnt_t mid = lo + (hi - lo) / 2;
 
+        if (comp_excpkt_ref(refs + mid, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+// whether an earlier message 1 of the same AP/STA pair, within the AP references [ap_first, ap_last), carried the
+// same PMKID
+
+static int excpkt_pmkid_seen(const db_t *db, const excpkt_ref_t *refs, const lsearch_cnt_t ap_first,
+                             const lsearch_cnt_t ap_last, const lsearch_cnt_t excpkt_pos) {
+    const excpkt_t *excpkt = db->excpkts + excpkt_pos;
+
+    excpkt_ref_t key;
+
+    memset(&key, 0, sizeof(excpkt_ref_t));
+    memcpy(key.mac_ap, excpkt->mac_ap, 6);
+    memcpy(key.mac_sta, excpkt->mac_sta, 6);
+
+    for (lsearch_cnt_t ref_pos = excpkt_refs_lower_bound(refs, ap_first, ap_last, &key); ref_pos < ap_last;
+         ref_pos++) {
+        if (memcmp(refs[ref_pos].mac_sta, excpkt->mac_sta, 6) != 0) break;
+
+        if (refs[ref_pos].pos >= excpkt_pos) continue;
+
+        const excpkt_t *excpkt_old = db->excpkts + refs[ref_pos].pos;
+
+        if (excpkt_old->excpkt_num != EXC_PKT_NUM_1) continue;
+
+        if (memcmp(excpkt_old->pmkid, excpkt->pmkid, PMKID_LEN) != 0) continue;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+// builds the handshake made of an AP message and a station message, returns 1 if built, 0 if not exportable
+
+static int build_hccapx(hccapx_t *hccapx, const essid_t *essid, const excpkt_t *excpkt_ap, const excpkt_t *excpkt_sta,
+                        const int verbose) {
+    const bool valid_replay_counter = (excpkt_ap->replay_counter == excpkt_sta->replay_counter) ? true
+                                                                                                : false;
+
+    if (excpkt_ap->excpkt_num < excpkt_sta->excpkt_num) {
+        if (excpkt_ap->tv_sec > excpkt_sta->tv_sec) return 0;
+
+        if ((excpkt_ap->tv_sec + EAPOL_TTL) < excpkt_sta->tv_sec) return 0;
+    } else {
+        if (excpkt_sta->tv_sec > excpkt_ap->tv_sec) return 0;
+
+        if ((excpkt_sta->tv_sec + EAPOL_TTL) < excpkt_ap->tv_sec) return 0;
+    }
+
+    u8 message_pair = 255;
+
+    if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_1) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_2)) {
+        if (excpkt_sta->eapol_len > 0) {
+            message_pair = MESSAGE_PAIR_M12E2;
+        } else {
+            return 0;
+        }
+    } else if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_1) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_4)) {
+        if (excpkt_sta->eapol_len > 0) {
+            message_pair = MESSAGE_PAIR_M14E4;
+        } else {
+            return 0;
+        }
+    } else if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_3) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_2)) {
+        if (excpkt_sta->eapol_len > 0) {
+            message_pair = MESSAGE_PAIR_M32E2;
+        } else if (excpkt_ap->eapol_len > 0) {
+            message_pair = MESSAGE_PAIR_M32E3;
+        } else {
+            return 0;
+        }
+    } else if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_3) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_4)) {
+        if (excpkt_ap->eapol_len > 0) {
+            message_pair = MESSAGE_PAIR_M34E3;
+        } else if (excpkt_sta->eapol_len > 0) {
+            message_pair = MESSAGE_PAIR_M34E4;
+        } else {
+            return 0;
+        }
+    } else {
+        fprintf(stderr, "BUG!!! AP:%d STA:%d\n", excpkt_ap->excpkt_num, excpkt_sta->excpkt_num);
+    }
+
+    int export = 1;
+
+    switch (message_pair) {
+        case MESSAGE_PAIR_M32E3:
+            export = 0;
             break;
+        case MESSAGE_PAIR_M34E3:
+            export = 0;
+            break;
+    }
+
+    if ((verbose == 1) && (export == 1)) {
+        printf(" --> STA=%02x:%02x:%02x:%02x:%02x:%02x, Message Pair=%u, Replay Counter=%" PRIu64 "\n",
+               excpkt_sta->mac_sta[0],
+               excpkt_sta->mac_sta[1],
+               excpkt_sta->mac_sta[2],
+               excpkt_sta->mac_sta[3],
+               excpkt_sta->mac_sta[4],
+               excpkt_sta->mac_sta[5],
+               message_pair,
+               excpkt_sta->replay_counter);
+    } else if (verbose == 1) {
+        printf(" --> STA=%02x:%02x:%02x:%02x:%02x:%02x, Message Pair=%u [Skipped Export]\n",
+               excpkt_sta->mac_sta[0],
+               excpkt_sta->mac_sta[1],
+               excpkt_sta->mac_sta[2],
+               excpkt_sta->mac_sta[3],
+               excpkt_sta->mac_sta[4],
+               excpkt_sta->mac_sta[5],
+               message_pair);
+    }
+
+    if (export == 0) return 0;
+
+    // finally, build hccapx
+
+    memset(hccapx, 0, sizeof(hccapx_t));
+
+    hccapx->signature = HCCAPX_SIGNATURE;
+    hccapx->version = HCCAPX_VERSION;
+
+    hccapx->message_pair = message_pair;
+
+    if (valid_replay_counter == false) {
+        hccapx->message_pair |= 0x80;
+    }
+
+    hccapx->essid_len = essid->essid_len;
+    memcpy(hccapx->essid, essid->essid, 32);
+
+    memcpy(hccapx->mac_ap, excpkt_ap->mac_ap, 6);
+    memcpy(hccapx->nonce_ap, excpkt_ap->nonce, 32);
+
+    memcpy(hccapx->mac_sta, excpkt_sta->mac_sta, 6);
+    memcpy(hccapx->nonce_sta, excpkt_sta->nonce, 32);
+
+    if (excpkt_sta->eapol_len > 0) {
+        hccapx->keyver = excpkt_sta->keyver;
+        memcpy(hccapx->keymic, excpkt_sta->keymic, 16);
+
+        hccapx->eapol_len = excpkt_sta->eapol_len;
+        memcpy(hccapx->eapol, excpkt_sta->eapol, 256);
+    } else {
+        hccapx->keyver = excpkt_ap->keyver;
+        memcpy(hccapx->keymic, excpkt_ap->keymic, 16);
+
+        hccapx->eapol_len = excpkt_ap->eapol_len;
+        memcpy(hccapx->eapol, excpkt_ap->eapol, 256);
+    }
+
+    return 1;
+}
+
+// builds the PMKID of a message 1 as a handshake whose message pair is HCCAPX_MESSAGE_PAIR_PMKID and MIC the PMKID
+
+static void build_pmkid(hccapx_t *hccapx, const essid_t *essid, const excpkt_t *excpkt_ap, const int verbose) {
+    if (verbose == 1) {
+        printf(" --> STA=%02x:%02x:%02x:%02x:%02x:%02x, PMKID=",
+               excpkt_ap->mac_sta[0],
+               excpkt_ap->mac_sta[1],
+               excpkt_ap->mac_sta[2],
+               excpkt_ap->mac_sta[3],
+               excpkt_ap->mac_sta[4],
+               excpkt_ap->mac_sta[5]);
+
+        for (int i = 0; i < PMKID_LEN; i++) printf("%02x", excpkt_ap->pmkid[i]);
+
+        printf("\n");
+    }
+
+    memset(hccapx, 0, sizeof(hccapx_t));
+
+    hccapx->signature = HCCAPX_SIGNATURE;
+    hccapx->version = HCCAPX_VERSION;
+
+    hccapx->message_pair = HCCAPX_MESSAGE_PAIR_PMKID;
+
+    hccapx->essid_len = essid->essid_len;
+    memcpy(hccapx->essid, essid->essid, 32);
+
+    memcpy(hccapx->keymic, excpkt_ap->pmkid, PMKID_LEN);
+
+    memcpy(hccapx->mac_ap, excpkt_ap->mac_ap, 6);
+    memcpy(hccapx->mac_sta, excpkt_ap->mac_sta, 6);
+}
+
+// growable array of handshakes
+
+typedef struct {
+    hccapx_t *hccapx;
+    u32 cnt;
+    u32 size;
+
+} hccapx_list_t;
+
+static hccapx_t *hccapx_list_next(hccapx_list_t *list) {
+    if (list->cnt == list->size) {
+        const u32 size = (list->size == 0) ? 16 : list->size * 2;
+
+        hccapx_t *hccapx = (hccapx_t *) realloc(list->hccapx, size * sizeof(hccapx_t));
+
+        if (hccapx == NULL) {
+            fprintf(stderr, "Not enough memory for the handshakes of the dumpfile, aborting...\n");
+
+            exit(-1);
+        }
+
+        list->hccapx = hccapx;
+        list->size = size;
+    }
+
+    return list->hccapx + list->cnt;
+}
+
+void cap2hccapx_pmkid_filename(const char *out, char *out_pmkid, const size_t size) {
+    const size_t len = strlen(out);
+    const size_t ext_len = strlen(HCCAPX_EXTENSION);
+
+    if ((len > ext_len) && (strcmp(out + len - ext_len, HCCAPX_EXTENSION) == 0)) {
+        snprintf(out_pmkid, size, "%.*s%s", (int) (len - ext_len), out, PMKID_EXTENSION);
+    } else {
+        snprintf(out_pmkid, size, "%s%s", out, PMKID_EXTENSION);
+    }
+}
+
+static int linktype_supported(const u32 linktype) {
+    return (linktype == DLT_IEEE802_11)
+           || (linktype == DLT_IEEE802_11_PRISM)
+           || (linktype == DLT_IEEE802_11_RADIO)
+           || (linktype == DLT_IEEE802_11_PPI_HDR);
+}
+
+// follow mode: returns 1 if the next block (or record) of the mapping is complete, 0 if still being written; a
+// malformed length is reported as complete, so that the reader rejects it
+
+static int pcapng_block_available(const pcap_reader_t *pcap) {
+    const size_t left = pcap->map_size - pcap->offset;
+
+    u32 fields[3]; // block type, block total length, byte order magic of a section header
+
+    if (left < 8) return 0;
+
+    memcpy(fields, pcap->map + pcap->offset, 8);
+
+    int swap = pcap->swap;
+
+    if (fields[0] == PCAPNG_BLOCK_TYPE_SHB) {
+        if (left < 12) return 0;
+
+        memcpy(fields + 2, pcap->map + pcap->offset + 8, 4);
+
+        swap = (fields[2] == PCAPNG_BYTE_ORDER_CIGAM) ? 1 : 0;
+    }
+
+    const u32 block_len = (swap == 1) ? byte_swap_32(fields[1]) : fields[1];
+
+    return (block_len > PCAPNG_BLOCK_MAX) || (left >= block_len);
+}
+
+static int pcap_record_available(const pcap_reader_t *pcap) {
+    if (pcap->format == CAPTURE_FORMAT_PCAPNG) return pcapng_block_available(pcap);
+
+    const size_t left = pcap->map_size - pcap->offset;
+
+    pcap_pkthdr_t header;
+
+    if (left < sizeof(pcap_pkthdr_t)) return 0;
+
+    memcpy(&header, pcap->map + pcap->offset, sizeof(pcap_pkthdr_t));
+
+#ifdef BIG_ENDIAN_HOST
+    header.caplen = byte_swap_32 (header.caplen);
+#endif
+
+    if (pcap->bitness == 1) header.caplen = byte_swap_32(header.caplen);
+
+    return (header.caplen >= TCPDUMP_DECODE_LEN) || (left - sizeof(pcap_pkthdr_t) >= header.caplen);
+}
+
+// follow mode: returns 1 once the file header is complete
+
+static int pcap_header_available(const pcap_reader_t *pcap) {
+    u32 magic;
+
+    if (pcap->map_size < sizeof(magic)) return 0;
+
+    memcpy(&magic, pcap->map, sizeof(magic));
+
+    if (magic == PCAPNG_BLOCK_TYPE_SHB) return pcapng_block_available(pcap);
+
+    return pcap->map_size >= sizeof(pcap_file_header_t);
+}
+
+// pcap: reads the next record, returns 1 on success, 0 at the end of the capture or on a damaged record
+
+static int pcap_read_packet(pcap_reader_t *pcap, const char *in, pcap_pkthdr_t *header, u8 **packet, u32 *linktype) {
+    if ((pcap->follow == 1) && !pcap_record_available(pcap)) {
+        pcap->incomplete = 1;
+
+        return 0;
+    }
+
+    const int nread1 = pcap_reader_read(pcap, header, sizeof(pcap_pkthdr_t));
+
+    if (nread1 != 1) return 0;
+
+#ifdef BIG_ENDIAN_HOST
+    header->tv_sec   = byte_swap_32 (header->tv_sec);
+    header->tv_usec  = byte_swap_32 (header->tv_usec);
+    header->caplen   = byte_swap_32 (header->caplen);
+    header->len      = byte_swap_32 (header->len);
+#endif
+
+    if (pcap->bitness == 1) {
+        header->tv_sec = byte_swap_32(header->tv_sec);
+        header->tv_usec = byte_swap_32(header->tv_usec);
+        header->caplen = byte_swap_32(header->caplen);
+        header->len = byte_swap_32(header->len);
+    }
+
+    if (header->caplen >= TCPDUMP_DECODE_LEN || (signed) header->caplen < 0) {
+        fprintf(stderr, "%s: Oversized packet detected\n", in);
+
+        return 0;
+    }
+
+    *packet = pcap_reader_data(pcap, header->caplen);
+
+    if (*packet == NULL) {
+        fprintf(stderr, "%s: Could not read pcap packet data\n", in);
+
+        return 0;
+    }
+
+    *linktype = pcap->linktype;
+
+    return 1;
+}
+
+// pcapng: fields are in the byte order of their section, blocks and options are padded to 32 bits
+
+static u16 pcapng_16(const pcap_reader_t *pcap, const u8 *ptr) {
+    u16 v;
+
+    memcpy(&v, ptr, sizeof(u16));
+
+    return (pcap->swap == 1) ? byte_swap_16(v) : v;
+}
+
+static u32 pcapng_32(const pcap_reader_t *pcap, const u8 *ptr) {
+    u32 v;
+
+    memcpy(&v, ptr, sizeof(u32));
+
+    return (pcap->swap == 1) ? byte_swap_32(v) : v;
+}
+
+// reads the rest of a section header block, whose type has already been read, returns 0 on success, -1 if invalid
+
+static int pcapng_read_section(pcap_reader_t *pcap, const char *in) {
+    u32 fields[2]; // block total length, byte order magic
+
+    if (pcap_reader_read(pcap, fields, sizeof(fields)) != 1) {
+        fprintf(stderr, "%s: Could not read pcapng section header\n", in);
+
+        return -1;
+    }
+
+    if (fields[1] == PCAPNG_BYTE_ORDER_MAGIC) {
+        pcap->swap = 0;
+    } else if (fields[1] == PCAPNG_BYTE_ORDER_CIGAM) {
+        pcap->swap = 1;
+    } else {
+        fprintf(stderr, "%s: Invalid pcapng section header\n", in);
+
+        return -1;
+    }
+
+    const u32 block_len = (pcap->swap == 1) ? byte_swap_32(fields[0]) : fields[0];
+
+    if ((block_len < 28) || (block_len % 4 != 0) || (block_len > PCAPNG_BLOCK_MAX)
+        || (pcap_reader_data(pcap, block_len - 12) == NULL)) {
+        fprintf(stderr, "%s: Invalid pcapng section header\n", in);
+
+        return -1;
+    }
+
+    // interfaces are numbered per section
+
+    pcap->interfaces_cnt = 0;
+
+    return 0;
+}
+
+static int pcapng_add_interface(pcap_reader_t *pcap, const char *in, const u8 *body, const u32 body_len) {
+    if (pcap->interfaces_cnt == pcap->interfaces_size) {
+        const u32 size = (pcap->interfaces_size == 0) ? 4 : pcap->interfaces_size * 2;
+
+        pcapng_interface_t *interfaces = (pcapng_interface_t *) realloc(pcap->interfaces,
+                                                                        size * sizeof(pcapng_interface_t));
+
+        if (interfaces == NULL) return -1;
+
+        pcap->interfaces = interfaces;
+        pcap->interfaces_size = size;
+    }
+
+    pcapng_interface_t *interface = pcap->interfaces + pcap->interfaces_cnt;
+
+    interface->linktype = pcapng_16(pcap, body);
+    interface->tsresol = 1000000;
+
+    // if_tsresol: a power of 10, or of 2 if the most significant bit is set
+
+    for (u32 cur = 8; cur + 4 <= body_len;) {
+        const u16 code = pcapng_16(pcap, body + cur);
+        const u16 len = pcapng_16(pcap, body + cur + 2);
+
+        if ((code == PCAPNG_OPT_ENDOFOPT) || (cur + 4 + len > body_len)) break;
+
+        if ((code == PCAPNG_OPT_IF_TSRESOL) && (len >= 1)) {
+            const u8 tsresol = body[cur + 4];
+
+            if ((tsresol & 0x80) && ((tsresol & 0x7f) < 64)) {
+                interface->tsresol = 1ULL << (tsresol & 0x7f);
+            } else if (!(tsresol & 0x80) && (tsresol < 20)) {
+                interface->tsresol = 1;
+
+                for (int i = 0; i < tsresol; i++) interface->tsresol *= 10;
+            }
+        }
+
+        cur += 4 + ((len + 3) & ~3u);
+    }
+
+    if (!linktype_supported(interface->linktype)) {
+        fprintf(stderr, "%s: Unsupported linktype detected on interface %u, skipping its packets\n", in,
+                pcap->interfaces_cnt);
+    }
+
+    pcap->interfaces_cnt++;
+
+    return 0;
+}
+
+// pcapng: reads blocks up to the next packet of a supported interface, returns 1 on success, 0 at the end of the
+// capture or on a damaged block
+
+static int pcapng_read_packet(pcap_reader_t *pcap, const char *in, pcap_pkthdr_t *header, u8 **packet,
+                              u32 *linktype) {
+    while (1) {
+        u32 fields[2]; // block type, block total length
+
+        if ((pcap->follow == 1) && !pcap_record_available(pcap)) {
+            pcap->incomplete = 1;
+
+            return 0;
+        }
+
+        if (pcap_reader_read(pcap, fields, sizeof(fields[0])) != 1) return 0;
+
+        if (fields[0] == PCAPNG_BLOCK_TYPE_SHB) {
+            if (pcapng_read_section(pcap, in) == -1) return 0;
+
+            continue;
+        }
+
+        if (pcap_reader_read(pcap, fields + 1, sizeof(fields[1])) != 1) return 0;
+
+        const u32 block_type = (pcap->swap == 1) ? byte_swap_32(fields[0]) : fields[0];
+        const u32 block_len = (pcap->swap == 1) ? byte_swap_32(fields[1]) : fields[1];
+
+        if ((block_len < 12) || (block_len % 4 != 0) || (block_len > PCAPNG_BLOCK_MAX)) {
+            fprintf(stderr, "%s: Invalid pcapng block detected\n", in);
+
+            return 0;
+        }
+
+        u8 *body = pcap_reader_data(pcap, block_len - 8);
+
+        if (body == NULL) {
+            fprintf(stderr, "%s: Could not read pcapng block\n", in);
+
+            return 0;
+        }
+
+        const u32 body_len = block_len - 12; // without the trailing block total length
+
+        if (block_type == PCAPNG_BLOCK_TYPE_IDB) {
+            if (body_len < 8) {
+                fprintf(stderr, "%s: Invalid pcapng interface description\n", in);
+
+                return 0;
+            }
+
+            if (pcapng_add_interface(pcap, in, body, body_len) == -1) return 0;
+        } else if (block_type == PCAPNG_BLOCK_TYPE_EPB) {
+            if (body_len < 20) {
+                fprintf(stderr, "%s: Invalid pcapng enhanced packet\n", in);
+
+                return 0;
+            }
+
+            const u32 interface_id = pcapng_32(pcap, body);
+            const u64 ts = ((u64) pcapng_32(pcap, body + 4) << 32) | pcapng_32(pcap, body + 8);
+            const u32 caplen = pcapng_32(pcap, body + 12);
+
+            if ((interface_id >= pcap->interfaces_cnt) || (caplen > body_len - 20)) {
+                fprintf(stderr, "%s: Invalid pcapng enhanced packet\n", in);
+
+                return 0;
+            }
+
+            const pcapng_interface_t *interface = pcap->interfaces + interface_id;
+
+            const u64 frac = ts % interface->tsresol;
+
+            pcap->tv_sec = (u32) (ts / interface->tsresol);
+            pcap->tv_usec = (interface->tsresol >= 1000000) ? (u32) (frac / (interface->tsresol / 1000000))
+                                                            : (u32) (frac * 1000000 / interface->tsresol);
+
+            if (!linktype_supported(interface->linktype)) continue;
+
+            header->tv_sec = pcap->tv_sec;
+            header->tv_usec = pcap->tv_usec;
+            header->caplen = caplen;
+            header->len = pcapng_32(pcap, body + 16);
+
+            *packet = body + 20;
+            *linktype = interface->linktype;
+
+            return 1;
+        } else if (block_type == PCAPNG_BLOCK_TYPE_SPB) {
+            if ((body_len < 4) || (pcap->interfaces_cnt == 0)) {
+                fprintf(stderr, "%s: Invalid pcapng simple packet\n", in);
+
+                return 0;
+            }
+
+            if (!linktype_supported(pcap->interfaces[0].linktype)) continue;
+
+            const u32 len = pcapng_32(pcap, body);
+
+            // no timestamp: the one of the previous enhanced packet, or the smallest valid one
+
+            header->tv_sec = pcap->tv_sec;
+            header->tv_usec = ((pcap->tv_sec == 0) && (pcap->tv_usec == 0)) ? 1 : pcap->tv_usec;
+            header->caplen = (len < body_len - 4) ? len : body_len - 4;
+            header->len = len;
+
+            *packet = body + 4;
+            *linktype = pcap->interfaces[0].linktype;
+
+            return 1;
+        }
+
+        // any other block (name resolution, statistics, custom...) holds no frame
+    }
+}
+
+// reads the next record and strips its link layer header, returns 1 with the 802.11 frame in frame, 0 at the end of
+// the capture (or on the first damaged record), -1 if the capture can't be converted
+
+static int pcap_next_record(pcap_reader_t *pcap, const char *in, pcap_pkthdr_t *header, u8 **frame) {
+    u8 *packet;
+
+    u32 linktype;
+
+    const int rc_read = (pcap->format == CAPTURE_FORMAT_PCAPNG)
+                        ? pcapng_read_packet(pcap, in, header, &packet, &linktype)
+                        : pcap_read_packet(pcap, in, header, &packet, &linktype);
+
+    if (rc_read != 1) return rc_read;
+
+    if ((header->tv_sec == 0) && (header->tv_usec == 0)) {
+        fprintf(stderr, "Zero value timestamps detected in file: %s.\n", in);
+        fprintf(stderr, "This prevents correct EAPOL-Key timeout calculation.\n");
+        fprintf(stderr, "Do not use preprocess the capture file with tools such as wpaclean.\n");
+
+        return -1;
+    }
+
+    u8 *packet_ptr = packet;
+
+    if (linktype == DLT_IEEE802_11_PRISM) {
+        if (header->caplen < sizeof(prism_header_t)) {
+            fprintf(stderr, "%s: Could not read prism header\n", in);
+
+            return 0;
+        }
+
+        prism_header_t *prism_header = (prism_header_t *) packet;
+
+#ifdef BIG_ENDIAN_HOST
+        prism_header->msgcode = byte_swap_32 (prism_header->msgcode);
+        prism_header->msglen  = byte_swap_32 (prism_header->msglen);
+#endif
+
+        if ((signed) prism_header->msglen < 0) {
+            fprintf(stderr, "%s: Oversized packet detected\n", in);
+
+            return 0;
+        }
+
+        if ((signed) (header->caplen - prism_header->msglen) < 0) {
+            fprintf(stderr, "%s: Oversized packet detected\n", in);
+
+            return 0;
+        }
+
+        packet_ptr += prism_header->msglen;
+        header->caplen -= prism_header->msglen;
+        header->len -= prism_header->msglen;
+    } else if (linktype == DLT_IEEE802_11_RADIO) {
+        if (header->caplen < sizeof(ieee80211_radiotap_header_t)) {
+            fprintf(stderr, "%s: Could not read radiotap header\n", in);
+
+            return 0;
+        }
+
+        ieee80211_radiotap_header_t *ieee80211_radiotap_header = (ieee80211_radiotap_header_t *) packet;
+
+#ifdef BIG_ENDIAN_HOST
+        ieee80211_radiotap_header->it_len     = byte_swap_16 (ieee80211_radiotap_header->it_len);
+        ieee80211_radiotap_header->it_present = byte_swap_32 (ieee80211_radiotap_header->it_present);
+#endif
+
+        if (ieee80211_radiotap_header->it_version != 0) {
+            fprintf(stderr, "%s: Invalid radiotap header\n", in);
+
+            return 0;
         }
 
-        u8 *packet_ptr = packet;
+        // the frame points into the mapping: a damaged length must not make caplen wrap around
 
-        if (pcap_file_header.linktype == DLT_IEEE802_11_PRISM) {
-            if (header.caplen < sizeof(prism_header_t)) {
-                fprintf(stderr, "%s: Could not read prism header\n", in);
+        if (ieee80211_radiotap_header->it_len > header->caplen) {
+            fprintf(stderr, "%s: Oversized packet detected\n", in);
 
-                break;
-            }
+            return 0;
+        }
+
+        packet_ptr += ieee80211_radiotap_header->it_len;
+        header->caplen -= ieee80211_radiotap_header->it_len;
+        header->len -= ieee80211_radiotap_header->it_len;
+    } else if (linktype == DLT_IEEE802_11_PPI_HDR) {
+        if (header->caplen < sizeof(ppi_packet_header_t)) {
+            fprintf(stderr, "%s: Could not read ppi header\n", in);
 
-            prism_header_t *prism_header = (prism_header_t *) packet;
+            return 0;
+        }
+
+        ppi_packet_header_t *ppi_packet_header = (ppi_packet_header_t *) packet;
 
 #ifdef BIG_ENDIAN_HOST
-            prism_header->msgcode = byte_swap_32 (prism_header->msgcode);
-      prism_header->msglen  = byte_swap_32 (prism_header->msglen);
+        ppi_packet_header->pph_len    = byte_swap_16 (ppi_packet_header->pph_len);
 #endif
 
-            if ((signed) prism_header->msglen < 0) {
-                fprintf(stderr, "%s: Oversized packet detected\n", in);
+        if (ppi_packet_header->pph_len > header->caplen) {
+            fprintf(stderr, "%s: Oversized packet detected\n", in);
 
-                break;
-            }
+            return 0;
+        }
+
+        packet_ptr += ppi_packet_header->pph_len;
+        header->caplen -= ppi_packet_header->pph_len;
+        header->len -= ppi_packet_header->pph_len;
+    }
 
-            if ((signed) (header.caplen - prism_header->msglen) < 0) {
-                fprintf(stderr, "%s: Oversized packet detected\n", in);
+    *frame = packet_ptr;
 
-                break;
-            }
+    return 1;
+}
 
-            packet_ptr += prism_header->msglen;
-            header.caplen -= prism_header->msglen;
-            header.len -= prism_header->msglen;
-        } else if (pcap_file_header.linktype == DLT_IEEE802_11_RADIO) {
-            if (header.caplen < sizeof(ieee80211_radiotap_header_t)) {
-                fprintf(stderr, "%s: Could not read radiotap header\n", in);
+// reads the file header, returns 0 on success, -1 if the capture can't be converted
 
-                break;
-            }
+static int cap_read_header(pcap_reader_t *pcap, const char *in) {
+    // pcapng starts with a section header block, pcap with its own file header
+
+    pcap_file_header_t pcap_file_header;
 
-            ieee80211_radiotap_header_t *ieee80211_radiotap_header = (ieee80211_radiotap_header_t *) packet;
+    const int nread = pcap_reader_read(pcap, &pcap_file_header.magic, sizeof(pcap_file_header.magic));
+
+    if (nread != 1) {
+        fprintf(stderr, "%s: Could not read pcap header\n", in);
+
+        return -1;
+    }
+
+    if (pcap_file_header.magic == PCAPNG_BLOCK_TYPE_SHB) {
+        pcap->format = CAPTURE_FORMAT_PCAPNG;
+
+        if (pcapng_read_section(pcap, in) == -1) return -1;
+    } else {
+        const int nread_rest = pcap_reader_read(pcap, (u8 *) &pcap_file_header + sizeof(pcap_file_header.magic),
+                                                sizeof(pcap_file_header_t) - sizeof(pcap_file_header.magic));
+
+        if (nread_rest != 1) {
+            fprintf(stderr, "%s: Could not read pcap header\n", in);
+
+            return -1;
+        }
 
 #ifdef BIG_ENDIAN_HOST
-            ieee80211_radiotap_header->it_len     = byte_swap_16 (ieee80211_radiotap_header->it_len);
-      ieee80211_radiotap_header->it_present = byte_swap_32 (ieee80211_radiotap_header->it_present);
+        pcap_file_header.magic          = byte_swap_32 (pcap_file_header.magic);
+        pcap_file_header.version_major  = byte_swap_16 (pcap_file_header.version_major);
+        pcap_file_header.version_minor  = byte_swap_16 (pcap_file_header.version_minor);
+        pcap_file_header.thiszone       = byte_swap_32 (pcap_file_header.thiszone);
+        pcap_file_header.sigfigs        = byte_swap_32 (pcap_file_header.sigfigs);
+        pcap_file_header.snaplen        = byte_swap_32 (pcap_file_header.snaplen);
+        pcap_file_header.linktype       = byte_swap_32 (pcap_file_header.linktype);
 #endif
 
-            if (ieee80211_radiotap_header->it_version != 0) {
-                fprintf(stderr, "%s: Invalid radiotap header\n", in);
+        int bitness = 0;
+
+        if (pcap_file_header.magic == TCPDUMP_MAGIC) {
+            bitness = 0;
+        } else if (pcap_file_header.magic == TCPDUMP_CIGAM) {
+            bitness = 1;
+        } else {
+            fprintf(stderr, "%s: Invalid pcap header\n", in);
+
+            return -1;
+        }
+
+        if (bitness == 1) {
+            pcap_file_header.magic = byte_swap_32(pcap_file_header.magic);
+            pcap_file_header.version_major = byte_swap_16(pcap_file_header.version_major);
+            pcap_file_header.version_minor = byte_swap_16(pcap_file_header.version_minor);
+            pcap_file_header.thiszone = byte_swap_32(pcap_file_header.thiszone);
+            pcap_file_header.sigfigs = byte_swap_32(pcap_file_header.sigfigs);
+            pcap_file_header.snaplen = byte_swap_32(pcap_file_header.snaplen);
+            pcap_file_header.linktype = byte_swap_32(pcap_file_header.linktype);
+        }
+
+        if (!linktype_supported(pcap_file_header.linktype)) {
+            fprintf(stderr, "%s: Unsupported linktype detected\n", in);
+
+            return -1;
+        }
+
+        pcap->format = CAPTURE_FORMAT_PCAP;
+        pcap->linktype = pcap_file_header.linktype;
+        pcap->bitness = bitness;
+    }
+
+    return 0;
+}
+
+// reads the records of a capture into the databases of ctx, returns 0 at the end of the capture (or on the first
+// damaged record), -1 on error
+
+static int cap_walk(cap_ctx_t *ctx, pcap_reader_t *pcap, const char *in) {
+    // walk the packets: the records of a mapped capture are collected in batches, which are decoded in parallel
+
+    pcap_record_t *records = NULL;
+
+    if ((pcap->map != NULL) && (ctx->threads > 1)) {
+        records = (pcap_record_t *) malloc(DECODE_BATCH * sizeof(pcap_record_t));
+    }
+
+    int rc_record = 1;
+
+    while (rc_record == 1) {
+        if (records == NULL) {
+            pcap_pkthdr_t header;
+
+            u8 *frame;
+
+            rc_record = pcap_next_record(pcap, in, &header, &frame);
+
+            if (rc_record == 1) process_packet(&ctx->db, frame, &header);
+
+            continue;
+        }
+
+        size_t records_cnt = 0;
+
+        while (records_cnt < DECODE_BATCH) {
+            pcap_record_t *record = records + records_cnt;
+
+            rc_record = pcap_next_record(pcap, in, &record->header, &record->frame);
+
+            if (rc_record != 1) break;
+
+            records_cnt++;
+        }
+
+        if (rc_record == -1) break;
+
+        decode_records(&ctx->db, records, records_cnt, ctx->threads);
+    }
+
+    free(records);
+
+    return (rc_record == -1) ? -1 : 0;
+}
+
+// reads the packets of a capture into the databases of ctx, returns 0 on success, -1 on error
+
+static int cap_read(cap_ctx_t *ctx, const char *in) {
+    pcap_reader_t pcap;
+
+    if (pcap_reader_open(&pcap, in) == -1) {
+        fprintf(stderr, "%s: %s\n", in, strerror(errno));
+
+        return -1;
+    }
+
+    const int rc = ((cap_read_header(&pcap, in) == 0) && (cap_walk(ctx, &pcap, in) == 0)) ? 0 : -1;
+
+    pcap_reader_close(&pcap);
+
+    return rc;
+}
+
+// pairs the packets of the databases of ctx, PMKIDs follow the handshakes; verbose lists the networks and stations
+
+static hccapx_t *cap_pair(const cap_ctx_t *ctx, const char *essid_filter, const int verbose, uint32_t *hccapx_cnt) {
+    const db_t *db = &ctx->db;
+
+    hccapx_list_t handshakes = {NULL, 0, 0};
+    hccapx_list_t pmkids = {NULL, 0, 0};
+
+    // pair the packets: references sorted by (AP, STA, timestamp) make every AP/STA pair a contiguous bucket, so that
+    // every AP message is only matched against the station messages of its bucket within the EAPOL_TTL window
+
+    excpkt_ref_t *refs = (excpkt_ref_t *) calloc(db->excpkts_cnt + 1, sizeof(excpkt_ref_t));
+    lsearch_cnt_t *ap_poss = (lsearch_cnt_t *) calloc(db->excpkts_cnt + 1, sizeof(lsearch_cnt_t));
+    lsearch_cnt_t *sta_poss = (lsearch_cnt_t *) calloc(db->excpkts_cnt + 1, sizeof(lsearch_cnt_t));
+
+    if ((refs == NULL) || (ap_poss == NULL) || (sta_poss == NULL)) {
+        fprintf(stderr, "Not enough memory for the packets of the dumpfile, aborting...\n");
+
+        exit(-1);
+    }
+
+    for (lsearch_cnt_t excpkt_pos = 0; excpkt_pos < db->excpkts_cnt; excpkt_pos++) {
+        memcpy(refs[excpkt_pos].mac_ap, db->excpkts[excpkt_pos].mac_ap, 6);
+        memcpy(refs[excpkt_pos].mac_sta, db->excpkts[excpkt_pos].mac_sta, 6);
+
+        refs[excpkt_pos].tv_sec = db->excpkts[excpkt_pos].tv_sec;
+        refs[excpkt_pos].pos = excpkt_pos;
+    }
+
+    qsort(refs, db->excpkts_cnt, sizeof(excpkt_ref_t), comp_excpkt_ref);
+
+    for (lsearch_cnt_t essids_pos = 0; essids_pos < db->essids_cnt; essids_pos++) {
+        const essid_t *essid = db->essids + essids_pos;
+
+        if (essid_filter) if (strcmp(essid->essid, essid_filter)) continue;
+
+        if (verbose == 1) {
+            printf("[*] BSSID=%02x:%02x:%02x:%02x:%02x:%02x ESSID=%s (Length: %d)\n",
+                   essid->bssid[0],
+                   essid->bssid[1],
+                   essid->bssid[2],
+                   essid->bssid[3],
+                   essid->bssid[4],
+                   essid->bssid[5],
+                   essid->essid,
+                   essid->essid_len);
+        }
+
+        // the messages sent by the AP, in capture order
+
+        excpkt_ref_t key;
+
+        memset(&key, 0, sizeof(excpkt_ref_t));
+        memcpy(key.mac_ap, essid->bssid, 6);
+
+        const lsearch_cnt_t ap_first = excpkt_refs_lower_bound(refs, 0, db->excpkts_cnt, &key);
+
+        lsearch_cnt_t ap_last = ap_first;
+
+        while ((ap_last < db->excpkts_cnt) && (memcmp(refs[ap_last].mac_ap, essid->bssid, 6) == 0)) ap_last++;
+
+        lsearch_cnt_t ap_cnt = 0;
+
+        for (lsearch_cnt_t ref_pos = ap_first; ref_pos < ap_last; ref_pos++) {
+            const excpkt_t *excpkt = db->excpkts + refs[ref_pos].pos;
+
+            if ((excpkt->excpkt_num != EXC_PKT_NUM_1) && (excpkt->excpkt_num != EXC_PKT_NUM_3)) continue;
+
+            ap_poss[ap_cnt++] = refs[ref_pos].pos;
+        }
+
+        qsort(ap_poss, ap_cnt, sizeof(lsearch_cnt_t), comp_pos);
+
+        for (lsearch_cnt_t ap_idx = 0; ap_idx < ap_cnt; ap_idx++) {
+            const excpkt_t *excpkt_ap = db->excpkts + ap_poss[ap_idx];
 
-                break;
+            // the messages sent by the station within EAPOL_TTL seconds, in capture order
+
+            memcpy(key.mac_sta, excpkt_ap->mac_sta, 6);
+
+            key.tv_sec = (excpkt_ap->tv_sec > EAPOL_TTL) ? (excpkt_ap->tv_sec - EAPOL_TTL) : 0;
+
+            lsearch_cnt_t sta_cnt = 0;
+
+            for (lsearch_cnt_t ref_pos = excpkt_refs_lower_bound(refs, ap_first, ap_last, &key); ref_pos < ap_last;
+                 ref_pos++) {
+                if (memcmp(refs[ref_pos].mac_sta, excpkt_ap->mac_sta, 6) != 0) break;
+
+                if ((u64) refs[ref_pos].tv_sec > (u64) excpkt_ap->tv_sec + EAPOL_TTL) break;
+
+                const excpkt_t *excpkt = db->excpkts + refs[ref_pos].pos;
+
+                if ((excpkt->excpkt_num != EXC_PKT_NUM_2) && (excpkt->excpkt_num != EXC_PKT_NUM_4)) continue;
+
+                sta_poss[sta_cnt++] = refs[ref_pos].pos;
             }
 
-            packet_ptr += ieee80211_radiotap_header->it_len;
-            header.caplen -= ieee80211_radiotap_header->it_len;
-            header.len -= ieee80211_radiotap_header->it_len;
-        } else if (pcap_file_header.linktype == DLT_IEEE802_11_PPI_HDR) {
-            if (header.caplen < sizeof(ppi_packet_header_t)) {
-                fprintf(stderr, "%s: Could not read ppi header\n", in);
+            qsort(sta_poss, sta_cnt, sizeof(lsearch_cnt_t), comp_pos);
 
-                break;
+            for (lsearch_cnt_t sta_idx = 0; sta_idx < sta_cnt; sta_idx++) {
+                handshakes.cnt += build_hccapx(hccapx_list_next(&handshakes), essid, excpkt_ap,
+                                               db->excpkts + sta_poss[sta_idx], verbose);
             }
+        }
 
-            ppi_packet_header_t *ppi_packet_header = (ppi_packet_header_t *) packet;
+        // a PMKID needs no client message, message 1 alone is enough
 
-#ifdef BIG_ENDIAN_HOST
-            ppi_packet_header->pph_len    = byte_swap_16 (ppi_packet_header->pph_len);
-#endif
+        for (lsearch_cnt_t ap_idx = 0; ap_idx < ap_cnt; ap_idx++) {
+            const excpkt_t *excpkt_ap = db->excpkts + ap_poss[ap_idx];
+
+            const u8 zero[PMKID_LEN] = {0};
+
+            if (excpkt_ap->excpkt_num != EXC_PKT_NUM_1) continue;
+
+            if (memcmp(excpkt_ap->pmkid, zero, PMKID_LEN) == 0) continue;
+
+            // retransmissions of message 1 carry the same PMKID
+
+            if (excpkt_pmkid_seen(db, refs, ap_first, ap_last, ap_poss[ap_idx])) continue;
 
-            packet_ptr += ppi_packet_header->pph_len;
-            header.caplen -= ppi_packet_header->pph_len;
-            header.len -= ppi_packet_header->pph_len;
+            build_pmkid(hccapx_list_next(&pmkids), essid, excpkt_ap, verbose);
+
+            pmkids.cnt++;
         }
+    }
+
+    free(refs);
+    free(ap_poss);
+    free(sta_poss);
+
+    // the array is returned even without handshakes, NULL being reserved to errors
+
+    for (u32 i = 0; i < pmkids.cnt; i++) {
+        *hccapx_list_next(&handshakes) = pmkids.hccapx[i];
+
+        handshakes.cnt++;
+    }
+
+    free(pmkids.hccapx);
+
+    if (handshakes.hccapx == NULL) hccapx_list_next(&handshakes);
+
+    *hccapx_cnt = handshakes.cnt;
+
+    return handshakes.hccapx;
+}
+
+cap_ctx_t *cap_ctx_new(const uint32_t threads) {
+    cap_ctx_t *ctx = (cap_ctx_t *) calloc(1, sizeof(cap_ctx_t));
+
+    if (ctx == NULL) return NULL;
+
+    ctx->threads = (threads > 0) ? (int) threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    return ctx;
+}
+
+void cap_ctx_free(cap_ctx_t *ctx) {
+    if (ctx == NULL) return;
+
+    db_free(&ctx->db);
+
+    pcap_reader_close(&ctx->follow);
+
+    free(ctx->returned);
+    free(ctx->returned_index.slots);
+
+    free(ctx);
+}
+
+int cap_add_network(cap_ctx_t *ctx, const char *network) {
+    char s[MAX_ESSID_LEN + 1 + 12 + 1 + 1];
 
-        process_packet(packet_ptr, &header);
+    essid_t essid;
+
+    memset(&essid, 0, sizeof(essid_t));
+
+    if (strlen(network) >= sizeof(s)) {
+        fprintf(stderr, "Invalid format (%s), should be: MyESSID:d110391a58ac\n", network);
+
+        return -1;
     }
 
-    fclose(pcap);
+    strcpy(s, network);
+
+    return get_essid_from_user(&ctx->db, s, &essid);
+}
+
+hccapx_t *cap_parse(cap_ctx_t *ctx, const char *path, const char *essid_filter, uint32_t *hccapx_cnt) {
+    if (cap_read(ctx, path) == -1) return NULL;
 
     // inform the user
 
-    printf("Networks detected: %d\n", (int) essids_cnt);
+    printf("Networks detected: %d\n", (int) ctx->db.essids_cnt);
     printf("\n");
 
-    if (essids_cnt == 0) return 0;
+    return cap_pair(ctx, essid_filter, 1, hccapx_cnt);
+}
+
+static u64 hash_hccapx_item(const void *item) {
+    return hash_fnv1a(item, sizeof(hccapx_t), HASH_FNV1A_OFFSET);
+}
+
+static int comp_hccapx(const void *p1, const void *p2) {
+    return memcmp(p1, p2, sizeof(hccapx_t));
+}
+
+hccapx_t *cap_follow(cap_ctx_t *ctx, const char *path, const char *essid_filter, uint32_t *hccapx_cnt) {
+    pcap_reader_t *pcap = &ctx->follow;
+
+    if (ctx->follow_state == FOLLOW_CLOSED) {
+        struct stat st;
+
+        if (stat(path, &st) == -1) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+
+            return NULL;
+        }
+
+        // a pipe can't be mapped again once grown, its records are only available to cap_parse
+
+        if (!S_ISREG(st.st_mode)) {
+            fprintf(stderr, "%s: Only regular files can be followed\n", path);
+
+            return NULL;
+        }
+
+        if (pcap_reader_open(pcap, path) == -1) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+
+            return NULL;
+        }
+
+        pcap->follow = 1;
+
+        ctx->follow_state = FOLLOW_HEADER;
+    }
+
+    if (pcap_reader_remap(pcap, path) == -1) return NULL;
+
+    if ((ctx->follow_state == FOLLOW_HEADER) && pcap_header_available(pcap)) {
+        if (cap_read_header(pcap, path) == -1) return NULL;
+
+        ctx->follow_state = FOLLOW_RECORDS;
+    }
+
+    if (ctx->follow_state == FOLLOW_RECORDS) {
+        if (cap_walk(ctx, pcap, path) == -1) return NULL;
+
+        // stopped before a record still being written, or for good on a damaged one
+
+        if (pcap->incomplete == 0) {
+            fprintf(stderr, "%s: Damaged record, the rest of the capture is not followed\n", path);
+
+            ctx->follow_state = FOLLOW_STOPPED;
+        }
+
+        pcap->incomplete = 0;
+    }
+
+    // pair again: a message appended may complete a handshake with one parsed by an earlier call
+
+    uint32_t paired_cnt;
 
-    // prepare output files
+    hccapx_t *hccapx = cap_pair(ctx, essid_filter, 0, &paired_cnt);
+
+    u32 new_cnt = 0;
+
+    for (u32 i = 0; i < paired_cnt; i++) {
+        db_reserve((void **) &ctx->returned, &ctx->returned_size, ctx->returned_cnt, sizeof(hccapx_t),
+                   &ctx->returned_index, hash_hccapx_item, comp_hccapx);
+
+        lsearch_cnt_t *slot = db_index_find(&ctx->returned_index, hccapx + i, hash_hccapx_item(hccapx + i),
+                                            ctx->returned, sizeof(hccapx_t), comp_hccapx);
+
+        if (*slot != 0) continue;
+
+        ctx->returned[ctx->returned_cnt] = hccapx[i];
+
+        *slot = ++ctx->returned_cnt;
+
+        hccapx[new_cnt++] = hccapx[i];
+    }
+
+    *hccapx_cnt = new_cnt;
+
+    return hccapx;
+}
+
+int cap2hccapx(int argc, char *argv[]) {
+    if ((argc != 3) && (argc != 4) && (argc != 5)) {
+        fprintf(stderr, "usage: %s input.pcap output.hccapx [filter by essid] [additional network essid:bssid]\n",
+                argv[0]);
+
+        return -1;
+    }
+
+    char *in = argv[1];
+    char *out = argv[2];
+
+    char *essid_filter = NULL;
+
+    if (argc >= 4) essid_filter = argv[3];
+
+    cap_ctx_t *ctx = cap_ctx_new(0);
+
+    if (ctx == NULL) {
+        fprintf(stderr, "Not enough memory for the packets of the dumpfile, aborting...\n");
+
+        return -1;
+    }
+
+    // manual beacon
+
+    if ((argc >= 5) && (cap_add_network(ctx, argv[4]) == -1)) {
+        cap_ctx_free(ctx);
+
+        return -1;
+    }
+
+    uint32_t hccapx_cnt = 0;
+
+    hccapx_t *hccapx = cap_parse(ctx, in, essid_filter, &hccapx_cnt);
+
+    const lsearch_cnt_t essids_cnt = ctx->db.essids_cnt;
+
+    cap_ctx_free(ctx);
+
+    if (hccapx == NULL) return -1;
+
+    if (essids_cnt == 0) {
+        free(hccapx);
+
+        return 0;
+    }
+
+    // output files
 
     FILE *fp = fopen(out, "wb");
 
     if (fp == NULL) {
         fprintf(stderr, "%s: %s\n", out, strerror(errno));
 
+        free(hccapx);
+
         return -1;
     }
 
     int written = 0;
 
-    // find matching packets
+    // PMKIDs go to a separate file, in the hashcat -m 16800 format: PMKID*MAC_AP*MAC_STA*ESSID (hex)
 
-    for (lsearch_cnt_t essids_pos = 0; essids_pos < essids_cnt; essids_pos++) {
-        const essid_t *essid = essids + essids_pos;
+    char out_pmkid[PMKID_FILENAME_MAX];
 
-        if (essid_filter) if (strcmp(essid->essid, essid_filter)) continue;
+    cap2hccapx_pmkid_filename(out, out_pmkid, sizeof(out_pmkid));
 
-        printf("[*] BSSID=%02x:%02x:%02x:%02x:%02x:%02x ESSID=%s (Length: %d)\n",
-               essid->bssid[0],
-               essid->bssid[1],
-               essid->bssid[2],
-               essid->bssid[3],
-               essid->bssid[4],
-               essid->bssid[5],
-               essid->essid,
-               essid->essid_len);
-
-        for (lsearch_cnt_t excpkt_ap_pos = 0; excpkt_ap_pos < excpkts_cnt; excpkt_ap_pos++) {
-            const excpkt_t *excpkt_ap = excpkts + excpkt_ap_pos;
-
-            if ((excpkt_ap->excpkt_num != EXC_PKT_NUM_1) && (excpkt_ap->excpkt_num != EXC_PKT_NUM_3)) continue;
-
-            if (memcmp(essid->bssid, excpkt_ap->mac_ap, 6) != 0) continue;
-
-            for (lsearch_cnt_t excpkt_sta_pos = 0; excpkt_sta_pos < excpkts_cnt; excpkt_sta_pos++) {
-                const excpkt_t *excpkt_sta = excpkts + excpkt_sta_pos;
-
-                if ((excpkt_sta->excpkt_num != EXC_PKT_NUM_2) && (excpkt_sta->excpkt_num != EXC_PKT_NUM_4)) continue;
-
-                if (memcmp(excpkt_ap->mac_ap, excpkt_sta->mac_ap, 6) != 0) continue;
-                if (memcmp(excpkt_ap->mac_sta, excpkt_sta->mac_sta, 6) != 0) continue;
-
-                const bool valid_replay_counter = (excpkt_ap->replay_counter == excpkt_sta->replay_counter) ? true
-                                                                                                            : false;
-
-                if (excpkt_ap->excpkt_num < excpkt_sta->excpkt_num) {
-                    if (excpkt_ap->tv_sec > excpkt_sta->tv_sec) continue;
-
-                    if ((excpkt_ap->tv_sec + EAPOL_TTL) < excpkt_sta->tv_sec) continue;
-                } else {
-                    if (excpkt_sta->tv_sec > excpkt_ap->tv_sec) continue;
-
-                    if ((excpkt_sta->tv_sec + EAPOL_TTL) < excpkt_ap->tv_sec) continue;
-                }
-
-                u8 message_pair = 255;
-
-                if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_1) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_2)) {
-                    if (excpkt_sta->eapol_len > 0) {
-                        message_pair = MESSAGE_PAIR_M12E2;
-                    } else {
-                        continue;
-                    }
-                } else if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_1) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_4)) {
-                    if (excpkt_sta->eapol_len > 0) {
-                        message_pair = MESSAGE_PAIR_M14E4;
-                    } else {
-                        continue;
-                    }
-                } else if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_3) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_2)) {
-                    if (excpkt_sta->eapol_len > 0) {
-                        message_pair = MESSAGE_PAIR_M32E2;
-                    } else if (excpkt_ap->eapol_len > 0) {
-                        message_pair = MESSAGE_PAIR_M32E3;
-                    } else {
-                        continue;
-                    }
-                } else if ((excpkt_ap->excpkt_num == EXC_PKT_NUM_3) && (excpkt_sta->excpkt_num == EXC_PKT_NUM_4)) {
-                    if (excpkt_ap->eapol_len > 0) {
-                        message_pair = MESSAGE_PAIR_M34E3;
-                    } else if (excpkt_sta->eapol_len > 0) {
-                        message_pair = MESSAGE_PAIR_M34E4;
-                    } else {
-                        continue;
-                    }
-                } else {
-                    fprintf(stderr, "BUG!!! AP:%d STA:%d\n", excpkt_ap->excpkt_num, excpkt_sta->excpkt_num);
-                }
-
-                int export = 1;
-
-                switch (message_pair) {
-                    case MESSAGE_PAIR_M32E3:
-                        export = 0;
-                        break;
-                    case MESSAGE_PAIR_M34E3:
-                        export = 0;
-                        break;
-                }
-
-                if (export == 1) {
-                    printf(" --> STA=%02x:%02x:%02x:%02x:%02x:%02x, Message Pair=%u, Replay Counter=%" PRIu64 "\n",
-                           excpkt_sta->mac_sta[0],
-                           excpkt_sta->mac_sta[1],
-                           excpkt_sta->mac_sta[2],
-                           excpkt_sta->mac_sta[3],
-                           excpkt_sta->mac_sta[4],
-                           excpkt_sta->mac_sta[5],
-                           message_pair,
-                           excpkt_sta->replay_counter);
-                } else {
-                    printf(" --> STA=%02x:%02x:%02x:%02x:%02x:%02x, Message Pair=%u [Skipped Export]\n",
-                           excpkt_sta->mac_sta[0],
-                           excpkt_sta->mac_sta[1],
-                           excpkt_sta->mac_sta[2],
-                           excpkt_sta->mac_sta[3],
-                           excpkt_sta->mac_sta[4],
-                           excpkt_sta->mac_sta[5],
-                           message_pair);
-
-                    continue;
-                }
-
-                // finally, write hccapx
-
-                hccapx_t hccapx;
-
-                memset(&hccapx, 0, sizeof(hccapx));
-
-                hccapx.signature = HCCAPX_SIGNATURE;
-                hccapx.version = HCCAPX_VERSION;
-
-                hccapx.message_pair = message_pair;
-
-                if (valid_replay_counter == false) {
-                    hccapx.message_pair |= 0x80;
-                }
-
-                hccapx.essid_len = essid->essid_len;
-                memcpy(&hccapx.essid, essid->essid, 32);
-
-                memcpy(&hccapx.mac_ap, excpkt_ap->mac_ap, 6);
-                memcpy(&hccapx.nonce_ap, excpkt_ap->nonce, 32);
-
-                memcpy(&hccapx.mac_sta, excpkt_sta->mac_sta, 6);
-                memcpy(&hccapx.nonce_sta, excpkt_sta->nonce, 32);
-
-                if (excpkt_sta->eapol_len > 0) {
-                    hccapx.keyver = excpkt_sta->keyver;
-                    memcpy(&hccapx.keymic, excpkt_sta->keymic, 16);
-
-                    hccapx.eapol_len = excpkt_sta->eapol_len;
-                    memcpy(&hccapx.eapol, excpkt_sta->eapol, 256);
-                } else {
-                    hccapx.keyver = excpkt_ap->keyver;
-                    memcpy(&hccapx.keymic, excpkt_ap->keymic, 16);
-
-                    hccapx.eapol_len = excpkt_ap->eapol_len;
-                    memcpy(&hccapx.eapol, excpkt_ap->eapol, 256);
-                }
+    remove(out_pmkid);
 
+    FILE *fp_pmkid = NULL;
+
+    int written_pmkid = 0;
+
+    for (uint32_t i = 0; i < hccapx_cnt; i++) {
+        hccapx_t *cur = hccapx + i;
+
+        if (cur->message_pair != HCCAPX_MESSAGE_PAIR_PMKID) {
 #ifdef BIG_ENDIAN_HOST
-                hccapx.signature  = byte_swap_32 (hccapx.signature);
-                hccapx.version    = byte_swap_32 (hccapx.version);
-                hccapx.eapol_len  = byte_swap_16 (hccapx.eapol_len);
+            cur->signature  = byte_swap_32 (cur->signature);
+            cur->version    = byte_swap_32 (cur->version);
+            cur->eapol_len  = byte_swap_16 (cur->eapol_len);
 #endif
 
-                fwrite(&hccapx, sizeof(hccapx_t), 1, fp);
+            fwrite(cur, sizeof(hccapx_t), 1, fp);
+
+            written++;
+
+            continue;
+        }
+
+        if (fp_pmkid == NULL) {
+            fp_pmkid = fopen(out_pmkid, "w");
+
+            if (fp_pmkid == NULL) {
+                fprintf(stderr, "%s: %s\n", out_pmkid, strerror(errno));
 
-                written++;
+                fclose(fp);
+
+                free(hccapx);
+
+                return -1;
             }
         }
+
+        for (int j = 0; j < PMKID_LEN; j++) fprintf(fp_pmkid, "%02x", cur->keymic[j]);
+        fprintf(fp_pmkid, "*");
+        for (int j = 0; j < 6; j++) fprintf(fp_pmkid, "%02x", cur->mac_ap[j]);
+        fprintf(fp_pmkid, "*");
+        for (int j = 0; j < 6; j++) fprintf(fp_pmkid, "%02x", cur->mac_sta[j]);
+        fprintf(fp_pmkid, "*");
+        for (int j = 0; j < cur->essid_len; j++) fprintf(fp_pmkid, "%02x", cur->essid[j]);
+        fprintf(fp_pmkid, "\n");
+
+        written_pmkid++;
     }
 
+    free(hccapx);
+
     printf("\n");
     printf("Written %d WPA Handshakes to: %s\n", written, out);
 
-    fclose(fp);
+    if (fp_pmkid) {
+        printf("Written %d PMKIDs to: %s\n", written_pmkid, out_pmkid);
 
-    // clean up
+        fclose(fp_pmkid);
+    }
 
-    free(excpkts);
-    free(essids);
+    fclose(fp);
 
     return 0;
 }
@@ -2,9 +2,17 @@
 #define WPA2_CAP2HCCAPX
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define MAX_ESSID_LENGTH    32
 
+#define HCCAPX_EXTENSION    ".hccapx"
+
+/* PMKIDs are written apart, in the hashcat -m 16800 format, and loaded as hccapx with this message pair */
+#define PMKID_EXTENSION     ".16800"
+#define PMKID_FILENAME_MAX  4096
+#define HCCAPX_MESSAGE_PAIR_PMKID 0x07
+
 struct hccapx {
     uint32_t signature;
     uint32_t version;
@@ -22,8 +30,35 @@ struct hccapx {
 
 } __attribute__((packed));
 
+typedef struct hccapx hccapx_t;
+
+/*
+ * Reentrant parser: everything learnt from the captures parsed with a context (networks, EAPOL messages) lives in the
+ * context, so that captures can be parsed concurrently with a context each. Handshakes are returned in host byte
+ * order, PMKIDs after them as hccapx structs whose message pair is HCCAPX_MESSAGE_PAIR_PMKID and MIC the PMKID.
+ */
+typedef struct cap_ctx cap_ctx_t;
+
+/* threads decoding the packets, 0 for one per online CPU; NULL if out of memory */
+cap_ctx_t *cap_ctx_new(uint32_t threads);
+
+void cap_ctx_free(cap_ctx_t *ctx);
+
+/* network given as ESSID:BSSID (12 hex digits) for captures missing its beacons; 0 on success, -1 if invalid */
+int cap_add_network(cap_ctx_t *ctx, const char *network);
+
+/* the handshakes of every capture parsed with ctx so far, optionally of one ESSID only; NULL on error, otherwise a
+ * dynamic array of *hccapx_cnt handshakes (possibly 0) the caller frees */
+hccapx_t *cap_parse(cap_ctx_t *ctx, const char *path, const char *essid_filter, uint32_t *hccapx_cnt);
+
+/* follow mode for a regular file still being written, one per context: the first call parses what the file holds,
+ * later ones only the records appended since, a record being written being left to the next call; returns like
+ * cap_parse, but only the handshakes no earlier call returned */
+hccapx_t *cap_follow(cap_ctx_t *ctx, const char *path, const char *essid_filter, uint32_t *hccapx_cnt);
+
+/* command line interface: writes the handshakes of a capture to a .hccapx file and its PMKIDs to a .16800 one */
 int cap2hccapx(int arc, char *argv[]);
 
-typedef struct hccapx hccapx_t;
+void cap2hccapx_pmkid_filename(const char *out, char *out_pmkid, size_t size);
 
 #endif //WPA2_CAP2HCCAPX
@@ -1,189 +1,536 @@
-#include "src/pbkdf2.h"
+#include "src/engine.h"
+#include "src/wordlist.h"
+#include "src/dedup.h"
+#include "src/essid.h"
+#include "src/potfile.h"
+#include "src/pmkcache.h"
+#include "src/pmktable.h"
+#include "src/watch.h"
+#include "src/hashfile.h"
+#include "src/handshake.h"
 #include "cap2hccapx/cap2hccapx.h"
 #include <string.h>
+#include <getopt.h>
 
-/**                         min(unsigned char*, unsigned char*, uint32_t);
+/** Defines */
+/** Default size in MiB of the cross-list dedup filter when enabled without an explicit size */
+#define DEDUP_DEFAULT_MIB   256
+
+/** Attack mode: candidates read from wordlists */
+#define ATTACK_MODE_STRAIGHT    0
+
+/** Attack mode: every word of a left wordlist followed by every word of a right wordlist */
+#define ATTACK_MODE_COMBINATOR  1
+
+/** Attack mode: candidates generated from a mask */
+#define ATTACK_MODE_MASK        3
+
+/** Attack mode: every word of a wordlist followed by every candidate of a mask */
+#define ATTACK_MODE_HYBRID_WM   6
+
+/** Attack mode: every candidate of a mask followed by every word of a wordlist */
+#define ATTACK_MODE_HYBRID_MW   7
+
+/** Attack mode: candidates generated by a Markov model trained on a sample wordlist, most likely first */
+#define ATTACK_MODE_MARKOV      8
+
+/** Default minimum length of the Markov candidates (WPA2 passphrases are at least 8 characters long) */
+#define MARKOV_DEFAULT_MIN      8
+
+/** Default maximum length of the Markov candidates */
+#define MARKOV_DEFAULT_MAX      8
+
+/** Value returned by getopt_long for --markov-threshold, which has no short equivalent */
+#define OPTION_MARKOV_THRESHOLD 256
+
+/** Value returned by getopt_long for --markov-length, which has no short equivalent */
+#define OPTION_MARKOV_LENGTH    257
+
+/** Value returned by getopt_long for --no-essid, which has no short equivalent */
+#define OPTION_NO_ESSID         258
+
+/** Value returned by getopt_long for --potfile, which has no short equivalent */
+#define OPTION_POTFILE          259
+
+/** Value returned by getopt_long for --potfile-disable, which has no short equivalent */
+#define OPTION_POTFILE_DISABLE  260
+
+/** Value returned by getopt_long for --loopback, which has no short equivalent */
+#define OPTION_LOOPBACK         261
+
+/** Value returned by getopt_long for --pmk-cache, which has no short equivalent */
+#define OPTION_PMK_CACHE        262
+
+/** Value returned by getopt_long for --pmk-tables, which has no short equivalent */
+#define OPTION_PMK_TABLES       263
+
+/** Value returned by getopt_long for --pmk-import, which has no short equivalent */
+#define OPTION_PMK_IMPORT       264
+
+/** Value returned by getopt_long for --all, which has no short equivalent */
+#define OPTION_ALL              265
+
+/** Value returned by getopt_long for --follow, which has no short equivalent */
+#define OPTION_FOLLOW           266
+
+/** Value returned by getopt_long for --watch, which has no short equivalent */
+#define OPTION_WATCH            267
+
+/** Value returned by getopt_long for --pmk-cache-slots, which has no short equivalent */
+#define OPTION_PMK_CACHE_SLOTS  268
+
+/** Default number of seconds between two polls of a followed capture */
+#define FOLLOW_DEFAULT_SECONDS  5
+
+/**
+ * Definition of the structure options_t, containing the parsed command line:
  *
- *  Requires:               []
+ *  - cap_filename:         capture file the handshakes are taken from (directory of captures in watch mode).
  *
- *  Allows:                 []
+ *  - all:                  true if every handshake of the capture has to be cracked, instead of a single one chosen by
+ *                          the user.
+ *
+ *  - wordlists:            dynamic array of wordlist files, in the order they have to be processed (directories are
+ *                          already expanded into the files they contain).
+ *
+ *  - wordlists_cnt:        number of entries in wordlists.
+ *
+ *  - essid_filter:         optional ESSID the handshakes are filtered by (NULL if none).
+ *
+ *  - dedup_mib:            size in MiB of the filter used to skip candidates already tested, 0 if disabled.
+ *
+ *  - rules_filename:       optional hashcat rule file the base words are mangled with (NULL if none).
+ *
+ *  - threads:              number of worker threads testing candidates.
+ *
+ *  - quiet:                true if the candidates must not be printed while being tested.
+ *
+ *  - attack_mode:          one of the ATTACK_MODE_* values.
+ *
+ *  - mask:                 mask the candidates are generated from (mask and hybrid attacks).
+ *
+ *  - outer_wordlist:       wordlist streamed from storage (combinator and hybrid attacks).
+ *
+ *  - inner_wordlist:       wordlist held in memory (right wordlist of the combinator attack).
+ *
+ *  - markov_wordlist:      sample wordlist the Markov model is trained on (Markov attack).
+ *
+ *  - markov_threshold:     number of successors considered after every character, 0 for the whole alphabet.
+ *
+ *  - markov_min, markov_max: range of lengths of the Markov candidates.
+ *
+ *  - no_essid:             true if the ESSID pre-pass has to be skipped.
+ *
+ *  - potfile:              file the cracked handshakes are recorded in and looked up from, NULL if disabled.
+ *
+ *  - loopback:             true if the passwords of the potfile have to be tested before any other candidate.
+ *
+ *  - pmk_cache:            optional file caching the PMKs across runs (NULL if none).
+ *
+ *  - pmk_cache_slots:      minimum number of slots of the PMK cache, 0 for the default.
+ *
+ *  - pmk_tables:           optional directory of PMK tables written by the precompute mode (NULL if none).
+ *
+ *  - pmk_import:           optional coWPAtty hashfile, airolib-ng database or PMK table to be tested (NULL if none).
+ *
+ *  - custom_charsets:      user defined charsets ?1 to ?4 as written on the command line (NULL if undefined).
  *
- *  Description:            Utility function used to in order to determine which value is the minimum between AP MAC and
- *                          Station MAC or AP Nonce and Station Nonce for a proper Pairwise Transient Key expansion.
+ *  - skip, limit:          slice of the keyspace that has to be tested (generated attacks only, limit 0 for no limit).
  *
+ *  - follow:               number of seconds between two polls of the capture, still being written, for handshakes
+ *                          completed since the last one, 0 if the capture is parsed once.
  *
- * @param A:                Access Point MAC or Nonce.
- * @param S:                Station MAC or Nonce.
- * @param strlen:           Length of MAC (6 bytes) or length of Nonce (32 bytes).
- * @return:                 Returns the Nonce or the MAC whose numerical value is lesser than the other.
+ *  - watch:                true if cap_filename is a directory whose captures, present and to come, are cracked.
  */
-unsigned char *min(unsigned char *A, unsigned char *S, uint32_t strlen) {
-    for (uint32_t i = 0; i < strlen; i++) {
-        if (A[i] < S[i])
-            return A;
-        else if (A[i] > S[i])
-            return S;
-    }
-    return A;
-}
-
-/**                         max(unsigned char*, unsigned char*, uint32_t);
+typedef struct {
+    char *cap_filename;
+    bit_t all;
+    char **wordlists;
+    uint32_t wordlists_cnt;
+    char *essid_filter;
+    uint32_t dedup_mib;
+    char *rules_filename;
+    uint32_t threads;
+    bit_t quiet;
+    uint32_t attack_mode;
+    char *mask;
+    char *outer_wordlist;
+    char *inner_wordlist;
+    char *markov_wordlist;
+    uint32_t markov_threshold;
+    uint32_t markov_min;
+    uint32_t markov_max;
+    bit_t no_essid;
+    char *potfile;
+    bit_t loopback;
+    char *pmk_cache;
+    uint64_t pmk_cache_slots;
+    char *pmk_tables;
+    char *pmk_import;
+    char *custom_charsets[MASK_CUSTOM_CHARSETS];
+    uint64_t skip;
+    uint64_t limit;
+    uint32_t follow;
+    bit_t watch;
+} options_t;
+
+/** Engine stopped by SIGINT, NULL while no engine is running */
+static engine_t *running_engine = NULL;
+
+
+/**                         usage(char*);
  *
  *  Requires:               []
  *
  *  Allows:                 []
  *
- *  Description:            Utility function used to in order to determine which value is the maximum between AP MAC and
- *                          Station MAC or AP Nonce and Station Nonce for a proper Pairwise Transient Key expansion.
- *
+ *  Description:            Utility function that prints the command line synopsis and exits.
  *
- * @param A:                Access Point MAC or Nonce.
- * @param S:                Station MAC or Nonce.
- * @param strlen:           Length of MAC (6 bytes) or length of Nonce (32 bytes).
- * @return:                 Returns the Nonce or the MAC whose numerical value is greater than the other.
+ *  @param program:         Main function's argv[0].
  */
-unsigned char *max(unsigned char *A, unsigned char *S, uint32_t strlen) {
-    for (uint32_t i = 0; i < strlen; i++) {
-        if (A[i] > S[i])
-            return A;
-        else if (A[i] < S[i])
-            return S;
-    }
-    return A;
+void usage(char *program) {
+    fprintf(stderr, "Usage: %s [options] <cap_file> <wordlist_file|wordlist_dir>...\n"
+                    "       %s -a 1 [options] <cap_file> <left_wordlist> <right_wordlist>\n"
+                    "       %s -a 3 [options] <cap_file> <mask>\n"
+                    "       %s -a 6 [options] <cap_file> <wordlist> <mask>\n"
+                    "       %s -a 7 [options] <cap_file> <mask> <wordlist>\n"
+                    "       %s -a 8 [options] <cap_file> <sample_wordlist>\n"
+                    "       %s --watch [-a <n>] [options] <cap_dir> <attack arguments>...\n"
+                    "       %s wordlist dedup [options] -o <output> <input>...\n"
+                    "       %s precompute [options] -o <table_dir> <essid_list> <wordlist>...\n"
+                    "\n"
+                    "  <cap_file> may also be a hash file: .hccapx, hashcat .22000/.hc22000 or .16800\n"
+                    "\n"
+                    "  -e, --essid <essid>     Filter handshakes by essid\n"
+                    "  --all                   Crack every handshake of the capture at once, instead of choosing one\n"
+                    "  --follow[=<seconds>]    Keep polling the capture while it is being written (default every %d\n"
+                    "                          seconds), attacking the handshakes completed since (implies --all)\n"
+                    "  --watch                 Keep cracking the captures written to, or moved into, a directory\n"
+                    "                          (implies --all)\n"
+                    "  -u, --dedup[=<MiB>]     Skip candidates already tested in an earlier wordlist, using a\n"
+                    "                          probabilistic filter of the given size (default %d MiB)\n"
+                    "  -r, --rules <file>      Mangle every base word with the rules of a hashcat rule file\n"
+                    "  -t, --threads <n>       Worker threads testing candidates (default: online CPUs)\n"
+                    "  -q, --quiet             Do not print the candidates while testing them\n"
+                    "  -a, --attack-mode <n>   0: wordlists (default), 1: combinator, 3: mask, 6: wordlist + mask,\n"
+                    "                          7: mask + wordlist, 8: Markov (masks: ?l ?u ?d ?h ?H ?s ?a ?b ?1-?4 ?\?)\n"
+                    "  -1, -2, -3, -4 <cs>     User defined charsets ?1 to ?4 of the mask, e.g. -1 ?dabcdef\n"
+                    "  -s, --skip <n>          Skip the first n candidates of a generated attack (1, 3, 6, 7, 8)\n"
+                    "  -l, --limit <n>         Test at most n candidates of a generated attack (1, 3, 6, 7, 8)\n"
+                    "  --markov-threshold <n>  Successors considered after every character (default: all)\n"
+                    "  --markov-length <min>[:<max>]\n"
+                    "                          Lengths of the Markov candidates (default %d:%d)\n"
+                    "  --no-essid              Skip the pre-pass testing variants of the ESSID and of the AP MAC\n"
+                    "  --potfile <file>        Record cracked handshakes in the given potfile (default %s)\n"
+                    "  --potfile-disable       Neither look up nor record cracked handshakes\n"
+                    "  --loopback              Test the passwords of the potfile before any other candidate\n"
+                    "  --pmk-cache <file>      Look up the PMKs in, and add them to, the given cache (created if\n"
+                    "                          missing), so that ESSIDs seen before skip pbkdf2\n"
+                    "  --pmk-cache-slots <n>   Slots of the PMK cache (default %llu, filled up to three quarters), a\n"
+                    "                          smaller or full cache being grown when opened\n"
+                    "  --pmk-tables <dir>      Test the PMK table precomputed for the ESSID first, if any\n"
+                    "  --pmk-import <file>     Test the PMKs of a coWPAtty/genpmk hashfile or airolib-ng database\n",
+            program, program, program, program, program, program, program, program, program, FOLLOW_DEFAULT_SECONDS,
+            DEDUP_DEFAULT_MIB,
+            MARKOV_DEFAULT_MIN, MARKOV_DEFAULT_MAX, POTFILE_DEFAULT_PATH, (unsigned long long) PMKCACHE_DEFAULT_SLOTS);
+    exit(-1);
 }
 
-
-/**                         check_arguments(int, char**);
+/**                         check_arguments(int, char**, options_t*);
  *
  *  Requires:               []
  *
  *  Allows:                 []
  *
- *  Description:            Utility function that checks if main program's argument are correctly inserted.
+ *  Description:            Utility function that parses main program's arguments and checks they are correctly
+ *                          inserted. Wordlist directories are expanded into the wordlist files they contain.
  *
  *  @param argc:            Main function's argument counter.
  *  @param argv:            Main function's argument vector.
+ *  @param options:         Output struct holding the parsed arguments.
  */
-void check_arguments(int argc, char **argv) {
+void check_arguments(int argc, char **argv, options_t *options) {
+
+    static struct option long_options[] = {
+            {"essid",            required_argument, NULL, 'e'},
+            {"dedup",            optional_argument, NULL, 'u'},
+            {"rules",            required_argument, NULL, 'r'},
+            {"threads",          required_argument, NULL, 't'},
+            {"quiet",            no_argument,       NULL, 'q'},
+            {"attack-mode",      required_argument, NULL, 'a'},
+            {"custom-charset1",  required_argument, NULL, '1'},
+            {"custom-charset2",  required_argument, NULL, '2'},
+            {"custom-charset3",  required_argument, NULL, '3'},
+            {"custom-charset4",  required_argument, NULL, '4'},
+            {"skip",             required_argument, NULL, 's'},
+            {"limit",            required_argument, NULL, 'l'},
+            {"markov-threshold", required_argument, NULL, OPTION_MARKOV_THRESHOLD},
+            {"markov-length",    required_argument, NULL, OPTION_MARKOV_LENGTH},
+            {"no-essid",         no_argument,       NULL, OPTION_NO_ESSID},
+            {"potfile",          required_argument, NULL, OPTION_POTFILE},
+            {"potfile-disable",  no_argument,       NULL, OPTION_POTFILE_DISABLE},
+            {"loopback",         no_argument,       NULL, OPTION_LOOPBACK},
+            {"pmk-cache",        required_argument, NULL, OPTION_PMK_CACHE},
+            {"pmk-cache-slots",  required_argument, NULL, OPTION_PMK_CACHE_SLOTS},
+            {"pmk-tables",       required_argument, NULL, OPTION_PMK_TABLES},
+            {"pmk-import",       required_argument, NULL, OPTION_PMK_IMPORT},
+            {"all",              no_argument,       NULL, OPTION_ALL},
+            {"follow",           optional_argument, NULL, OPTION_FOLLOW},
+            {"watch",            no_argument,       NULL, OPTION_WATCH},
+            {NULL, 0,                               NULL, 0}
+    };
+
+    char *end;
+    int option;
+
+    memset(options, 0, sizeof(options_t));
+    options->threads = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+    options->markov_min = MARKOV_DEFAULT_MIN;
+    options->markov_max = MARKOV_DEFAULT_MAX;
+    options->potfile = POTFILE_DEFAULT_PATH;
+
+    while ((option = getopt_long(argc, argv, "e:u::r:t:qa:1:2:3:4:s:l:", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'e':
+                options->essid_filter = optarg;
+                break;
+            case 'u':
+                options->dedup_mib = optarg ? (uint32_t) strtoul(optarg, NULL, 10) : DEDUP_DEFAULT_MIB;
+                if (options->dedup_mib == 0) {
+                    fprintf(stderr, "Invalid dedup filter size \"%s\"\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case 'r':
+                options->rules_filename = optarg;
+                break;
+            case 't':
+                options->threads = (uint32_t) strtoul(optarg, NULL, 10);
+                if (options->threads == 0) {
+                    fprintf(stderr, "Invalid number of threads \"%s\"\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case 'q':
+                options->quiet = true;
+                break;
+            case 'a':
+                options->attack_mode = (uint32_t) strtoul(optarg, NULL, 10);
+                if (options->attack_mode != ATTACK_MODE_STRAIGHT && options->attack_mode != ATTACK_MODE_COMBINATOR &&
+                    options->attack_mode != ATTACK_MODE_MASK && options->attack_mode != ATTACK_MODE_HYBRID_WM &&
+                    options->attack_mode != ATTACK_MODE_HYBRID_MW && options->attack_mode != ATTACK_MODE_MARKOV) {
+                    fprintf(stderr, "Invalid attack mode \"%s\"\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case '1': case '2': case '3': case '4':
+                options->custom_charsets[option - '1'] = optarg;
+                break;
+            case 's':
+                options->skip = strtoull(optarg, NULL, 10);
+                break;
+            case 'l':
+                options->limit = strtoull(optarg, NULL, 10);
+                break;
+            case OPTION_MARKOV_THRESHOLD:
+                options->markov_threshold = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case OPTION_MARKOV_LENGTH:
+                options->markov_min = (uint32_t) strtoul(optarg, &end, 10);
+                options->markov_max = *end == ':' ? (uint32_t) strtoul(end + 1, NULL, 10) : options->markov_min;
+                if (options->markov_min == 0 || options->markov_max < options->markov_min ||
+                    options->markov_max >= MAX_LENGTH) {
+                    fprintf(stderr, "Invalid Markov length range \"%s\"\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case OPTION_NO_ESSID:
+                options->no_essid = true;
+                break;
+            case OPTION_POTFILE:
+                options->potfile = optarg;
+                break;
+            case OPTION_POTFILE_DISABLE:
+                options->potfile = NULL;
+                break;
+            case OPTION_LOOPBACK:
+                options->loopback = true;
+                break;
+            case OPTION_PMK_CACHE:
+                options->pmk_cache = optarg;
+                break;
+            case OPTION_PMK_CACHE_SLOTS:
+                options->pmk_cache_slots = strtoull(optarg, NULL, 10);
+                if (options->pmk_cache_slots == 0 || options->pmk_cache_slots > PMKCACHE_MAX_SLOTS) {
+                    fprintf(stderr, "Invalid number of PMK cache slots \"%s\"\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case OPTION_PMK_TABLES:
+                options->pmk_tables = optarg;
+                break;
+            case OPTION_PMK_IMPORT:
+                options->pmk_import = optarg;
+                break;
+            case OPTION_ALL:
+                options->all = true;
+                break;
+            case OPTION_FOLLOW:
+                options->follow = optarg ? (uint32_t) strtoul(optarg, NULL, 10) : FOLLOW_DEFAULT_SECONDS;
+                if (options->follow == 0) {
+                    fprintf(stderr, "Invalid follow interval \"%s\"\n", optarg);
+                    exit(-1);
+                }
+                /* No one is there to choose among the handshakes completed later on */
+                options->all = true;
+                break;
+            case OPTION_WATCH:
+                options->watch = true;
+                options->all = true;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
 
     /* Checking number of arguments */
-    if (argc != 3 && argc != 4) {
-        fprintf(stderr, "Usage: %s <cap_file> <wordlist_file> [Filter by essid]\n", argv[0]);
+    if (argc - optind < 2) {
+        usage(argv[0]);
+    }
+
+    options->cap_filename = argv[optind];
+
+    if (options->watch && options->follow) {
+        fprintf(stderr, "Options --watch and --follow are mutually exclusive, exiting.\n");
         exit(-1);
     }
 
-    /* Checking extension is "cap" (magic number check is performed within cap2hccapx */
-    char *extension = strrchr(argv[1], '.');
+    /* Checking extension is the one of a capture or of a hash file (magic number check is performed within
+     * cap2hccapx, the hash file format is told by its content) */
+    if (!options->watch && !watch_is_capture(options->cap_filename) && !hashfile_is_hashfile(options->cap_filename)) {
+        fprintf(stderr, "File \"%s\" is not a .cap, .pcap, .pcapng, .hccapx, .22000, .hc22000 or .16800 file\n",
+                options->cap_filename);
+        exit(-1);
+    }
 
-    if (strcmp(extension + 1, "cap") != 0) {
-        fprintf(stderr, "File \"%s\" is not a .cap file\n", argv[1]);
+    if (options->follow && hashfile_is_hashfile(options->cap_filename)) {
+        fprintf(stderr, "Option --follow requires a capture, exiting.\n");
         exit(-1);
     }
 
-    /* Checking cap filename length */
-    if (strlen(argv[1]) > MAX_LENGTH - 3)
-        /*
-         * - 3 because strlen(".cap") = 4, strlen(".hccapx") = 7, 7 - 4 = 3,
-         * We check this since we need to append the .hccapx extension to the filename,
-         * trimmed of his .cap extension
-         */
-    {
-        fprintf(stderr, "Filename \"%s\" exceeds filename length [%d]\n", argv[1], MAX_LENGTH);
+    if (options->loopback && options->potfile == NULL) {
+        fprintf(stderr, "Option --loopback requires a potfile, exiting.\n");
         exit(-1);
     }
-}
 
-/**                         derive_hccapx_filename(char[MAX_LENGTH], char[MAX_LENGTH);
- *
- *  Requires:               []
- *
- *  Allows:                 []
- *
- *  Description:            Utility function that, using capture's filename, derives the corresponding hccapx filename.
- *
- *  @param cap_filename:    Cap file's name.
- *  @param hccapx_filename: Hccapx file's name used as output for the function since in C we can't return static arrays
- *                          but only pointers.
- */
-void derive_hccapx_filename(char cap_filename[MAX_LENGTH], char hccapx_filename[MAX_LENGTH]) {
+    switch (options->attack_mode) {
+        case ATTACK_MODE_MASK:
+            if (argc - optind != 2) usage(argv[0]);
+            options->mask = argv[optind + 1];
+            return;
+        case ATTACK_MODE_COMBINATOR:
+            if (argc - optind != 3) usage(argv[0]);
+            options->outer_wordlist = argv[optind + 1];
+            options->inner_wordlist = argv[optind + 2];
+            return;
+        case ATTACK_MODE_HYBRID_WM:
+            if (argc - optind != 3) usage(argv[0]);
+            options->outer_wordlist = argv[optind + 1];
+            options->mask = argv[optind + 2];
+            return;
+        case ATTACK_MODE_HYBRID_MW:
+            if (argc - optind != 3) usage(argv[0]);
+            options->mask = argv[optind + 1];
+            options->outer_wordlist = argv[optind + 2];
+            return;
+        case ATTACK_MODE_MARKOV:
+            if (argc - optind != 2) usage(argv[0]);
+            options->markov_wordlist = argv[optind + 1];
+            return;
+        default:
+            break;
+    }
+
+    if (options->skip || options->limit) {
+        fprintf(stderr, "Options --skip and --limit are only supported by generated attacks, exiting.\n");
+        exit(-1);
+    }
 
-    /* We already asserted cap_filename has ".cap" extension */
-    uint8_t cap_filename_len = strlen(cap_filename);
+    /* Wordlists are processed in the given order, directories in alphabetical order */
+    for (int i = optind + 1; i < argc; i++) {
+        if (wordlist_expand_path(argv[i], &options->wordlists, &options->wordlists_cnt) != 0) {
+            fprintf(stderr, "Error in opening wordlist \"%s\", exiting.\n", argv[i]);
+            exit(-1);
+        }
+    }
 
-    memset(hccapx_filename, 0, MAX_LENGTH);
-    strncpy(hccapx_filename, cap_filename, cap_filename_len - 3);
-    strcat(hccapx_filename, "hccapx");
+    if (options->wordlists_cnt == 0) {
+        fprintf(stderr, "No wordlist files found, exiting.\n");
+        exit(-1);
+    }
 }
 
-/**                         process_cap_file(int, char**);
+/**                         process_cap_file(char*, char*, bit_t, uint32_t, uint32_t*);
  *
  *  Requires:               []
  *
  *  Allows:                 []
  *
- *  Description:            Utility function that processes capture file and, by creating hccapx file via cap2hccapx,
- *                          looks for eapol packets in order to allow the PMK and, later on, the MIC. The function
- *                          enumerates all possible handshakes and lets the user decide which one has to be processed.
+ *  Description:            Utility function that processes capture file and, by parsing it in memory with cap_parse,
+ *                          looks for eapol packets in order to allow the PMK and, later on, the MIC. Hash files
+ *                          (hccapx, hashcat -m 22000 or -m 16800) are loaded as they are with hashfile_load. The
+ *                          function enumerates all possible handshakes and lets the user decide which one has to be
+ *                          processed, unless all of them have to.
  *
- * @param argc:             Main function's argument counter.
- * @param argv:             Main function's argument vector.
- * @return:                 User selected hccapx struct that has to be cracked.
+ * @param cap_filename:     Capture file's (or hash file's) name.
+ * @param essid_filter:     Optional essid the handshakes are filtered by (NULL if none).
+ * @param all:              true if every handshake has to be cracked, false to let the user choose one.
+ * @param threads:          number of threads decoding the capture.
+ * @param hccapx_cnt:       Output number of handshakes returned.
+ * @return:                 Dynamic array of the hccapx structs that have to be cracked.
  */
-hccapx_t process_cap_file(int argc, char **argv) {
+hccapx_t *process_cap_file(char *cap_filename, char *essid_filter, bit_t all, uint32_t threads,
+                           uint32_t *hccapx_cnt) {
 
-    FILE *hccapx_file;
+    cap_ctx_t *cap_ctx;
+    hccapx_t *hccapx_list = NULL;
 
-    hccapx_t temp_hccapx, chosen_hccapx;
-    hccapx_t *hccapx_list;
-
-    char hccapx_filename[MAX_LENGTH];
-
-    uint32_t number_of_hccapx_structs = 0;
+    uint32_t number_of_hccapx_structs = 0, collapsed;
     uint32_t hccapx_choice = -1;    /* set to -1 in order to achieve the highest number possible in uint32_t, due to overflow) */
-    uint32_t hccapx_struct_size = (uint32_t) sizeof(hccapx_t);
-
-    uint32_t cap2hccapx_argc;
-    char **cap2hccapx_argv;
 
-    derive_hccapx_filename(argv[1], hccapx_filename);
+    if (hashfile_is_hashfile(cap_filename)) {
+        hccapx_list = hashfile_load(cap_filename, &number_of_hccapx_structs);
 
-    cap2hccapx_argv = (char **) malloc(argc * sizeof(char *));
-    cap2hccapx_argv[0] = argv[0];
-    cap2hccapx_argv[1] = argv[1];
-    cap2hccapx_argv[2] = hccapx_filename;
-    cap2hccapx_argc = 3;
-
-    if (argc == 4) {
-
-        cap2hccapx_argv[3] = argv[3];
-        cap2hccapx_argc++;
-        printf("argv[3] = \"%s\"", argv[3]);
+        /* The filter cap_parse applies while pairing the messages */
+        if (hccapx_list && essid_filter) {
+            uint32_t kept = 0, len = (uint32_t) strlen(essid_filter);
 
+            for (uint32_t i = 0; i < number_of_hccapx_structs; i++) {
+                if (hccapx_list[i].essid_len == len && memcmp(hccapx_list[i].essid, essid_filter, len) == 0) {
+                    hccapx_list[kept++] = hccapx_list[i];
+                }
+            }
+            number_of_hccapx_structs = kept;
+        }
+    } else {
+        /* PMKIDs only need the first message of a handshake, they are offered along with the handshakes */
+        cap_ctx = cap_ctx_new(threads);
+        if (cap_ctx) {
+            hccapx_list = cap_parse(cap_ctx, cap_filename, essid_filter, &number_of_hccapx_structs);
+            cap_ctx_free(cap_ctx);
+        }
     }
 
-    cap2hccapx(cap2hccapx_argc, cap2hccapx_argv);
-    free(cap2hccapx_argv);
-
-    hccapx_file = fopen(hccapx_filename, "rb");
-    if (hccapx_file) {
-
-        hccapx_list = (hccapx_t *) malloc(hccapx_struct_size);
+    if (hccapx_list) {
 
-        while (fread(&temp_hccapx, hccapx_struct_size, 1, hccapx_file) == 1) {
-
-            if (fread(&temp_hccapx, hccapx_struct_size, 1, hccapx_file) == 1) {
-                number_of_hccapx_structs++;
-                hccapx_list = (hccapx_t *) realloc(hccapx_list, number_of_hccapx_structs * hccapx_struct_size);
-                hccapx_list[number_of_hccapx_structs - 1] = temp_hccapx;
-            } else {
-                /* Malformed .hccapx file */
-                break;
-            }
+        /* Handshakes equivalent for the verification are tested once, the best of every AP/STA pair first */
+        collapsed = handshake_dedup(hccapx_list, &number_of_hccapx_structs);
+        if (collapsed > 0) {
+            printf("%" PRIu32 " duplicate handshakes collapsed.\n", collapsed);
         }
-        fclose(hccapx_file);
 
         if (number_of_hccapx_structs > 0) {
-            if (number_of_hccapx_structs == 1) {
+            if (number_of_hccapx_structs == 1 || all) {
                 hccapx_choice = 1;
             } else {
 
@@ -191,13 +538,14 @@ hccapx_t process_cap_file(int argc, char **argv) {
                 while (number_of_hccapx_structs < hccapx_choice) {
                     printf("Select the HS you want to crack between:\n");
                     for (uint32_t i = 0; i < number_of_hccapx_structs; i++) {
-                        printf("%d) [AP]: \"%s\" - [MAC_AP]: %02x:%02x:%02x:%02x:%02x:%02x - [MAC_STA]: %02x:%02x:%02x:%02x:%02x:%02x\n",
+                        printf("%d) [AP]: \"%s\" - [MAC_AP]: %02x:%02x:%02x:%02x:%02x:%02x - [MAC_STA]: %02x:%02x:%02x:%02x:%02x:%02x%s\n",
                                i + 1,
                                hccapx_list[i].essid,
                                hccapx_list[i].mac_ap[0], hccapx_list[i].mac_ap[1], hccapx_list[i].mac_ap[2],
                                hccapx_list[i].mac_ap[3], hccapx_list[i].mac_ap[4], hccapx_list[i].mac_ap[5],
                                hccapx_list[i].mac_sta[0], hccapx_list[i].mac_sta[1], hccapx_list[i].mac_sta[2],
-                               hccapx_list[i].mac_sta[3], hccapx_list[i].mac_sta[4], hccapx_list[i].mac_sta[5]
+                               hccapx_list[i].mac_sta[3], hccapx_list[i].mac_sta[4], hccapx_list[i].mac_sta[5],
+                               hccapx_list[i].message_pair == HCCAPX_MESSAGE_PAIR_PMKID ? " - [PMKID]" : ""
                         );
                     }
                     scanf("%u", &hccapx_choice);
@@ -209,193 +557,804 @@ hccapx_t process_cap_file(int argc, char **argv) {
         } else {
             printf("No HS found in the given .cap file, exiting.\n");
             free(hccapx_list);
-            remove(hccapx_filename);
             exit(-1);
         }
 
-        chosen_hccapx = hccapx_list[hccapx_choice - 1];
+        if (all) {
+            *hccapx_cnt = number_of_hccapx_structs;
+            return hccapx_list;
+        }
 
-        free(hccapx_list);
+        hccapx_list[0] = hccapx_list[hccapx_choice - 1];
+        *hccapx_cnt = 1;
 
-        return chosen_hccapx;
+        return hccapx_list;
     } else {
 
-        fprintf(stderr, "Error in opening input hccapx file \"%s\", exiting.\n", argv[1]);
+        fprintf(stderr, "Error in processing capture file \"%s\", exiting.\n", cap_filename);
         exit(-1);
 
     }
 }
 
 
-/**                         verify_mic(hmac_ctx_t*, hccapx_t*);
+/**                         print_found(const hccapx_t*, const unsigned char*, uint32_t, const char*, bit_t);
  *
  *  Requires:               []
  *
  *  Allows:                 []
  *
- *  Description:            Utility function that verifies if the hccapx structure MIC used for authentication is actually
- *                          the same calculated, if so, it means the password was guessed.
+ *  Description:            Utility function that reports the password of a handshake, along with the handshake when
+ *                          several of them are cracked at once. Passwords holding non printable bytes are printed
+ *                          hex encoded as $HEX[...], as in the potfile.
  *
- * @param hmac_ctx:         Hmac context that holds the eapol MIC that has to be compared to the one in the hccapx struct.
- * @param hccapx:           Hccapx struct that holds the eapol MIC that has to be compared to the one in the Hmac context.
- * @return:                 bit_t boolean type, true if the MICs correspond, false if they don't.
+ *  @param hccapx:          handshake cracked.
+ *  @param password:        password of the handshake.
+ *  @param strlen_password: length of the password.
+ *  @param source:          where the password comes from ("" if it has just been cracked).
+ *  @param all:             true if several handshakes are cracked at once.
  */
-bit_t verify_mic(hmac_ctx_t *hmac_ctx, hccapx_t *hccapx) {
+void print_found(const hccapx_t *hccapx, const unsigned char *password, uint32_t strlen_password, const char *source,
+                 bit_t all) {
+    bit_t printable = true;
+
+    if (all) {
+        printf("[AP]: \"%.*s\" - [MAC_AP]: %02x:%02x:%02x:%02x:%02x:%02x - "
+               "[MAC_STA]: %02x:%02x:%02x:%02x:%02x:%02x%s: ",
+               hccapx->essid_len, hccapx->essid,
+               hccapx->mac_ap[0], hccapx->mac_ap[1], hccapx->mac_ap[2],
+               hccapx->mac_ap[3], hccapx->mac_ap[4], hccapx->mac_ap[5],
+               hccapx->mac_sta[0], hccapx->mac_sta[1], hccapx->mac_sta[2],
+               hccapx->mac_sta[3], hccapx->mac_sta[4], hccapx->mac_sta[5],
+               hccapx->message_pair == HCCAPX_MESSAGE_PAIR_PMKID ? " - [PMKID]" : "");
+    }
 
-    if ((hmac_ctx->digest[0] >> 24 & 0x000000ff) != hccapx->keymic[0]) return false;
-    if ((hmac_ctx->digest[0] >> 16 & 0x000000ff) != hccapx->keymic[1]) return false;
-    if ((hmac_ctx->digest[0] >> 8 & 0x000000ff) != hccapx->keymic[2]) return false;
-    if ((hmac_ctx->digest[0] & 0x000000ff) != hccapx->keymic[3]) return false;
+    for (uint32_t i = 0; i < strlen_password; i++) {
+        if (password[i] < 0x20 || password[i] > 0x7e) printable = false;
+    }
 
-    if ((hmac_ctx->digest[1] >> 24 & 0x000000ff) != hccapx->keymic[4]) return false;
-    if ((hmac_ctx->digest[1] >> 16 & 0x000000ff) != hccapx->keymic[5]) return false;
-    if ((hmac_ctx->digest[1] >> 8 & 0x000000ff) != hccapx->keymic[6]) return false;
-    if ((hmac_ctx->digest[1] & 0x000000ff) != hccapx->keymic[7]) return false;
+    if (printable) {
+        printf("Password found%s: \"%.*s\"\n", source, (int) strlen_password, password);
+    } else {
+        printf("Password found%s: \"$HEX[", source);
+        for (uint32_t i = 0; i < strlen_password; i++) printf("%02x", password[i]);
+        printf("]\"\n");
+    }
+}
 
-    if ((hmac_ctx->digest[2] >> 24 & 0x000000ff) != hccapx->keymic[8]) return false;
-    if ((hmac_ctx->digest[2] >> 16 & 0x000000ff) != hccapx->keymic[9]) return false;
-    if ((hmac_ctx->digest[2] >> 8 & 0x000000ff) != hccapx->keymic[10]) return false;
-    if ((hmac_ctx->digest[2] & 0x000000ff) != hccapx->keymic[11]) return false;
 
-    if ((hmac_ctx->digest[3] >> 24 & 0x000000ff) != hccapx->keymic[12]) return false;
-    if ((hmac_ctx->digest[3] >> 16 & 0x000000ff) != hccapx->keymic[13]) return false;
-    if ((hmac_ctx->digest[3] >> 8 & 0x000000ff) != hccapx->keymic[14]) return false;
-    if ((hmac_ctx->digest[3] & 0x000000ff) != hccapx->keymic[15]) return false;
+/**                         interrupt_handler(int);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            SIGINT handler asking the running engine to stop, so that the restore point of the run can
+ *                          be reported instead of being lost.
+ *
+ *  @param signum:          number of the signal received.
+ */
+void interrupt_handler(int signum) {
+    (void) signum;
 
-    return true;
+    if (running_engine) {
+        running_engine->interrupted = 1;
+    }
 }
 
-/** Main Function           ./wpa2 <cap_file> <wordlist_file> [Essid Filter] */
-int main(int argc, char **argv) {
 
-    FILE *wordlist;
+/**                         compile_mask(options_t*, mask_t*);
+ *
+ *  Requires:               - check_arguments(int, char**, options_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that compiles the user defined charsets and the mask of the command line,
+ *                          exiting on error.
+ *
+ *  @param options:         parsed command line.
+ *  @param mask:            output mask_t struct.
+ */
+void compile_mask(options_t *options, mask_t *mask) {
+    mask_charset_t charsets[MASK_CUSTOM_CHARSETS];
+    const mask_charset_t *custom[MASK_CUSTOM_CHARSETS] = {NULL};
+
+    /* A charset may refer to the ones defined before it, e.g. -1 ?dabcdef -2 ?1ABCDEF */
+    for (uint32_t i = 0; i < MASK_CUSTOM_CHARSETS; i++) {
+        if (options->custom_charsets[i] == NULL) continue;
 
-    hccapx_t hccapx;
-    pbkdf2_ctx_t ctx;
-    hmac_ctx_t hmac_ctx;
+        if (mask_charset_parse(&charsets[i], options->custom_charsets[i], custom) != 0) {
+            fprintf(stderr, "Invalid charset ?%" PRIu32 " \"%s\", exiting.\n", i + 1, options->custom_charsets[i]);
+            exit(-1);
+        }
+        custom[i] = &charsets[i];
+    }
 
-    uint32_t strlen_password, strlen_salt;
-    unsigned char password[MAX_LENGTH];
-    char* new_line;
+    if (mask_compile(mask, options->mask, custom) != 0) {
+        fprintf(stderr, "Invalid mask \"%s\" (unknown charset, longer than %d characters or keyspace exceeding 64 bits)"
+                        ", exiting.\n", options->mask, MAX_LENGTH - 1);
+        exit(-1);
+    }
+}
 
-    check_arguments(argc, argv);
 
-    hccapx = process_cap_file(argc, argv);
+/**                         import_pmks(engine_t*, const char*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that tests the PMKs precomputed by third party tools for the ESSIDs of the
+ *                          handshakes: coWPAtty/genpmk hashfiles (and own tables) are mapped and tested in place,
+ *                          airolib-ng databases are streamed in chunks, ESSID after ESSID. No pbkdf2 is involved. A
+ *                          hashfile computed for an ESSID no handshake has is skipped.
+ *
+ *  @param engine:          engine the PMKs have to be tested with.
+ *  @param path:            name of the hashfile or database.
+ *  @return:                1 if every password was found, 0 if not, -1 on error.
+ */
+int import_pmks(engine_t *engine, const char *path) {
+    pmktable_airolib_t cursor;
+    pmktable_t table;
+    engine_group_t *group;
 
-    wordlist = fopen(argv[2], "r");
-    if (wordlist) {
+    uint64_t imported;
+    int rc = 0;
 
-        while (fgets(password, MAX_LENGTH, wordlist) != NULL) {
+    if (!pmktable_is_airolib(path)) {
+        if (pmktable_open(&table, path) != 0) return -1;
 
-            /* Carriage Return substitution with EOL */
-            new_line = strchr(password, '\n');
-            if (new_line)
-            {
-                *new_line = '\0';
-            }
+        /* A followed capture, or a watched directory, may not hold the ESSID of the hashfile (yet) */
+        if (engine_find_group(engine, table.essid, table.essid_len) == NULL) {
+            printf("No handshake for ESSID \"%.*s\" of \"%s\", skipping it.\n", table.essid_len, table.essid, path);
+        } else {
+            printf("PMK import pre-pass: \"%s\".\n", path);
+            rc = engine_run_table(engine, &table);
+        }
+        pmktable_close(&table);
 
-            printf("Testing password:\t%s\n", password);
+        return rc;
+    }
 
-            strlen_password = strlen((char *) password);
-            strlen_salt = hccapx.essid_len;
+    for (uint32_t i = 0; i < engine->groups_cnt && rc == 0 && !engine->interrupted; i++) {
+        group = &engine->groups[i];
+        if (group->remaining == 0) continue;
 
-            memset(ctx.password, 0, MAX_LENGTH);
-            memset(ctx.salt, 0, MAX_LENGTH);
+        if (pmktable_airolib_open(&cursor, &table, path, group->essid, group->essid_len) != 0) return -1;
 
-            strncpy((char *) ctx.password, (char *) password, strlen_password);
-            strncpy((char *) ctx.salt, (char *) hccapx.essid, strlen_salt);
+        imported = 0;
+        while ((rc = pmktable_airolib_next(&cursor, &table)) == 1) {
+            imported += table.records_cnt;
 
-            ctx.strlen_password = strlen_password;
-            ctx.strlen_salt = strlen_salt;
-            ctx.iteration_count = 4096;
-            ctx.bits_in_result_hash = 256;
+            rc = engine_run_table(engine, &table);
+            if (rc != 0 || engine->interrupted) break;
+        }
 
-            pbkdf2_ctx_init(&ctx);
+        pmktable_airolib_close(&cursor, &table);
 
-            pbkdf2(&ctx);
+        printf("PMK import pre-pass: %" PRIu64 " PMKs of \"%.*s\" in \"%s\".\n", imported, group->essid_len,
+               group->essid, path);
+    }
 
-            /* Printing Pairwise Master Key, calculated via pbkdf2 */
+    return rc;
+}
 
-//            printf("+---------------------------------- PMK ----------------------------------+\n");
-//            printf("| %08x %08x %08x %08x %08x %08x %08x %08x |\n", ctx.T[0], ctx.T[1], ctx.T[2], ctx.T[3], ctx.T[4], ctx.T[5], ctx.T[6], ctx.T[7]);
-//            printf("+-------------------------------------------------------------------------+\n");
 
-            /*
-             * Inside the WPA2 protocol is mandatory to write, in the following order:
-             * - "Pairwise key expansion\0"     (22 bytes + 1 byte (terminating zero))
-             * - min(AP_MAC, STATION_MAC)       (6 bytes)
-             * - max(AP_MAC, STATION_MAC)       (6 bytes)
-             * - min(AP_NONCE, STATION_NONCE)   (32 bytes)
-             * - max(AP_NONCE, STATION_NONCE)   (32 bytes)
-             *
-             * For a total of 100 bytes, 800 bits
-             */
-            hmac_ctx_init(&hmac_ctx, 256, 800);
+/**                         skip_cracked(const options_t*, potfile_t*, hccapx_t*, uint32_t*);
+ *
+ *  Requires:               - check_arguments(int, char**, options_t*);
+ *                          - potfile_open(potfile_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that drops the handshakes cracked in an earlier run, reporting their
+ *                          password from the potfile, so that they are not cracked again. The lines appended to the
+ *                          potfile since it was loaded are loaded first. Exits on read error.
+ *
+ *  @param options:         parsed command line.
+ *  @param potfile:         loaded potfile, NULL if disabled.
+ *  @param hccapx:          array of handshakes, compacted in place.
+ *  @param hccapx_cnt:      number of handshakes, updated.
+ */
+void skip_cracked(const options_t *options, potfile_t *potfile, hccapx_t *hccapx, uint32_t *hccapx_cnt) {
+    unsigned char cracked[PSK_HEX_LENGTH + 1];
+    uint32_t strlen_cracked;
 
-            hmac_append_int_key(&hmac_ctx, ctx.T[0]);
-            hmac_append_int_key(&hmac_ctx, ctx.T[1]);
-            hmac_append_int_key(&hmac_ctx, ctx.T[2]);
-            hmac_append_int_key(&hmac_ctx, ctx.T[3]);
-            hmac_append_int_key(&hmac_ctx, ctx.T[4]);
-            hmac_append_int_key(&hmac_ctx, ctx.T[5]);
-            hmac_append_int_key(&hmac_ctx, ctx.T[6]);
-            hmac_append_int_key(&hmac_ctx, ctx.T[7]);
+    if (potfile == NULL) return;
 
-            hmac_append_str_text(&hmac_ctx, (unsigned char *) "Pairwise key expansion", 22);
-            hmac_append_char_text(&hmac_ctx, 0x00);
-            hmac_append_str_text(&hmac_ctx, min(hccapx.mac_ap, hccapx.mac_sta, 6), 6);
-            hmac_append_str_text(&hmac_ctx, max(hccapx.mac_ap, hccapx.mac_sta, 6), 6);
-            hmac_append_str_text(&hmac_ctx, min(hccapx.nonce_ap, hccapx.nonce_sta, 32), 32);
-            hmac_append_str_text(&hmac_ctx, max(hccapx.nonce_ap, hccapx.nonce_sta, 32), 32);
-            hmac_append_char_text(&hmac_ctx, 0x00);
+    if (potfile_refresh(potfile) != 0) {
+        fprintf(stderr, "Error in reading potfile \"%s\", exiting.\n", potfile->path);
+        exit(-1);
+    }
 
-            hmac(&hmac_ctx);
+    for (uint32_t i = 0; i < *hccapx_cnt;) {
+        if (potfile_lookup(potfile, &hccapx[i], cracked, &strlen_cracked)) {
+            print_found(&hccapx[i], cracked, strlen_cracked, " (potfile)", options->all);
+            memmove(&hccapx[i], &hccapx[i + 1], (*hccapx_cnt - i - 1) * sizeof(hccapx_t));
+            (*hccapx_cnt)--;
+        } else {
+            i++;
+        }
+    }
+}
 
-            /* Printing Key Confirmation Key, calculated truncating the Pairwise Transient Key, calculated via hmac_sha1
-            using the protocol defined above. */
-//
-//            printf("+---------------------------------- KCK ----------------------------------+\n");
-//            printf("| %08x %08x %08x %08x %35s |\n", hmac_ctx.digest[0], hmac_ctx.digest[1], hmac_ctx.digest[2], hmac_ctx.digest[3], " ");
-//            printf("+-------------------------------------------------------------------------+\n");
 
-            pbkdf2_ctx_dispose(&ctx);
+/**                         follow_cap_file(cap_ctx_t*, const options_t*, potfile_t*, uint32_t*);
+ *
+ *  Requires:               - cap_ctx_new(uint32_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that parses the records appended to the followed capture since the last
+ *                          call, exiting on error. The first call parses the whole capture.
+ *
+ *  @param cap_ctx:         parser context holding the state of the capture.
+ *  @param options:         parsed command line.
+ *  @param potfile:         loaded potfile, NULL if disabled.
+ *  @param hccapx_cnt:      output number of handshakes returned.
+ *  @return:                dynamic array of the handshakes completed since the last call and not cracked yet.
+ */
+hccapx_t *follow_cap_file(cap_ctx_t *cap_ctx, const options_t *options, potfile_t *potfile, uint32_t *hccapx_cnt) {
+    hccapx_t *hccapx = cap_follow(cap_ctx, options->cap_filename, options->essid_filter, hccapx_cnt);
 
-            hmac_ctx_dispose(&hmac_ctx);
+    if (hccapx == NULL) {
+        fprintf(stderr, "Error in processing capture file \"%s\", exiting.\n", options->cap_filename);
+        exit(-1);
+    }
 
-            hmac_ctx_init(&hmac_ctx, 128, hccapx.eapol_len * 8);
+    skip_cracked(options, potfile, hccapx, hccapx_cnt);
+    handshake_dedup(hccapx, hccapx_cnt);
 
-            hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[0]);
-            hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[1]);
-            hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[2]);
-            hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[3]);
+    return hccapx;
+}
 
-            hmac_append_str_text(&hmac_ctx, hccapx.eapol, hccapx.eapol_len);
 
-            hmac(&hmac_ctx);
+/**                         essid_access_points(const engine_t*, const engine_group_t*, uint32_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that picks a target still tested for every distinct AP of a group, the
+ *                          ESSID variants depending on the ESSID and on the AP MAC only.
+ *
+ *  @param engine:          engine holding the targets.
+ *  @param group:           group whose APs have to be listed.
+ *  @param aps:             output indices of the targets picked, room for every member of the group.
+ *  @return:                number of targets picked.
+ */
+uint32_t essid_access_points(const engine_t *engine, const engine_group_t *group, uint32_t *aps) {
+    const engine_target_t *target;
+    uint32_t aps_cnt = 0, j;
 
+    for (uint32_t i = 0; i < group->members_cnt; i++) {
+        target = &engine->targets[group->members[i]];
+        if (target->cracked || target->retired) continue;
 
-            /* Printing Message Integrity Code, calculated via hmac_sha1, processing the whole eapol message using KCK as Key */
-//
-//            printf("+---------------------------------- MIC ----------------------------------+\n");
-//            printf("| %08x %08x %08x %08x %35s |\n", hmac_ctx.digest[0], hmac_ctx.digest[1], hmac_ctx.digest[2], hmac_ctx.digest[3], " ");
-//            printf("+-------------------------------------------------------------------------+\n");
+        for (j = 0; j < aps_cnt; j++) {
+            if (memcmp(engine->targets[aps[j]].hccapx.mac_ap, target->hccapx.mac_ap, 6) == 0) break;
+        }
 
-            if (verify_mic(&hmac_ctx, &hccapx)) {
-                printf("Password found: \"%s\"\n", password);
-                exit(0);
+        if (j == aps_cnt) aps[aps_cnt++] = group->members[i];
+    }
+
+    return aps_cnt;
+}
+
+
+/**                         run_attack(engine_t*, const options_t*, const potfile_t*, const keyspace_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that runs the pre-passes and the attack of the command line against the
+ *                          targets of the engine still tested.
+ *
+ *  @param engine:          engine the candidates have to be tested with.
+ *  @param options:         parsed command line.
+ *  @param potfile:         loaded potfile, NULL if disabled (the loopback pre-pass requires it).
+ *  @param keyspace:        keyspace of the generated attacks (unused by the straight attack).
+ *  @return:                0 on success, -1 on error.
+ */
+int run_attack(engine_t *engine, const options_t *options, const potfile_t *potfile, const keyspace_t *keyspace) {
+    engine_group_t *group;
+    pmktable_t pmktable;
+    keyspace_t essid_keyspace, loopback_keyspace;
+
+    char table_path[PMKTABLE_MAX_PATH];
+    uint32_t *aps, aps_cnt;
+    int rc = 0;
+
+    aps = (uint32_t *) malloc((engine->targets_cnt + 1) * sizeof(uint32_t));
+
+    /* Loopback pre-pass: passwords cracked on other networks are often reused */
+    if (options->loopback) {
+        rc = potfile_load_passwords(potfile, &loopback_keyspace);
+        if (rc == -1) {
+            fprintf(stderr, "Error in loading the passwords of potfile \"%s\", exiting.\n", potfile->path);
+            exit(-1);
+        }
+
+        printf("Loopback pre-pass: %d candidates.\n", rc);
+        rc = rc > 0 ? engine_run_keyspace(engine, &loopback_keyspace, NULL, 0, 0) : 0;
+        keyspace_dispose(&loopback_keyspace);
+
+        /* Nothing of the main attack has been tested yet */
+        engine->restore = options->skip;
+    }
+
+    /* PMK table pre-pass: the whole table costs the PTK/MIC checks only */
+    for (uint32_t i = 0; options->pmk_tables && i < engine->groups_cnt && rc == 0 && !engine->interrupted; i++) {
+        group = &engine->groups[i];
+        if (pmktable_path(options->pmk_tables, group->essid, group->essid_len, table_path) != 0) {
+            rc = -1;
+        } else if (access(table_path, F_OK) != 0) {
+            printf("No PMK table for ESSID \"%.*s\" in \"%s\".\n", group->essid_len, group->essid,
+                   options->pmk_tables);
+        } else if (pmktable_open(&pmktable, table_path) != 0) {
+            rc = -1;
+        } else {
+            printf("PMK table pre-pass: %" PRIu64 " PMKs.\n", pmktable.records_cnt);
+            rc = engine_run_table(engine, &pmktable);
+            pmktable_close(&pmktable);
+        }
+    }
+
+    if (options->pmk_import && rc == 0 && !engine->interrupted) {
+        rc = import_pmks(engine, options->pmk_import);
+    }
+
+    /* ESSID pre-pass: a few thousand likely candidates per AP, tested before the first wordlist byte is read. The
+     * variants only depend on the ESSID and on the AP MAC, and are only likely for their own ESSID */
+    for (uint32_t i = 0; !options->no_essid && i < engine->groups_cnt && rc == 0 && !engine->interrupted; i++) {
+        group = &engine->groups[i];
+        aps_cnt = essid_access_points(engine, group, aps);
+
+        for (uint32_t j = 0; j < aps_cnt && group->remaining > 0 && rc == 0 && !engine->interrupted; j++) {
+            printf("ESSID pre-pass: %" PRIu32 " candidates.\n",
+                   essid_candidates(&essid_keyspace, &engine->targets[aps[j]].hccapx));
+
+            engine->only_group = group;
+            rc = engine_run_keyspace(engine, &essid_keyspace, NULL, 0, 0);
+            engine->only_group = NULL;
+            keyspace_dispose(&essid_keyspace);
+
+            /* Nothing of the main attack has been tested yet */
+            engine->restore = options->skip;
+        }
+    }
+
+    if (options->attack_mode != ATTACK_MODE_STRAIGHT && rc == 0 && !engine->interrupted) {
+        rc = engine_run_keyspace(engine, keyspace, options->outer_wordlist, options->skip, options->limit);
+    }
+
+    for (uint32_t i = 0; i < options->wordlists_cnt && rc == 0 && !engine->interrupted; i++) {
+        rc = engine_run_wordlist(engine, options->wordlists[i]);
+    }
+
+    free(aps);
+
+    return rc;
+}
+
+
+/**                         report_cracked(const engine_t*, const options_t*, uint32_t);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that reports the passwords found for the targets of the engine from the
+ *                          given one on, recording them in the potfile.
+ *
+ *  @param engine:          engine holding the targets.
+ *  @param options:         parsed command line.
+ *  @param first:           first target that has to be reported.
+ *  @return:                number of targets cracked among the ones reported.
+ */
+uint32_t report_cracked(const engine_t *engine, const options_t *options, uint32_t first) {
+    uint32_t cracked_cnt = 0;
+
+    for (uint32_t i = first; i < engine->targets_cnt; i++) {
+        const engine_target_t *target = &engine->targets[i];
+
+        if (!target->cracked) continue;
+
+        cracked_cnt++;
+        print_found(&target->hccapx, target->password, target->strlen_password, "", options->all);
+
+        if (options->potfile &&
+            potfile_append(options->potfile, &target->hccapx, target->password, target->strlen_password)) {
+            fprintf(stderr, "Error in recording the password in potfile \"%s\".\n", options->potfile);
+        }
+    }
+
+    return cracked_cnt;
+}
+
+
+/**                         follow_capture(cap_ctx_t*, engine_t*, bloom_t*, const options_t*, potfile_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that polls the followed capture until handshakes are completed, or the
+ *                          run is interrupted, and adds them to the targets of the engine, the targets of the previous
+ *                          attack being retired. The filter of the candidates already tested is emptied, since none
+ *                          of them has been tested against the new targets.
+ *
+ *  @param cap_ctx:         parser context holding the state of the capture.
+ *  @param engine:          engine the handshakes have to be added to.
+ *  @param bloom:           filter of the candidates already tested, NULL if cross-list dedup is disabled.
+ *  @param options:         parsed command line.
+ *  @param potfile:         loaded potfile, NULL if disabled.
+ */
+void follow_capture(cap_ctx_t *cap_ctx, engine_t *engine, bloom_t *bloom, const options_t *options,
+                    potfile_t *potfile) {
+    hccapx_t *hccapx;
+    uint32_t hccapx_cnt = 0;
+
+    printf("Following \"%s\" for new handshakes.\n", options->cap_filename);
+
+    while (hccapx_cnt == 0 && !engine->interrupted) {
+        sleep(options->follow);
+        if (engine->interrupted) break;
+
+        hccapx = follow_cap_file(cap_ctx, options, potfile, &hccapx_cnt);
+
+        if (hccapx_cnt > 0) {
+            engine_add_targets(engine, hccapx, hccapx_cnt);
+
+            printf("Cracking %" PRIu32 " new handshakes of %" PRIu32 " ESSIDs.\n", hccapx_cnt, engine->groups_cnt);
+        }
+
+        free(hccapx);
+    }
+
+    if (bloom && hccapx_cnt > 0) {
+        bloom_dispose(bloom);
+        bloom_init(bloom, (uint64_t) options->dedup_mib * 1024 * 1024);
+    }
+}
+
+
+/**                         skip_queued(handshake_index_t*, hccapx_t*, uint32_t*);
+ *
+ *  Requires:               - handshake_index_init(handshake_index_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that drops the handshakes already queued earlier in the run, e.g. a
+ *                          capture copied twice into a watched directory, or captures overlapping in time, keeping
+ *                          the first of identical handshakes. The handshakes kept are added to the index, so that the
+ *                          cost of a capture does not grow with the number of handshakes the run has ever held.
+ *
+ *  @param queued:          index of the handshakes queued so far.
+ *  @param hccapx:          array of handshakes, compacted in place.
+ *  @param hccapx_cnt:      number of handshakes, updated.
+ *  @return:                0 on success, -1 on allocation failure.
+ */
+int skip_queued(handshake_index_t *queued, hccapx_t *hccapx, uint32_t *hccapx_cnt) {
+    uint32_t kept = 0;
+    int rc;
+
+    for (uint32_t i = 0; i < *hccapx_cnt; i++) {
+        rc = handshake_index_add(queued, &hccapx[i]);
+        if (rc == -1) return -1;
+
+        if (rc == 1) {
+            hccapx[kept++] = hccapx[i];
+        }
+    }
+
+    *hccapx_cnt = kept;
+
+    return 0;
+}
+
+
+/**                         watch_captures(watch_t*, handshake_index_t*, engine_t*, bloom_t*, const options_t*, ...);
+ *
+ *  Requires:               - watch_open(watch_t*, const char*);
+ *                          - handshake_index_init(handshake_index_t*);
+ *                          - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that waits for captures in the watched directory until handshakes not
+ *                          cracked yet are found, or the run is interrupted, and adds them to the targets of the
+ *                          engine, the targets of the previous attack being retired. Every capture is parsed with a
+ *                          context of its own; the captures already waiting are all parsed before the next attack,
+ *                          which then covers all of them at once. A capture that can't be parsed is skipped.
+ *
+ *  @param watch:           watched directory.
+ *  @param queued:          index of the handshakes queued so far in the run.
+ *  @param engine:          engine the handshakes have to be added to.
+ *  @param bloom:           filter of the candidates already tested, NULL if cross-list dedup is disabled.
+ *  @param options:         parsed command line.
+ *  @param potfile:         loaded potfile, NULL if disabled.
+ *  @return:                0 on success, -1 if the directory can't be watched any longer or on allocation failure.
+ */
+int watch_captures(watch_t *watch, handshake_index_t *queued_index, engine_t *engine, bloom_t *bloom,
+                   const options_t *options, potfile_t *potfile) {
+    cap_ctx_t *cap_ctx;
+    hccapx_t *hccapx, *queued = NULL, *grown;
+    uint32_t hccapx_cnt, queued_cnt = 0;
+    char *path;
+    int rc;
+
+    printf("Watching \"%s\" for new captures.\n", options->cap_filename);
+
+    while ((rc = watch_next(watch, &path, queued_cnt == 0, &engine->interrupted)) == 1) {
+        cap_ctx = cap_ctx_new(options->threads);
+        hccapx = cap_ctx ? cap_parse(cap_ctx, path, options->essid_filter, &hccapx_cnt) : NULL;
+        cap_ctx_free(cap_ctx);
+
+        if (hccapx == NULL) {
+            fprintf(stderr, "Error in processing capture file \"%s\", skipping it.\n", path);
+            free(path);
+            continue;
+        }
+
+        skip_cracked(options, potfile, hccapx, &hccapx_cnt);
+        free(path);
+
+        if (skip_queued(queued_index, hccapx, &hccapx_cnt) != 0) {
+            rc = -1;
+        } else if (hccapx_cnt > 0) {
+            grown = (hccapx_t *) realloc(queued, (queued_cnt + hccapx_cnt) * sizeof(hccapx_t));
+
+            if (grown == NULL) {
+                rc = -1;
+            } else {
+                queued = grown;
+                memcpy(&queued[queued_cnt], hccapx, hccapx_cnt * sizeof(hccapx_t));
+                queued_cnt += hccapx_cnt;
             }
+        }
+        free(hccapx);
 
-            hmac_ctx_dispose(&hmac_ctx);
+        if (rc == -1) {
+            fprintf(stderr, "Could not allocate the handshakes of the watched captures, exiting.\n");
+            break;
         }
-        printf("None of the tested passwords matches...\n");
-        fclose(wordlist);
-        exit(0);
+    }
+
+    if (queued_cnt > 0) {
+        handshake_dedup(queued, &queued_cnt);
+        engine_add_targets(engine, queued, queued_cnt);
+
+        printf("Cracking %" PRIu32 " new handshakes of %" PRIu32 " ESSIDs.\n", queued_cnt, engine->groups_cnt);
+
+        if (bloom) {
+            bloom_dispose(bloom);
+            bloom_init(bloom, (uint64_t) options->dedup_mib * 1024 * 1024);
+        }
+    }
+
+    free(queued);
+
+    return rc == -1 ? -1 : 0;
+}
+
+
+/** Main Function           ./wpa2 [-e essid] [-u MiB] [-r rules] [-t threads] [-q] <cap_file> <wordlist_file|wordlist_dir>...
+ *                          ./wpa2 -a 1 [-s skip] [-l limit] [options] <cap_file> <left_wordlist> <right_wordlist>
+ *                          ./wpa2 -a 3 [-1 charset] [-s skip] [-l limit] [options] <cap_file> <mask>
+ *                          ./wpa2 -a 6|7 [-1 charset] [-s skip] [-l limit] [options] <cap_file> <wordlist|mask>...
+ *                          ./wpa2 -a 8 [--markov-threshold n] [--markov-length min:max] [options] <cap_file> <sample>
+ *                          (every attack is preceded by the ESSID pre-pass unless --no-essid is given, and by the
+ *                          passwords of the potfile if --loopback is given; <cap_file> may be a hash file instead)
+ *                          ./wpa2 --watch [options] <cap_dir> <attack arguments>...
+ *                          (the attack is run again for the handshakes of every capture written to the directory,
+ *                          as --follow does for the handshakes completed in a capture being written)
+ *                          ./wpa2 wordlist dedup [options] -o <output> <input>...
+ *                          ./wpa2 precompute [options] -o <table_dir> <essid_list> <wordlist>... */
+int main(int argc, char **argv) {
+
+    options_t options;
+    cap_ctx_t *cap_ctx = NULL;
+    watch_t watch;
+    handshake_index_t queued_index;
+    hccapx_t *hccapx = NULL;
+    engine_t engine;
+    bloom_t bloom;
+    rules_t rules;
+    mask_t mask;
+    markov_t markov;
+    pmkcache_t pmkcache;
+    potfile_t potfile;
+    keyspace_t keyspace;
+
+    uint32_t hccapx_cnt = 0, cracked_cnt = 0, reported = 0;
+
+    int rc = 0;
+
+    if (argc >= 3 && strcmp(argv[1], "wordlist") == 0 && strcmp(argv[2], "dedup") == 0) {
+        argv[2] = argv[0];
+        exit(dedup_main(argc - 2, argv + 2) == 0 ? 0 : -1);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "precompute") == 0) {
+        argv[1] = argv[0];
+        exit(pmktable_main(argc - 1, argv + 1) == 0 ? 0 : -1);
+    }
+
+    check_arguments(argc, argv, &options);
+
+    /* Loaded once, the lines appended later on (by this run or concurrent ones) are loaded when needed */
+    if (options.potfile && potfile_open(&potfile, options.potfile) != 0) {
+        fprintf(stderr, "Error in reading potfile \"%s\", exiting.\n", options.potfile);
+        exit(-1);
+    }
+
+    if (options.mask) {
+        compile_mask(&options, &mask);
+        keyspace_init_mask(&keyspace, &mask, options.attack_mode == ATTACK_MODE_HYBRID_MW);
+    } else if (options.markov_wordlist) {
+        if (markov_train(&markov, options.markov_wordlist, options.markov_min, options.markov_max,
+                         options.markov_threshold) != 0) {
+            exit(-1);
+        }
+        keyspace_init_markov(&keyspace, &markov);
+        printf("Markov model: %" PRIu32 " successors per character, keyspace of %" PRIu64 " candidates.\n",
+               markov.threshold, markov.keyspace);
+    } else if (options.inner_wordlist && keyspace_init_wordlist(&keyspace, options.inner_wordlist) != 0) {
+        fprintf(stderr, "Error in loading wordlist file \"%s\" (unreadable or empty), exiting.\n",
+                options.inner_wordlist);
+        exit(-1);
+    }
+
+    if (options.watch) {
+        /* The captures already in the directory are queued, and parsed along with the ones to come */
+        if (watch_open(&watch, options.cap_filename) != 0) {
+            fprintf(stderr, "Error in watching directory \"%s\", exiting.\n", options.cap_filename);
+            exit(-1);
+        }
+        handshake_index_init(&queued_index);
+    } else if (options.follow) {
+        cap_ctx = cap_ctx_new(options.threads);
+        if (cap_ctx == NULL) {
+            fprintf(stderr, "Error in processing capture file \"%s\", exiting.\n", options.cap_filename);
+            exit(-1);
+        }
+
+        hccapx = follow_cap_file(cap_ctx, &options, options.potfile ? &potfile : NULL, &hccapx_cnt);
     } else {
-        fprintf(stderr, "Error in opening wordlist file \"%s\", exiting.\n", argv[2]);
+        hccapx = process_cap_file(options.cap_filename, options.essid_filter, options.all, options.threads,
+                                  &hccapx_cnt);
+
+        /* Handshakes cracked in an earlier run are not cracked again */
+        skip_cracked(&options, options.potfile ? &potfile : NULL, hccapx, &hccapx_cnt);
+    }
+
+    /* A followed capture, or a watched directory, may hold no handshake yet */
+    if (hccapx_cnt == 0 && !options.follow && !options.watch) {
+        exit(0);
+    }
+
+    if (options.rules_filename) {
+        if (rules_load(&rules, options.rules_filename) != 0) {
+            fprintf(stderr, "Error in opening rule file \"%s\", exiting.\n", options.rules_filename);
+            exit(-1);
+        }
+
+        if (rules.rules_cnt == 0) {
+            fprintf(stderr, "No valid rules in rule file \"%s\", exiting.\n", options.rules_filename);
+            exit(-1);
+        }
+    }
+
+    if (options.pmk_cache && pmkcache_open(&pmkcache, options.pmk_cache, options.pmk_cache_slots) != 0) {
+        fprintf(stderr, "Error in opening PMK cache \"%s\", exiting.\n", options.pmk_cache);
         exit(-1);
     }
-}
 
+    if (options.dedup_mib) {
+        bloom_init(&bloom, (uint64_t) options.dedup_mib * 1024 * 1024);
+    }
+
+    /* A single engine goes through every wordlist, the capture is parsed only once */
+    engine_init(&engine, hccapx, hccapx_cnt, options.dedup_mib ? &bloom : NULL, options.rules_filename ? &rules : NULL,
+                options.pmk_cache ? &pmkcache : NULL, options.threads, options.quiet);
+
+    if (options.all && engine.targets_cnt > 0) {
+        printf("Cracking %" PRIu32 " handshakes of %" PRIu32 " ESSIDs, one PMK per ESSID and candidate.\n",
+               engine.targets_cnt, engine.groups_cnt);
+    }
+
+    running_engine = &engine;
+    signal(SIGINT, interrupt_handler);
+
+    for (;;) {
+        if (engine.remaining > 0) {
+            rc = run_attack(&engine, &options, options.potfile ? &potfile : NULL, &keyspace);
+        }
+
+        if ((!options.follow && !options.watch) || rc == -1 || engine.interrupted) break;
+
+        /* Follow and watch modes: the passwords are reported as soon as the attack is over, not when the run is */
+        cracked_cnt += report_cracked(&engine, &options, reported);
+        reported = engine.targets_cnt;
+
+        if (options.watch) {
+            rc = watch_captures(&watch, &queued_index, &engine, options.dedup_mib ? &bloom : NULL, &options,
+                                options.potfile ? &potfile : NULL);
+        } else {
+            follow_capture(cap_ctx, &engine, options.dedup_mib ? &bloom : NULL, &options,
+                           options.potfile ? &potfile : NULL);
+        }
+        if (rc == -1 || engine.interrupted) break;
+    }
+
+    if (options.attack_mode != ATTACK_MODE_STRAIGHT) {
+        keyspace_dispose(&keyspace);
+    }
+
+    if (options.markov_wordlist) {
+        markov_dispose(&markov);
+    }
+
+    signal(SIGINT, SIG_DFL);
+    running_engine = NULL;
 
+    for (uint32_t i = 0; i < options.wordlists_cnt; i++) {
+        free(options.wordlists[i]);
+    }
+    free(options.wordlists);
+
+    engine_dispose(&engine);
+
+    if (options.dedup_mib) {
+        bloom_dispose(&bloom);
+    }
+
+    if (options.rules_filename) {
+        rules_dispose(&rules);
+    }
 
+    if (options.pmk_cache) {
+        printf("PMK cache: %" PRIu64 " of %" PRIu64 " PMKs taken from the cache, %" PRIu64 " cached in total.\n",
+               pmkcache.hits, engine.derived, pmkcache.header->used);
+        if (pmkcache.full) {
+            printf("PMK cache full, it is grown the next time it is opened.\n");
+        }
+        pmkcache_close(&pmkcache);
+    }
+
+    /* Passwords cracked before an error (loopback, PMK tables, earlier wordlists) are reported and recorded anyway */
+    cracked_cnt += report_cracked(&engine, &options, reported);
+
+    if (rc == -1) {
+        exit(-1);
+    }
 
+    if (options.all) {
+        printf("%" PRIu32 " of %" PRIu32 " handshakes cracked.\n", cracked_cnt, engine.targets_cnt);
+    }
+
+    if (!engine.found && engine.interrupted && options.attack_mode != ATTACK_MODE_STRAIGHT) {
+        printf("Interrupted, resume with --skip %" PRIu64 "\n", engine.restore);
+    } else if (!engine.found && engine.interrupted) {
+        printf("Interrupted.\n");
+    } else if (cracked_cnt == 0) {
+        printf("None of the tested passwords matches...\n");
+    }
+
+    engine_free_targets(&engine);
+    free(hccapx);
+    cap_ctx_free(cap_ctx);
+
+    if (options.watch) {
+        watch_close(&watch);
+        handshake_index_dispose(&queued_index);
+    }
+
+    if (options.potfile) {
+        potfile_close(&potfile);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,82 @@
+#include "bloom.h"
+#include "hash.h"
+
+
+/**                         bloom_init(bloom_t*, uint64_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - bloom_check_and_add(bloom_t*, const unsigned char*, uint32_t);
+ *                          - bloom_dispose(bloom_t*);
+ *
+ *  Description:            Allocates an empty Bloom filter. The size is rounded down to a power of two so that bit
+ *                          positions can be derived by masking; memory stays bounded however many candidates are added,
+ *                          only the false positive rate grows.
+ *
+ *  @param bloom:           bloom_t struct that has to be initialized.
+ *  @param size_in_bytes:   memory budget of the filter (at least 8 bytes).
+ */
+void bloom_init(bloom_t *bloom, uint64_t size_in_bytes) {
+    bloom->num_of_bits = 64;
+    while (bloom->num_of_bits * 2 <= size_in_bytes * 8) {
+        bloom->num_of_bits *= 2;
+    }
+
+    bloom->bits = (uint64_t *) calloc(bloom->num_of_bits / 64, sizeof(uint64_t));
+    bloom->inserted = 0;
+}
+
+
+/**                         bloom_check_and_add(bloom_t*, const unsigned char*, uint32_t);
+ *
+ *  Requires:               - bloom_init(bloom_t*, uint64_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tests whether value has (probably) been added before and adds it. Bit positions are
+ *                          obtained by double hashing (h1 + i * h2). Bits are set atomically, so the filter can be
+ *                          shared between threads.
+ *
+ *  @param bloom:           filter that has to be queried and updated.
+ *  @param value:           candidate that has to be tested.
+ *  @param strlen:          length of the candidate.
+ *  @return:                true if every bit was already set (value seen before, or false positive), false otherwise.
+ */
+bit_t bloom_check_and_add(bloom_t *bloom, const unsigned char *value, uint32_t strlen) {
+    uint64_t h1 = hash64(value, strlen, 0);
+    uint64_t h2 = hash64(value, strlen, BLOOM_SEED) | 1;
+    uint64_t position, mask, old;
+    bit_t present = true;
+
+    for (uint32_t i = 0; i < BLOOM_HASHES; i++) {
+        position = (h1 + i * h2) & (bloom->num_of_bits - 1);
+        mask = 1ULL << (position & 63);
+
+        old = __atomic_fetch_or(&bloom->bits[position >> 6], mask, __ATOMIC_RELAXED);
+        if ((old & mask) == 0) {
+            present = false;
+        }
+    }
+
+    if (!present) {
+        __atomic_fetch_add(&bloom->inserted, 1, __ATOMIC_RELAXED);
+    }
+
+    return present;
+}
+
+
+/**                         bloom_dispose(bloom_t*);
+ *
+ *  Requires:               - bloom_init(bloom_t*, uint64_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that disposes the bit array of the filter.
+ *
+ *  @param bloom:           filter that has to be disposed.
+ */
+void bloom_dispose(bloom_t *bloom) {
+    free(bloom->bits);
+    bloom->bits = NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+/** Includes */
+#include "sha1.h"
+
+/** Defines */
+/** Number of bits set per inserted candidate (optimal for ~10 bits per candidate, ~1% false positives) */
+#define BLOOM_HASHES                    7
+
+/** Seed of the second hash function used by double hashing */
+#define BLOOM_SEED                      0x9e3779b97f4a7c15ULL
+
+/**
+ * Definition of the structure bloom_t, containing:
+ *
+ *  - bits:                 dynamic array of [num_of_bits / 64] words holding the filter.
+ *
+ *  - num_of_bits:          size of the filter in bits (a power of two).
+ *
+ *  - inserted:             number of candidates inserted so far.
+ */
+typedef struct {
+    uint64_t *bits;
+    uint64_t num_of_bits;
+    uint64_t inserted;
+} bloom_t;
+
+/** Function declarations */
+void bloom_init(bloom_t *bloom, uint64_t size_in_bytes);
+
+bit_t bloom_check_and_add(bloom_t *bloom, const unsigned char *value, uint32_t strlen);
+
+void bloom_dispose(bloom_t *bloom);
+
+#endif /* BLOOM_H */
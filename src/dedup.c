@@ -0,0 +1,802 @@
+#include "dedup.h"
+
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+
+/**
+ * Definition of the structure dedup_cursor_t, containing a sorted stream of records taking part in a merge:
+ *
+ *  - run:                  run the records are read from, NULL for a slice of the in-memory chunk.
+ *
+ *  - slice, slice_cnt, slice_pos: sorted pointers of the chunk, their number and the position of the next one.
+ *
+ *  - current:              record at the head of the stream, NULL once the stream is exhausted.
+ *
+ *  - buffer:               storage of current for records read from a run.
+ */
+typedef struct {
+    dedup_run_t *run;
+    dedup_record_t **slice;
+    uint64_t slice_cnt;
+    uint64_t slice_pos;
+    dedup_record_t *current;
+    uint64_t buffer[(sizeof(dedup_record_t) + PSK_HEX_LENGTH + 1) / sizeof(uint64_t) + 1];
+} dedup_cursor_t;
+
+/**
+ * Definition of the structure dedup_sort_t, containing the slice of the chunk sorted by a single thread:
+ *
+ *  - records, records_cnt: pointers that have to be sorted and their number.
+ *
+ *  - compare:              qsort comparator.
+ */
+typedef struct {
+    dedup_record_t **records;
+    uint64_t records_cnt;
+    int (*compare)(const void *, const void *);
+} dedup_sort_t;
+
+/** Sink receiving the records coming out of a merge */
+typedef void (*dedup_emit_t)(dedup_t *dedup, const dedup_record_t *record, void *arg);
+
+
+/**                         [Private] dedup_compare_word(const dedup_record_t*, const dedup_record_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Orders records by candidate bytes, then by length, then by first occurrence, so that the
+ *                          first copy of every duplicate group is its earliest occurrence in the input.
+ *
+ *  @param a:               first record.
+ *  @param b:               second record.
+ *  @return:                negative, zero or positive as a sorts before, equal to or after b.
+ */
+static int dedup_compare_word(const dedup_record_t *a, const dedup_record_t *b) {
+    int rc = memcmp(a->word, b->word, a->len < b->len ? a->len : b->len);
+
+    if (rc != 0) return rc;
+    if (a->len != b->len) return a->len < b->len ? -1 : 1;
+    if (a->seq != b->seq) return a->seq < b->seq ? -1 : 1;
+
+    return 0;
+}
+
+
+/**                         [Private] dedup_compare_seq(const dedup_record_t*, const dedup_record_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Orders records by first occurrence in the input.
+ *
+ *  @param a:               first record.
+ *  @param b:               second record.
+ *  @return:                negative, zero or positive as a sorts before, equal to or after b.
+ */
+static int dedup_compare_seq(const dedup_record_t *a, const dedup_record_t *b) {
+    if (a->seq != b->seq) return a->seq < b->seq ? -1 : 1;
+
+    return 0;
+}
+
+
+/** qsort wrappers of dedup_compare_word and dedup_compare_seq */
+static int dedup_qsort_word(const void *p1, const void *p2) {
+    return dedup_compare_word(*(dedup_record_t **) p1, *(dedup_record_t **) p2);
+}
+
+static int dedup_qsort_seq(const void *p1, const void *p2) {
+    return dedup_compare_seq(*(dedup_record_t **) p1, *(dedup_record_t **) p2);
+}
+
+
+/**                         [Private] dedup_cursor_next(dedup_t*, dedup_cursor_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Advances the cursor to the next record of its run or slice. A run ending in the middle of
+ *                          a record, or that cannot be read, was not written in full: the dedup is failed.
+ *
+ *  @param dedup:           dedup context (tells whether runs hold the first occurrence).
+ *  @param cursor:          cursor that has to be advanced.
+ */
+static void dedup_cursor_next(dedup_t *dedup, dedup_cursor_t *cursor) {
+    dedup_record_t *record = (dedup_record_t *) cursor->buffer;
+    int len;
+
+    if (cursor->run == NULL) {
+        cursor->current = cursor->slice_pos < cursor->slice_cnt ? cursor->slice[cursor->slice_pos++] : NULL;
+        return;
+    }
+
+    cursor->current = NULL;
+
+    len = fgetc(cursor->run->file);
+    if (len == EOF) {
+        if (ferror(cursor->run->file)) {
+            fprintf(stderr, "%s: %s\n", dedup->temp_dir, strerror(errno));
+            dedup->error = true;
+        }
+        return;
+    }
+
+    record->len = (uint8_t) len;
+    record->seq = 0;
+
+    if (fread(record->word, 1, record->len, cursor->run->file) != record->len ||
+        (dedup->keep_order && fread(&record->seq, sizeof(uint64_t), 1, cursor->run->file) != 1)) {
+        fprintf(stderr, "%s: truncated temporary run\n", dedup->temp_dir);
+        dedup->error = true;
+        return;
+    }
+
+    cursor->current = record;
+}
+
+
+/**                         [Private] dedup_heap_down(dedup_cursor_t**, uint32_t, uint32_t, int (*)(...));
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Restores the min-heap property of the cursors (ordered by their current record) from the
+ *                          given position downwards.
+ *
+ *  @param heap:            array of cursors organized as a binary heap.
+ *  @param heap_cnt:        number of cursors in the heap.
+ *  @param index:           position that may violate the heap property.
+ *  @param compare:         record comparator.
+ */
+static void dedup_heap_down(dedup_cursor_t **heap, uint32_t heap_cnt, uint32_t index,
+                            int (*compare)(const dedup_record_t *, const dedup_record_t *)) {
+    dedup_cursor_t *temp;
+    uint32_t child;
+
+    for (;;) {
+        child = index * 2 + 1;
+        if (child >= heap_cnt) break;
+
+        if (child + 1 < heap_cnt && compare(heap[child + 1]->current, heap[child]->current) < 0) child++;
+        if (compare(heap[index]->current, heap[child]->current) <= 0) break;
+
+        temp = heap[index];
+        heap[index] = heap[child];
+        heap[child] = temp;
+        index = child;
+    }
+}
+
+
+/**                         [Private] dedup_merge(dedup_t*, dedup_cursor_t*, uint32_t, int (*)(...), bit_t, ...);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            K-way merge of sorted cursors through a binary heap. When unique is set, only the first
+ *                          record of every group of equal candidates is emitted, which, given dedup_compare_word, is
+ *                          the earliest occurrence. The merge stops as soon as the dedup has failed.
+ *
+ *  @param dedup:           dedup context.
+ *  @param cursors:         array of cursors, positioned on their first record.
+ *  @param cursors_cnt:     number of cursors.
+ *  @param compare:         record comparator the cursors are sorted by.
+ *  @param unique:          true if duplicate candidates have to be dropped.
+ *  @param emit:            sink receiving the merged records.
+ *  @param arg:             argument passed to emit.
+ */
+static void dedup_merge(dedup_t *dedup, dedup_cursor_t *cursors, uint32_t cursors_cnt,
+                        int (*compare)(const dedup_record_t *, const dedup_record_t *), bit_t unique,
+                        dedup_emit_t emit, void *arg) {
+    dedup_cursor_t **heap = (dedup_cursor_t **) malloc(cursors_cnt * sizeof(dedup_cursor_t *));
+    uint64_t last_buffer[(sizeof(dedup_record_t) + PSK_HEX_LENGTH + 1) / sizeof(uint64_t) + 1];
+    dedup_record_t *last = (dedup_record_t *) last_buffer;
+    bit_t has_last = false;
+    uint32_t heap_cnt = 0;
+    int32_t i;
+
+    for (i = 0; i < (int32_t) cursors_cnt; i++) {
+        if (cursors[i].current) heap[heap_cnt++] = &cursors[i];
+    }
+
+    for (i = (int32_t) heap_cnt / 2 - 1; i >= 0; i--) {
+        dedup_heap_down(heap, heap_cnt, i, compare);
+    }
+
+    while (heap_cnt > 0 && !dedup->error) {
+        dedup_record_t *record = heap[0]->current;
+
+        if (!unique || !has_last || last->len != record->len || memcmp(last->word, record->word, record->len) != 0) {
+            emit(dedup, record, arg);
+
+            if (unique) {
+                memcpy(last, record, sizeof(dedup_record_t) + record->len);
+                has_last = true;
+            }
+        }
+
+        dedup_cursor_next(dedup, heap[0]);
+        if (heap[0]->current == NULL) {
+            heap[0] = heap[--heap_cnt];
+        }
+        dedup_heap_down(heap, heap_cnt, 0, compare);
+    }
+
+    free(heap);
+}
+
+
+/**                         [Private] dedup_write(dedup_t*, FILE*, uint8_t, const dedup_record_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Serializes a record in the given format.
+ *
+ *  @param dedup:           dedup context.
+ *  @param file:            output stream.
+ *  @param format:          DEDUP_FORMAT_TEXT, DEDUP_FORMAT_BINARY or DEDUP_FORMAT_RUN.
+ *  @param record:          record that has to be written.
+ */
+static void dedup_write(dedup_t *dedup, FILE *file, uint8_t format, const dedup_record_t *record) {
+    if (format == DEDUP_FORMAT_TEXT) {
+        fwrite(record->word, 1, record->len, file);
+        fputc('\n', file);
+        return;
+    }
+
+    fputc(record->len, file);
+    fwrite(record->word, 1, record->len, file);
+
+    if (format == DEDUP_FORMAT_RUN && dedup->keep_order) {
+        fwrite(&record->seq, sizeof(uint64_t), 1, file);
+    }
+}
+
+
+/** Sinks of dedup_merge: into a run, into the final output, into the in-memory chunk */
+static void dedup_emit_run(dedup_t *dedup, const dedup_record_t *record, void *arg) {
+    dedup_write(dedup, ((dedup_run_t *) arg)->file, DEDUP_FORMAT_RUN, record);
+}
+
+static void dedup_emit_output(dedup_t *dedup, const dedup_record_t *record, void *arg) {
+    dedup_write(dedup, (FILE *) arg, dedup->format, record);
+    dedup->unique++;
+}
+
+static int dedup_add(dedup_t *dedup, const unsigned char *word, uint8_t len, uint64_t seq,
+                     int (*qsort_compare)(const void *, const void *), bit_t unique);
+
+static void dedup_emit_chunk(dedup_t *dedup, const dedup_record_t *record, void *arg) {
+    if (dedup->error) return;
+
+    if (dedup_add(dedup, record->word, record->len, record->seq, (int (*)(const void *, const void *)) arg,
+                  false) != 0) {
+        dedup->error = true;
+    }
+}
+
+
+/**                         [Private] dedup_run_create(dedup_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends a new, empty run backed by an anonymous (already unlinked) file in the temporary
+ *                          directory, failing the dedup if it cannot be created.
+ *
+ *  @param dedup:           dedup context.
+ *  @return:                the new run, NULL if the temporary file could not be created.
+ */
+static dedup_run_t *dedup_run_create(dedup_t *dedup) {
+    dedup_run_t *run;
+    char *path;
+    int fd;
+
+    path = (char *) malloc(strlen(dedup->temp_dir) + sizeof("/wpa2-dedup-XXXXXX"));
+    sprintf(path, "%s/wpa2-dedup-XXXXXX", dedup->temp_dir);
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        free(path);
+        dedup->error = true;
+        return NULL;
+    }
+    unlink(path);
+    free(path);
+
+    dedup->runs = (dedup_run_t *) realloc(dedup->runs, (dedup->runs_cnt + 1) * sizeof(dedup_run_t));
+    run = &dedup->runs[dedup->runs_cnt++];
+
+    run->file = fdopen(fd, "w+b");
+    run->buffer = (char *) malloc(DEDUP_IO_BUFFER_SIZE);
+    setvbuf(run->file, run->buffer, _IOFBF, DEDUP_IO_BUFFER_SIZE);
+
+    return run;
+}
+
+
+/**                         [Private] dedup_run_dispose(dedup_run_t*);
+ *
+ *  Requires:               - dedup_run_create(dedup_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Closes (and thereby deletes) a run.
+ *
+ *  @param run:             run that has to be disposed.
+ */
+static void dedup_run_dispose(dedup_run_t *run) {
+    fclose(run->file);
+    free(run->buffer);
+}
+
+
+/**                         [Private] dedup_run_finish(dedup_t*, dedup_run_t*);
+ *
+ *  Requires:               - dedup_run_create(dedup_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Flushes a run once written, failing the dedup if any write to it failed (temporary
+ *                          directory full or over the file size limit), the run then missing records.
+ *
+ *  @param dedup:           dedup context.
+ *  @param run:             run that has been written.
+ *  @return:                0 on success, -1 on write error.
+ */
+static int dedup_run_finish(dedup_t *dedup, dedup_run_t *run) {
+    if (fflush(run->file) != 0 || ferror(run->file)) {
+        fprintf(stderr, "%s: %s\n", dedup->temp_dir, strerror(errno));
+        dedup->error = true;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**                         [Private] dedup_sort_slice(void*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Body of the sorting threads: sorts one slice of the in-memory chunk.
+ *
+ *  @param arg:             dedup_sort_t describing the slice.
+ *  @return:                NULL.
+ */
+static void *dedup_sort_slice(void *arg) {
+    dedup_sort_t *sort = (dedup_sort_t *) arg;
+
+    qsort(sort->records, sort->records_cnt, sizeof(dedup_record_t *), sort->compare);
+
+    return NULL;
+}
+
+
+/**                         [Private] dedup_flush(dedup_t*, int (*)(const void*, const void*), bit_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Sorts the in-memory chunk, splitting it among [threads] threads, then merges the sorted
+ *                          slices into a new run and empties the chunk.
+ *
+ *  @param dedup:           dedup context.
+ *  @param qsort_compare:   dedup_qsort_word or dedup_qsort_seq.
+ *  @param unique:          true if duplicate candidates have to be dropped.
+ *  @return:                0 on success, -1 if the run could not be created or written.
+ */
+static int dedup_flush(dedup_t *dedup, int (*qsort_compare)(const void *, const void *), bit_t unique) {
+    uint32_t threads = dedup->threads, i;
+    uint64_t slice_cnt, first;
+    pthread_t *tids;
+    dedup_sort_t *sorts;
+    dedup_cursor_t *cursors;
+    dedup_run_t *run;
+
+    if (dedup->records_cnt == 0) return 0;
+
+    if (threads > dedup->records_cnt) threads = (uint32_t) dedup->records_cnt;
+    slice_cnt = (dedup->records_cnt + threads - 1) / threads;
+
+    tids = (pthread_t *) malloc(threads * sizeof(pthread_t));
+    sorts = (dedup_sort_t *) malloc(threads * sizeof(dedup_sort_t));
+    cursors = (dedup_cursor_t *) malloc(threads * sizeof(dedup_cursor_t));
+
+    for (i = 0; i < threads; i++) {
+        first = i * slice_cnt;
+        sorts[i].records = dedup->records + first;
+        sorts[i].records_cnt = first >= dedup->records_cnt ? 0 :
+                               (dedup->records_cnt - first < slice_cnt ? dedup->records_cnt - first : slice_cnt);
+        sorts[i].compare = qsort_compare;
+        pthread_create(&tids[i], NULL, dedup_sort_slice, &sorts[i]);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+
+        cursors[i].run = NULL;
+        cursors[i].slice = sorts[i].records;
+        cursors[i].slice_cnt = sorts[i].records_cnt;
+        cursors[i].slice_pos = 0;
+        dedup_cursor_next(dedup, &cursors[i]);
+    }
+
+    run = dedup_run_create(dedup);
+    if (run) {
+        dedup_merge(dedup, cursors, threads, qsort_compare == dedup_qsort_word ? dedup_compare_word : dedup_compare_seq,
+                    unique, dedup_emit_run, run);
+        dedup_run_finish(dedup, run);
+    }
+
+    free(cursors);
+    free(sorts);
+    free(tids);
+
+    dedup->arena_used = 0;
+    dedup->records_cnt = 0;
+
+    return dedup->error ? -1 : 0;
+}
+
+
+/**                         [Private] dedup_add(dedup_t*, const unsigned char*, uint8_t, uint64_t, ...);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends a candidate to the in-memory chunk, flushing the chunk into a sorted run first if
+ *                          the candidate would exceed the memory budget.
+ *
+ *  @param dedup:           dedup context.
+ *  @param word:            candidate bytes.
+ *  @param len:             candidate length.
+ *  @param seq:             first occurrence of the candidate.
+ *  @param qsort_compare:   order of the runs produced when flushing.
+ *  @param unique:          true if duplicate candidates have to be dropped when flushing.
+ *  @return:                0 on success, -1 if a run could not be created or written, or on allocation failure.
+ */
+static int dedup_add(dedup_t *dedup, const unsigned char *word, uint8_t len, uint64_t seq,
+                     int (*qsort_compare)(const void *, const void *), bit_t unique) {
+    uint64_t size = (sizeof(dedup_record_t) + len + 7) & ~7ULL;
+    dedup_record_t *record, **records;
+
+    if (dedup->arena_used + size + (dedup->records_cnt + 1) * sizeof(dedup_record_t *) > dedup->memory_budget) {
+        if (dedup_flush(dedup, qsort_compare, unique) != 0) return -1;
+    }
+
+    if (dedup->records_cnt == dedup->records_size) {
+        records = (dedup_record_t **) realloc(dedup->records, (dedup->records_size ? dedup->records_size * 2 : 4096) *
+                                                              sizeof(dedup_record_t *));
+        if (records == NULL) {
+            fprintf(stderr, "Could not allocate the records of the in-memory chunk.\n");
+            dedup->error = true;
+            return -1;
+        }
+
+        dedup->records = records;
+        dedup->records_size = dedup->records_size ? dedup->records_size * 2 : 4096;
+    }
+
+    record = (dedup_record_t *) (dedup->arena + dedup->arena_used);
+    record->seq = seq;
+    record->len = len;
+    memcpy(record->word, word, len);
+
+    dedup->arena_used += size;
+    dedup->records[dedup->records_cnt++] = record;
+
+    return 0;
+}
+
+
+/**                         [Private] dedup_merge_runs(dedup_t*, uint32_t, uint32_t, int (*)(...), bit_t, ...);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Merges the runs in [first, first + count) into the given sink and disposes them.
+ *
+ *  @param dedup:           dedup context.
+ *  @param runs:            runs that have to be merged.
+ *  @param runs_cnt:        number of runs.
+ *  @param compare:         record comparator the runs are sorted by.
+ *  @param unique:          true if duplicate candidates have to be dropped.
+ *  @param emit:            sink receiving the merged records.
+ *  @param arg:             argument passed to emit.
+ */
+static void dedup_merge_runs(dedup_t *dedup, dedup_run_t *runs, uint32_t runs_cnt,
+                             int (*compare)(const dedup_record_t *, const dedup_record_t *), bit_t unique,
+                             dedup_emit_t emit, void *arg) {
+    dedup_cursor_t *cursors = (dedup_cursor_t *) malloc(runs_cnt * sizeof(dedup_cursor_t));
+    uint32_t i;
+
+    for (i = 0; i < runs_cnt; i++) {
+        cursors[i].run = &runs[i];
+        rewind(runs[i].file);
+        dedup_cursor_next(dedup, &cursors[i]);
+    }
+
+    dedup_merge(dedup, cursors, runs_cnt, compare, unique, emit, arg);
+
+    for (i = 0; i < runs_cnt; i++) {
+        dedup_run_dispose(&runs[i]);
+    }
+
+    free(cursors);
+}
+
+
+/**                         [Private] dedup_reduce(dedup_t*, int (*)(...), bit_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Merges groups of [DEDUP_MAX_FAN_IN] runs into larger runs until at most that many are left,
+ *                          so that the final merge never holds too many files open at once.
+ *
+ *  @param dedup:           dedup context.
+ *  @param compare:         record comparator the runs are sorted by.
+ *  @param unique:          true if duplicate candidates have to be dropped.
+ *  @return:                0 on success, -1 if a run could not be created, written or read back.
+ */
+static int dedup_reduce(dedup_t *dedup, int (*compare)(const dedup_record_t *, const dedup_record_t *), bit_t unique) {
+    dedup_run_t *runs, *merged;
+    uint32_t runs_cnt, i;
+
+    while (dedup->runs_cnt > DEDUP_MAX_FAN_IN) {
+        runs = dedup->runs;
+        runs_cnt = dedup->runs_cnt;
+        dedup->runs = NULL;
+        dedup->runs_cnt = 0;
+
+        for (i = 0; i < runs_cnt && !dedup->error; i += DEDUP_MAX_FAN_IN) {
+            merged = dedup_run_create(dedup);
+            if (merged == NULL) break;
+
+            dedup_merge_runs(dedup, runs + i, runs_cnt - i < DEDUP_MAX_FAN_IN ? runs_cnt - i : DEDUP_MAX_FAN_IN,
+                             compare, unique, dedup_emit_run, &dedup->runs[dedup->runs_cnt - 1]);
+            dedup_run_finish(dedup, &dedup->runs[dedup->runs_cnt - 1]);
+        }
+
+        /* On failure, the runs not merged yet are disposed here, the merged ones along with dedup->runs */
+        for (; i < runs_cnt; i++) {
+            dedup_run_dispose(&runs[i]);
+        }
+        free(runs);
+
+        if (dedup->error) return -1;
+    }
+
+    return 0;
+}
+
+
+/**                         [Private] dedup_usage(char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that prints the synopsis of the dedup mode and exits.
+ *
+ *  @param program:         name of the program.
+ */
+static void dedup_usage(char *program) {
+    fprintf(stderr, "Usage: %s wordlist dedup [options] -o <output> <input>...\n"
+                    "\n"
+                    "  -o, --output <file>     Deduplicated wordlist\n"
+                    "  -m, --memory <MiB>      Memory budget of the in-memory sort (default %d MiB)\n"
+                    "  -T, --temp-dir <dir>    Directory of the temporary sorted runs (default $TMPDIR or /tmp)\n"
+                    "  -j, --threads <n>       Sorting threads (default: online CPUs)\n"
+                    "  -b, --binary            Write a compiled wordlist instead of text\n"
+                    "  -k, --keep-order        Keep the order of first occurrence instead of sorting\n",
+            program, DEDUP_DEFAULT_MEMORY_MIB);
+    exit(-1);
+}
+
+
+/**                         [Private] dedup_is_psk(const unsigned char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether a line of PSK_HEX_LENGTH characters, too long to be a passphrase, is a raw
+ *                          PSK the engine can test: hex digits only.
+ *
+ *  @param line:            line of PSK_HEX_LENGTH characters.
+ *  @return:                true if the line is a raw PSK, false otherwise.
+ */
+static bit_t dedup_is_psk(const unsigned char *line) {
+    for (uint32_t i = 0; i < PSK_HEX_LENGTH; i++) {
+        if (!isxdigit(line[i])) return false;
+    }
+
+    return true;
+}
+
+
+/**                         dedup_main(int, char**);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Entry point of the "wordlist dedup" mode: external merge sort of one or more wordlists
+ *                          larger than memory. The input is cut into chunks fitting the memory budget, every chunk is
+ *                          sorted in parallel and written to the temporary directory as a duplicate free run, and the
+ *                          runs are finally merged dropping duplicates across them. With --keep-order the unique
+ *                          candidates are sorted a second time by first occurrence, which preserves the frequency
+ *                          ordering of the inputs.
+ *
+ *  @param argc:            argument counter, argv[0] being the program name.
+ *  @param argv:            argument vector of the mode.
+ *  @return:                0 on success, -1 on error.
+ */
+int dedup_main(int argc, char **argv) {
+
+    static struct option long_options[] = {
+            {"output",     required_argument, NULL, 'o'},
+            {"memory",     required_argument, NULL, 'm'},
+            {"temp-dir",   required_argument, NULL, 'T'},
+            {"threads",    required_argument, NULL, 'j'},
+            {"binary",     no_argument,       NULL, 'b'},
+            {"keep-order", no_argument,       NULL, 'k'},
+            {NULL, 0,                         NULL, 0}
+    };
+
+    dedup_t dedup;
+    wordlist_t wordlist;
+    dedup_run_t *runs;
+    FILE *output;
+
+    unsigned char password[PSK_HEX_LENGTH + 1];
+    uint32_t strlen_password, runs_cnt;
+    char *output_filename = NULL;
+    int option, rc = 0;
+
+    memset(&dedup, 0, sizeof(dedup_t));
+    dedup.memory_budget = (uint64_t) DEDUP_DEFAULT_MEMORY_MIB * 1024 * 1024;
+    dedup.temp_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    dedup.threads = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+    dedup.format = DEDUP_FORMAT_TEXT;
+
+    while ((option = getopt_long(argc, argv, "o:m:T:j:bk", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'o':
+                output_filename = optarg;
+                break;
+            case 'm':
+                dedup.memory_budget = (uint64_t) strtoul(optarg, NULL, 10) * 1024 * 1024;
+                break;
+            case 'T':
+                dedup.temp_dir = optarg;
+                break;
+            case 'j':
+                dedup.threads = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                dedup.format = DEDUP_FORMAT_BINARY;
+                break;
+            case 'k':
+                dedup.keep_order = true;
+                break;
+            default:
+                dedup_usage(argv[0]);
+        }
+    }
+
+    if (output_filename == NULL || optind == argc || dedup.memory_budget == 0 || dedup.threads == 0) {
+        dedup_usage(argv[0]);
+    }
+
+    dedup.arena = (unsigned char *) malloc(dedup.memory_budget);
+    if (dedup.arena == NULL) {
+        fprintf(stderr, "Could not allocate %" PRIu64 " MiB, exiting.\n", dedup.memory_budget / 1024 / 1024);
+        return -1;
+    }
+
+    /* Phase 1: duplicate free runs, sorted by candidate */
+    for (int i = optind; i < argc && rc == 0; i++) {
+        if (wordlist_open(&wordlist, argv[i]) != 0) {
+            fprintf(stderr, "Error in opening wordlist file \"%s\", exiting.\n", argv[i]);
+            rc = -1;
+            break;
+        }
+
+        /* Lines one character longer than any passphrase are read as well, they may be raw PSKs */
+        while (rc == 0 && (rc = wordlist_next_line(&wordlist, password, sizeof(password), &strlen_password)) == 1) {
+            if (strlen_password == PSK_HEX_LENGTH && !dedup_is_psk(password)) {
+                rc = 0;
+            } else {
+                rc = dedup_add(&dedup, password, (uint8_t) strlen_password, dedup.input++, dedup_qsort_word, true);
+            }
+        }
+
+        wordlist_close(&wordlist);
+
+        if (rc == -1 && !dedup.error) {
+            fprintf(stderr, "Error in reading wordlist file \"%s\", exiting.\n", argv[i]);
+        }
+    }
+
+    if (rc == 0) rc = dedup_flush(&dedup, dedup_qsort_word, true);
+    if (rc == 0) rc = dedup_reduce(&dedup, dedup_compare_word, true);
+
+    /* Phase 2 (keep order only): unique candidates sorted back by first occurrence */
+    if (rc == 0 && dedup.keep_order) {
+        runs = dedup.runs;
+        runs_cnt = dedup.runs_cnt;
+        dedup.runs = NULL;
+        dedup.runs_cnt = 0;
+
+        dedup_merge_runs(&dedup, runs, runs_cnt, dedup_compare_word, true, dedup_emit_chunk, dedup_qsort_seq);
+        free(runs);
+
+        rc = dedup.error ? -1 : dedup_flush(&dedup, dedup_qsort_seq, false);
+        if (rc == 0) rc = dedup_reduce(&dedup, dedup_compare_seq, false);
+    }
+
+    if (rc == 0) {
+        output = fopen(output_filename, "wb");
+
+        if (output) {
+            if (dedup.format == DEDUP_FORMAT_BINARY) {
+                fwrite(WORDLIST_BINARY_MAGIC, 1, WORDLIST_BINARY_MAGIC_LEN, output);
+            }
+
+            dedup_merge_runs(&dedup, dedup.runs, dedup.runs_cnt,
+                             dedup.keep_order ? dedup_compare_seq : dedup_compare_word, !dedup.keep_order,
+                             dedup_emit_output, output);
+            dedup.runs_cnt = 0;
+
+            if (ferror(output)) rc = -1;
+            if (fclose(output) != 0) rc = -1;
+
+            if (rc == -1) {
+                fprintf(stderr, "%s: %s\n", output_filename, strerror(errno));
+            }
+            if (dedup.error) rc = -1;
+        } else {
+            fprintf(stderr, "%s: %s\n", output_filename, strerror(errno));
+            rc = -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < dedup.runs_cnt; i++) {
+        dedup_run_dispose(&dedup.runs[i]);
+    }
+    free(dedup.runs);
+    free(dedup.records);
+    free(dedup.arena);
+
+    if (dedup.error) {
+        fprintf(stderr, "Error in sorting the candidates through \"%s\", exiting.\n", dedup.temp_dir);
+    }
+
+    if (rc == 0) {
+        printf("Read %" PRIu64 " candidates, written %" PRIu64 " unique candidates to: %s\n", dedup.input, dedup.unique,
+               output_filename);
+    }
+
+    return rc;
+}
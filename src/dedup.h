@@ -0,0 +1,102 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+/** Includes */
+#include "wordlist.h"
+
+/** Defines */
+/** Default memory budget in MiB of the in-memory sort */
+#define DEDUP_DEFAULT_MEMORY_MIB        1024
+
+/** Maximum number of sorted runs merged at once (bounded by open file descriptors) */
+#define DEDUP_MAX_FAN_IN                256
+
+/** Size of the stdio buffer attached to every run file */
+#define DEDUP_IO_BUFFER_SIZE            (64 * 1024)
+
+/** Output written as text, one candidate per line */
+#define DEDUP_FORMAT_TEXT               0
+
+/** Output written as a compiled wordlist (WORDLIST_BINARY_MAGIC) */
+#define DEDUP_FORMAT_BINARY             1
+
+/** Intermediate sorted run: [1 byte length][candidate][8 bytes first occurrence, only when keeping the order] */
+#define DEDUP_FORMAT_RUN                2
+
+/**
+ * Definition of the structure dedup_record_t, containing a candidate held in the in-memory arena:
+ *
+ *  - seq:                  position of the first occurrence of the candidate in the input.
+ *
+ *  - len:                  length of the candidate.
+ *
+ *  - word:                 candidate bytes (not NULL terminated).
+ */
+typedef struct {
+    uint64_t seq;
+    uint8_t len;
+    unsigned char word[];
+} dedup_record_t;
+
+/**
+ * Definition of the structure dedup_run_t, containing a sorted run written to the temporary directory:
+ *
+ *  - file:                 stream the run is written to and read back from. The file is unlinked as soon as it is
+ *                          created, so that no temporary file is left behind whatever happens.
+ *
+ *  - buffer:               stdio buffer of [DEDUP_IO_BUFFER_SIZE] bytes attached to file.
+ */
+typedef struct {
+    FILE *file;
+    char *buffer;
+} dedup_run_t;
+
+/**
+ * Definition of the structure dedup_t, containing:
+ *
+ *  - memory_budget:        maximum number of bytes used by arena and records together.
+ *
+ *  - temp_dir:             directory the sorted runs are written to.
+ *
+ *  - threads:              number of threads sorting the in-memory chunks.
+ *
+ *  - format:               DEDUP_FORMAT_TEXT or DEDUP_FORMAT_BINARY.
+ *
+ *  - keep_order:           true if the output keeps the order of first occurrence instead of being sorted.
+ *
+ *  - arena, arena_used:    buffer of [memory_budget] bytes holding the records, and bytes used in it.
+ *
+ *  - records, records_cnt: dynamic array of pointers to the records of the current chunk (accounted in the budget).
+ *
+ *  - records_size:         capacity of records.
+ *
+ *  - runs, runs_cnt:       dynamic array of the sorted runs written so far.
+ *
+ *  - input, unique:        number of candidates read and written.
+ *
+ *  - error:                true once the sort failed: a run could not be created, written in full (temporary directory
+ *                          full or over the file size limit) or read back, or the chunk could not grow. Merges stop
+ *                          and the dedup fails, instead of writing a truncated output.
+ */
+typedef struct {
+    uint64_t memory_budget;
+    const char *temp_dir;
+    uint32_t threads;
+    uint8_t format;
+    bit_t keep_order;
+    unsigned char *arena;
+    uint64_t arena_used;
+    dedup_record_t **records;
+    uint64_t records_cnt;
+    uint64_t records_size;
+    dedup_run_t *runs;
+    uint32_t runs_cnt;
+    uint64_t input;
+    uint64_t unique;
+    bit_t error;
+} dedup_t;
+
+/** Function declarations */
+int dedup_main(int argc, char **argv);
+
+#endif /* DEDUP_H */
@@ -0,0 +1,1247 @@
+#include "engine.h"
+#include "handshake.h"
+
+#include <string.h>
+
+/**                         min(unsigned char*, unsigned char*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function used to in order to determine which value is the minimum between AP MAC and
+ *                          Station MAC or AP Nonce and Station Nonce for a proper Pairwise Transient Key expansion.
+ *
+ *
+ * @param A:                Access Point MAC or Nonce.
+ * @param S:                Station MAC or Nonce.
+ * @param strlen:           Length of MAC (6 bytes) or length of Nonce (32 bytes).
+ * @return:                 Returns the Nonce or the MAC whose numerical value is lesser than the other.
+ */
+unsigned char *min(unsigned char *A, unsigned char *S, uint32_t strlen) {
+    for (uint32_t i = 0; i < strlen; i++) {
+        if (A[i] < S[i])
+            return A;
+        else if (A[i] > S[i])
+            return S;
+    }
+    return A;
+}
+
+/**                         max(unsigned char*, unsigned char*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function used to in order to determine which value is the maximum between AP MAC and
+ *                          Station MAC or AP Nonce and Station Nonce for a proper Pairwise Transient Key expansion.
+ *
+ *
+ * @param A:                Access Point MAC or Nonce.
+ * @param S:                Station MAC or Nonce.
+ * @param strlen:           Length of MAC (6 bytes) or length of Nonce (32 bytes).
+ * @return:                 Returns the Nonce or the MAC whose numerical value is greater than the other.
+ */
+unsigned char *max(unsigned char *A, unsigned char *S, uint32_t strlen) {
+    for (uint32_t i = 0; i < strlen; i++) {
+        if (A[i] > S[i])
+            return A;
+        else if (A[i] < S[i])
+            return S;
+    }
+    return A;
+}
+
+/**                         verify_mic(hmac_ctx_t*, hccapx_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that verifies if the hccapx structure MIC used for authentication is actually
+ *                          the same calculated, if so, it means the password was guessed.
+ *
+ * @param hmac_ctx:         Hmac context that holds the eapol MIC that has to be compared to the one in the hccapx struct.
+ * @param hccapx:           Hccapx struct that holds the eapol MIC that has to be compared to the one in the Hmac context.
+ * @return:                 bit_t boolean type, true if the MICs correspond, false if they don't.
+ */
+bit_t verify_mic(hmac_ctx_t *hmac_ctx, hccapx_t *hccapx) {
+
+    if ((hmac_ctx->digest[0] >> 24 & 0x000000ff) != hccapx->keymic[0]) return false;
+    if ((hmac_ctx->digest[0] >> 16 & 0x000000ff) != hccapx->keymic[1]) return false;
+    if ((hmac_ctx->digest[0] >> 8 & 0x000000ff) != hccapx->keymic[2]) return false;
+    if ((hmac_ctx->digest[0] & 0x000000ff) != hccapx->keymic[3]) return false;
+
+    if ((hmac_ctx->digest[1] >> 24 & 0x000000ff) != hccapx->keymic[4]) return false;
+    if ((hmac_ctx->digest[1] >> 16 & 0x000000ff) != hccapx->keymic[5]) return false;
+    if ((hmac_ctx->digest[1] >> 8 & 0x000000ff) != hccapx->keymic[6]) return false;
+    if ((hmac_ctx->digest[1] & 0x000000ff) != hccapx->keymic[7]) return false;
+
+    if ((hmac_ctx->digest[2] >> 24 & 0x000000ff) != hccapx->keymic[8]) return false;
+    if ((hmac_ctx->digest[2] >> 16 & 0x000000ff) != hccapx->keymic[9]) return false;
+    if ((hmac_ctx->digest[2] >> 8 & 0x000000ff) != hccapx->keymic[10]) return false;
+    if ((hmac_ctx->digest[2] & 0x000000ff) != hccapx->keymic[11]) return false;
+
+    if ((hmac_ctx->digest[3] >> 24 & 0x000000ff) != hccapx->keymic[12]) return false;
+    if ((hmac_ctx->digest[3] >> 16 & 0x000000ff) != hccapx->keymic[13]) return false;
+    if ((hmac_ctx->digest[3] >> 8 & 0x000000ff) != hccapx->keymic[14]) return false;
+    if ((hmac_ctx->digest[3] & 0x000000ff) != hccapx->keymic[15]) return false;
+
+    return true;
+}
+
+
+/**                         [Private] engine_free_groups(engine_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that frees the groups of the engine, along with the array of their
+ *                          members.
+ *
+ * @param engine:           engine_t struct whose groups have to be freed.
+ */
+static void engine_free_groups(engine_t *engine) {
+    if (engine->groups_cnt > 0) {
+        free(engine->groups[0].members);
+        free(engine->groups[0].clusters);
+    }
+    free(engine->groups);
+
+    engine->groups = NULL;
+    engine->groups_cnt = 0;
+}
+
+
+/**                         [Private] engine_group_targets(engine_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Groups the targets still tested (neither cracked nor retired) by ESSID, replacing the
+ *                          groups of the engine, if any. A single array holds the members of every group, each group
+ *                          taking a slice of it, and so does another one for the clusters: the contiguous targets of
+ *                          an AP/STA pair, ranked by handshake_dedup.
+ *
+ * @param engine:           engine whose targets have to be grouped.
+ */
+static void engine_group_targets(engine_t *engine) {
+
+    engine_group_t *group;
+    engine_target_t *target;
+    uint32_t *members, *clusters;
+
+    engine_free_groups(engine);
+
+    engine->groups = (engine_group_t *) calloc(engine->targets_cnt, sizeof(engine_group_t));
+    engine->groups_cnt = 0;
+    engine->remaining = 0;
+
+    members = (uint32_t *) malloc(engine->targets_cnt * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < engine->targets_cnt; i++) {
+        target = &engine->targets[i];
+        if (target->cracked || target->retired) continue;
+
+        engine->remaining++;
+
+        if (engine_find_group(engine, target->hccapx.essid, target->hccapx.essid_len) == NULL) {
+            group = &engine->groups[engine->groups_cnt++];
+            group->essid = target->hccapx.essid;
+            group->essid_len = target->hccapx.essid_len;
+        }
+    }
+
+    clusters = (uint32_t *) malloc((engine->remaining + engine->groups_cnt) * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < engine->groups_cnt; i++) {
+        group = &engine->groups[i];
+        group->members = members;
+        group->clusters = clusters;
+
+        for (uint32_t j = 0; j < engine->targets_cnt; j++) {
+            target = &engine->targets[j];
+            if (target->cracked || target->retired) continue;
+
+            if (engine_find_group(engine, target->hccapx.essid, target->hccapx.essid_len) == group) {
+                if (group->members_cnt == 0 ||
+                    !handshake_same_pair(&engine->targets[group->members[group->members_cnt - 1]].hccapx,
+                                         &target->hccapx)) {
+                    group->clusters[group->clusters_cnt++] = group->members_cnt;
+                }
+
+                group->members[group->members_cnt++] = j;
+            }
+        }
+
+        group->clusters[group->clusters_cnt] = group->members_cnt;
+        group->remaining = group->members_cnt;
+        members += group->members_cnt;
+        clusters += group->clusters_cnt + 1;
+    }
+
+    if (engine->groups_cnt == 0) {
+        free(members);
+        free(clusters);
+    }
+
+    engine->found = engine->remaining == 0;
+}
+
+
+/**                         engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - engine_test_password(engine_t*, unsigned char*, uint32_t);
+ *                          - engine_run_wordlist(engine_t*, const char*);
+ *                          - engine_dispose(engine_t*);
+ *
+ *  Description:            Initializes the engine that every candidate of the run goes through, whatever wordlist it
+ *                          comes from, so that the capture is parsed and the handshakes selected only once. The
+ *                          handshakes are grouped by ESSID: a candidate costs one pbkdf2 per group, whatever the
+ *                          number of handshakes sharing the ESSID.
+ *
+ * @param engine:           engine_t struct that has to be initialized.
+ * @param hccapx:           array of handshakes the candidates have to be tested against.
+ * @param hccapx_cnt:       number of handshakes (0 only if targets are added later on).
+ * @param bloom:            filter used to skip candidates already tested in an earlier wordlist, NULL to test them all.
+ * @param rules:            rules applied to every base word, NULL to test the base words only.
+ * @param pmkcache:         cache of PMKs consulted before, and filled after, running pbkdf2, NULL to disable it.
+ * @param threads:          number of worker threads (at least 1).
+ * @param quiet:            true if the candidates must not be printed while being tested.
+ */
+void engine_init(engine_t *engine, const hccapx_t *hccapx, uint32_t hccapx_cnt, bloom_t *bloom, rules_t *rules,
+                 pmkcache_t *pmkcache, uint32_t threads, bit_t quiet) {
+
+    memset(engine, 0, sizeof(engine_t));
+
+    engine->targets = (engine_target_t *) calloc(hccapx_cnt, sizeof(engine_target_t));
+    engine->targets_cnt = hccapx_cnt;
+
+    for (uint32_t i = 0; i < hccapx_cnt; i++) {
+        engine->targets[i].hccapx = hccapx[i];
+    }
+
+    engine_group_targets(engine);
+
+    engine->bloom = bloom;
+    engine->rules = rules;
+    engine->pmkcache = pmkcache;
+    engine->threads = threads;
+    engine->quiet = quiet;
+
+    pthread_mutex_init(&engine->mutex, NULL);
+}
+
+
+/**                         engine_add_targets(engine_t*, const hccapx_t*, uint32_t);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Adds the handshakes completed while the previous attack was running (follow mode), so
+ *                          that the next attack is run against them. The targets of the previous attack not cracked
+ *                          have gone through every candidate already: they are retired, only the new targets are
+ *                          tested from now on. Must not be called while workers are running.
+ *
+ * @param engine:           engine the targets have to be added to.
+ * @param hccapx:           array of handshakes that have to be added.
+ * @param hccapx_cnt:       number of handshakes.
+ */
+void engine_add_targets(engine_t *engine, const hccapx_t *hccapx, uint32_t hccapx_cnt) {
+
+    engine->targets = (engine_target_t *) realloc(engine->targets,
+                                                  (engine->targets_cnt + hccapx_cnt) * sizeof(engine_target_t));
+
+    for (uint32_t i = 0; i < engine->targets_cnt; i++) {
+        if (!engine->targets[i].cracked) engine->targets[i].retired = true;
+    }
+
+    memset(&engine->targets[engine->targets_cnt], 0, hccapx_cnt * sizeof(engine_target_t));
+
+    for (uint32_t i = 0; i < hccapx_cnt; i++) {
+        engine->targets[engine->targets_cnt++].hccapx = hccapx[i];
+    }
+
+    /* The groups point into the targets, which may have moved */
+    engine_group_targets(engine);
+}
+
+
+/**                         engine_find_group(engine_t*, const uint8_t*, uint32_t);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Looks for the group of the targets sharing an ESSID.
+ *
+ * @param engine:           engine holding the targets.
+ * @param essid:            ESSID of the group.
+ * @param essid_len:        length of the ESSID.
+ * @return:                 the group, NULL if no target has the ESSID.
+ */
+engine_group_t *engine_find_group(engine_t *engine, const uint8_t *essid, uint32_t essid_len) {
+
+    for (uint32_t i = 0; i < engine->groups_cnt; i++) {
+        if (engine->groups[i].essid_len == essid_len && memcmp(engine->groups[i].essid, essid, essid_len) == 0) {
+            return &engine->groups[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**                         [Private] engine_verify_pmkid(hccapx_t*, const uint32_t[8]);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Checks a Pairwise Master Key against the PMKID of the AP, sent in the first message of the
+ *                          handshake: PMKID = HMAC-SHA1(PMK, "PMK Name" || MAC_AP || MAC_STA), truncated to 128 bits.
+ *                          A single HMAC, against the two of the PTK expansion and MIC check.
+ *
+ * @param hccapx:           handshake holding the PMKID (in place of the MIC).
+ * @param pmk:              candidate PMK, as the 8 words output by pbkdf2.
+ * @return:                 bit_t boolean type, true if the PMK is the one of the PMKID, false otherwise.
+ */
+static bit_t engine_verify_pmkid(hccapx_t *hccapx, const uint32_t pmk[8]) {
+
+    hmac_ctx_t hmac_ctx;
+    bit_t found;
+
+    /* "PMK Name" (8 bytes), MAC_AP (6 bytes), MAC_STA (6 bytes): 20 bytes, 160 bits */
+    hmac_ctx_init(&hmac_ctx, 256, 160);
+
+    for (uint32_t i = 0; i < 8; i++) hmac_append_int_key(&hmac_ctx, pmk[i]);
+
+    hmac_append_str_text(&hmac_ctx, (unsigned char *) "PMK Name", 8);
+    hmac_append_str_text(&hmac_ctx, hccapx->mac_ap, 6);
+    hmac_append_str_text(&hmac_ctx, hccapx->mac_sta, 6);
+
+    hmac(&hmac_ctx);
+
+    found = verify_mic(&hmac_ctx, hccapx);
+
+    hmac_ctx_dispose(&hmac_ctx);
+
+    return found;
+}
+
+
+/**                         [Private] engine_verify(hccapx_t*, const uint32_t[8]);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Expands a Pairwise Master Key into the Pairwise Transient Key and checks the resulting MIC
+ *                          against the one of the handshake. Costs a few SHA-1 blocks, whatever the PMK comes from.
+ *                          PMKIDs are checked with a single HMAC instead.
+ *
+ * @param hccapx:           handshake the PMK has to be checked against.
+ * @param pmk:              candidate PMK, as the 8 words output by pbkdf2.
+ * @return:                 bit_t boolean type, true if the PMK is the one of the handshake, false otherwise.
+ */
+static bit_t engine_verify(hccapx_t *hccapx, const uint32_t pmk[8]) {
+
+    hmac_ctx_t hmac_ctx;
+    bit_t found;
+
+    if (hccapx->message_pair == HCCAPX_MESSAGE_PAIR_PMKID) {
+        return engine_verify_pmkid(hccapx, pmk);
+    }
+
+    /* Printing Pairwise Master Key */
+
+//            printf("+---------------------------------- PMK ----------------------------------+\n");
+//            printf("| %08x %08x %08x %08x %08x %08x %08x %08x |\n", pmk[0], pmk[1], pmk[2], pmk[3], pmk[4], pmk[5], pmk[6], pmk[7]);
+//            printf("+-------------------------------------------------------------------------+\n");
+
+    /*
+     * Inside the WPA2 protocol is mandatory to write, in the following order:
+     * - "Pairwise key expansion\0"     (22 bytes + 1 byte (terminating zero))
+     * - min(AP_MAC, STATION_MAC)       (6 bytes)
+     * - max(AP_MAC, STATION_MAC)       (6 bytes)
+     * - min(AP_NONCE, STATION_NONCE)   (32 bytes)
+     * - max(AP_NONCE, STATION_NONCE)   (32 bytes)
+     *
+     * For a total of 100 bytes, 800 bits
+     */
+    hmac_ctx_init(&hmac_ctx, 256, 800);
+
+    hmac_append_int_key(&hmac_ctx, pmk[0]);
+    hmac_append_int_key(&hmac_ctx, pmk[1]);
+    hmac_append_int_key(&hmac_ctx, pmk[2]);
+    hmac_append_int_key(&hmac_ctx, pmk[3]);
+    hmac_append_int_key(&hmac_ctx, pmk[4]);
+    hmac_append_int_key(&hmac_ctx, pmk[5]);
+    hmac_append_int_key(&hmac_ctx, pmk[6]);
+    hmac_append_int_key(&hmac_ctx, pmk[7]);
+
+    hmac_append_str_text(&hmac_ctx, (unsigned char *) "Pairwise key expansion", 22);
+    hmac_append_char_text(&hmac_ctx, 0x00);
+    hmac_append_str_text(&hmac_ctx, min(hccapx->mac_ap, hccapx->mac_sta, 6), 6);
+    hmac_append_str_text(&hmac_ctx, max(hccapx->mac_ap, hccapx->mac_sta, 6), 6);
+    hmac_append_str_text(&hmac_ctx, min(hccapx->nonce_ap, hccapx->nonce_sta, 32), 32);
+    hmac_append_str_text(&hmac_ctx, max(hccapx->nonce_ap, hccapx->nonce_sta, 32), 32);
+    hmac_append_char_text(&hmac_ctx, 0x00);
+
+    hmac(&hmac_ctx);
+
+    /* Printing Key Confirmation Key, calculated truncating the Pairwise Transient Key, calculated via hmac_sha1
+    using the protocol defined above. */
+//
+//            printf("+---------------------------------- KCK ----------------------------------+\n");
+//            printf("| %08x %08x %08x %08x %35s |\n", hmac_ctx.digest[0], hmac_ctx.digest[1], hmac_ctx.digest[2], hmac_ctx.digest[3], " ");
+//            printf("+-------------------------------------------------------------------------+\n");
+
+    hmac_ctx_dispose(&hmac_ctx);
+
+    hmac_ctx_init(&hmac_ctx, 128, hccapx->eapol_len * 8);
+
+    hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[0]);
+    hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[1]);
+    hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[2]);
+    hmac_append_int_key(&hmac_ctx, hmac_ctx.digest[3]);
+
+    hmac_append_str_text(&hmac_ctx, hccapx->eapol, hccapx->eapol_len);
+
+    hmac(&hmac_ctx);
+
+
+    /* Printing Message Integrity Code, calculated via hmac_sha1, processing the whole eapol message using KCK as Key */
+//
+//            printf("+---------------------------------- MIC ----------------------------------+\n");
+//            printf("| %08x %08x %08x %08x %35s |\n", hmac_ctx.digest[0], hmac_ctx.digest[1], hmac_ctx.digest[2], hmac_ctx.digest[3], " ");
+//            printf("+-------------------------------------------------------------------------+\n");
+
+    found = verify_mic(&hmac_ctx, hccapx);
+
+    hmac_ctx_dispose(&hmac_ctx);
+
+    return found;
+}
+
+
+/**                         [Private] engine_record_password(engine_t*, engine_group_t*, engine_target_t*, ...);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Records the password of a target found by a worker, unless another worker found it first.
+ *                          The target is no longer tested from then on, and the workers stop once every target has
+ *                          been cracked.
+ *
+ * @param engine:           engine the password has been found with.
+ * @param group:            group of the target.
+ * @param target:           target cracked.
+ * @param password:         password, NULL terminated.
+ * @param strlen_password:  length of the password.
+ */
+static void engine_record_password(engine_t *engine, engine_group_t *group, engine_target_t *target,
+                                   const unsigned char *password, uint32_t strlen_password) {
+    pthread_mutex_lock(&engine->mutex);
+    if (!target->cracked) {
+        memcpy(target->password, password, strlen_password + 1);
+        target->strlen_password = strlen_password;
+        __atomic_store_n(&target->cracked, true, __ATOMIC_RELEASE);
+        __atomic_fetch_sub(&group->remaining, 1, __ATOMIC_RELEASE);
+
+        if (--engine->remaining == 0) {
+            __atomic_store_n(&engine->found, true, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&engine->mutex);
+}
+
+
+/**                         [Private] engine_retire_target(engine_t*, engine_group_t*, engine_target_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Stops testing a target, unless it has been cracked or retired meanwhile. The workers stop
+ *                          once every target has been either cracked or retired.
+ *
+ * @param engine:           engine holding the target.
+ * @param group:            group of the target.
+ * @param target:           target that has to be retired.
+ */
+static void engine_retire_target(engine_t *engine, engine_group_t *group, engine_target_t *target) {
+    pthread_mutex_lock(&engine->mutex);
+    if (!target->cracked && !target->retired) {
+        __atomic_store_n(&target->retired, true, __ATOMIC_RELEASE);
+        __atomic_fetch_sub(&group->remaining, 1, __ATOMIC_RELEASE);
+
+        if (--engine->remaining == 0) {
+            __atomic_store_n(&engine->found, true, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&engine->mutex);
+}
+
+
+/**                         [Private] engine_crack_cluster(engine_t*, engine_group_t*, uint32_t, ...);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Settles the other targets of a cluster once one of them has been cracked: they share its
+ *                          password, the ones the PMK matches are recorded as cracked, the others are broken
+ *                          handshakes of the pair and are retired.
+ *
+ * @param engine:           engine holding the targets.
+ * @param group:            group of the cluster.
+ * @param cluster:          index of the cluster in the group.
+ * @param pmk:              PMK that cracked a target of the cluster.
+ * @param password:         password (or raw PSK in hex) the PMK stands for, NULL terminated.
+ * @param strlen_password:  length of the password.
+ */
+static void engine_crack_cluster(engine_t *engine, engine_group_t *group, uint32_t cluster, const uint32_t pmk[8],
+                                 const unsigned char *password, uint32_t strlen_password) {
+
+    engine_target_t *target;
+
+    for (uint32_t i = group->clusters[cluster]; i < group->clusters[cluster + 1]; i++) {
+        target = &engine->targets[group->members[i]];
+
+        if (__atomic_load_n(&target->cracked, __ATOMIC_ACQUIRE) ||
+            __atomic_load_n(&target->retired, __ATOMIC_ACQUIRE)) continue;
+
+        if (engine_verify(&target->hccapx, pmk)) {
+            engine_record_password(engine, group, target, password, strlen_password);
+        } else {
+            engine_retire_target(engine, group, target);
+        }
+    }
+}
+
+
+/**                         engine_test_pmk(engine_t*, engine_group_t*, const uint32_t[8], ...);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Checks a Pairwise Master Key against the targets of a group not cracked yet, recording the
+ *                          password of the targets it matches. The targets of every cluster (AP/STA pair) are tested
+ *                          best ranked first, down to the first trusted one only: a trusted handshake stands for the
+ *                          whole pair, the lower ranked ones being a fallback for pairs without any. A PMKID is tested
+ *                          first but never trusted, so a bogus one does not hide the EAPOL handshakes of its pair.
+ *                          Once a target is cracked, the rest of its cluster is settled with the same PMK.
+ *
+ * @param engine:           engine holding the targets.
+ * @param group:            group whose ESSID the PMK was derived with.
+ * @param pmk:              candidate PMK, as the 8 words output by pbkdf2.
+ * @param password:         password (or raw PSK in hex) the PMK stands for, NULL terminated.
+ * @param strlen_password:  length of the password.
+ * @return:                 bit_t boolean type, true if the PMK cracked at least a target, false otherwise.
+ */
+bit_t engine_test_pmk(engine_t *engine, engine_group_t *group, const uint32_t pmk[8], const unsigned char *password,
+                      uint32_t strlen_password) {
+
+    engine_target_t *target;
+    bit_t cracked = false;
+
+    for (uint32_t c = 0; c < group->clusters_cnt; c++) {
+        for (uint32_t i = group->clusters[c]; i < group->clusters[c + 1]; i++) {
+            target = &engine->targets[group->members[i]];
+
+            if (__atomic_load_n(&target->cracked, __ATOMIC_ACQUIRE) ||
+                __atomic_load_n(&target->retired, __ATOMIC_ACQUIRE)) continue;
+
+            if (engine_verify(&target->hccapx, pmk)) {
+                engine_record_password(engine, group, target, password, strlen_password);
+                engine_crack_cluster(engine, group, c, pmk, password, strlen_password);
+                cracked = true;
+                break;
+            }
+
+            if (handshake_trusted(&target->hccapx)) break;
+        }
+    }
+
+    return cracked;
+}
+
+
+/**                         engine_test_password(engine_t*, unsigned char*, uint32_t);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Derives the Pairwise Master Key from the candidate via pbkdf2, once per group of targets
+ *                          not cracked yet (or for engine->only_group alone, if set), and checks it against the
+ *                          targets of the group. When the engine has a PMK cache, pbkdf2 only runs on a cache miss and
+ *                          its result is cached.
+ *
+ * @param engine:           engine holding the targets.
+ * @param password:         candidate password, NULL terminated.
+ * @param strlen_password:  length of the candidate password.
+ * @return:                 bit_t boolean type, true if the candidate cracked at least a target, false otherwise.
+ */
+bit_t engine_test_password(engine_t *engine, unsigned char *password, uint32_t strlen_password) {
+
+    engine_group_t *group;
+    uint32_t pmk[8];
+    bit_t cracked = false;
+
+    for (uint32_t i = 0; i < engine->groups_cnt; i++) {
+        group = &engine->groups[i];
+
+        if (engine->only_group && group != engine->only_group) continue;
+        if (__atomic_load_n(&group->remaining, __ATOMIC_ACQUIRE) == 0) continue;
+
+        if (engine->pmkcache == NULL ||
+            !pmkcache_lookup(engine->pmkcache, group->essid, group->essid_len, password, strlen_password, pmk)) {
+            pbkdf2_pmk(password, strlen_password, group->essid, group->essid_len, pmk);
+
+            if (engine->pmkcache) {
+                pmkcache_insert(engine->pmkcache, group->essid, group->essid_len, password, strlen_password, pmk);
+            }
+        }
+
+        __atomic_fetch_add(&engine->derived, 1, __ATOMIC_RELAXED);
+
+        if (engine_test_pmk(engine, group, pmk, password, strlen_password)) {
+            cracked = true;
+        }
+    }
+
+    return cracked;
+}
+
+
+/**                         [Private] engine_parse_psk(const unsigned char*, uint32_t[8]);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Decodes a raw PSK written as [PSK_HEX_LENGTH] hex digits into the PMK it stands for.
+ *
+ * @param hex:              candidate of PSK_HEX_LENGTH characters.
+ * @param pmk:              output PMK, as the 8 words output by pbkdf2.
+ * @return:                 true if the candidate is made of hex digits only, false otherwise.
+ */
+static bit_t engine_parse_psk(const unsigned char *hex, uint32_t pmk[8]) {
+    uint32_t nibble;
+
+    memset(pmk, 0, 8 * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < PSK_HEX_LENGTH; i++) {
+        if (hex[i] >= '0' && hex[i] <= '9') nibble = hex[i] - '0';
+        else if (hex[i] >= 'a' && hex[i] <= 'f') nibble = hex[i] - 'a' + 10;
+        else if (hex[i] >= 'A' && hex[i] <= 'F') nibble = hex[i] - 'A' + 10;
+        else return false;
+
+        pmk[i / 8] |= nibble << (28 - 4 * (i % 8));
+    }
+
+    return true;
+}
+
+
+/**                         [Private] engine_test_candidate(engine_t*, unsigned char*, uint32_t);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tests a single candidate on behalf of a worker, skipping it if the filter reports it as
+ *                          already tested (unless restricted to engine->only_group), and records it as the password
+ *                          of the targets it cracks. A candidate
+ *                          of exactly [PSK_HEX_LENGTH] hex digits, too long to be a passphrase, is a raw PSK: it is
+ *                          the PMK itself and goes straight to the PTK/MIC check.
+ *
+ * @param engine:           engine the candidate has to be tested with.
+ * @param password:         candidate password, NULL terminated.
+ * @param strlen_password:  length of the candidate password.
+ */
+static void engine_test_candidate(engine_t *engine, unsigned char *password, uint32_t strlen_password) {
+
+    uint32_t pmk[8];
+
+    if (strlen_password == PSK_HEX_LENGTH && !engine_parse_psk(password, pmk)) return;
+
+    if (engine->bloom && engine->only_group == NULL && bloom_check_and_add(engine->bloom, password, strlen_password)) {
+        __atomic_fetch_add(&engine->skipped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (!engine->quiet) {
+        printf("Testing password:\t%s\n", password);
+    }
+
+    /* A raw PSK does not depend on the ESSID, it is the PMK of every group */
+    if (strlen_password == PSK_HEX_LENGTH) {
+        for (uint32_t i = 0; i < engine->groups_cnt; i++) {
+            if (engine->only_group && &engine->groups[i] != engine->only_group) continue;
+            engine_test_pmk(engine, &engine->groups[i], pmk, password, strlen_password);
+        }
+        return;
+    }
+
+    __atomic_fetch_add(&engine->tested, 1, __ATOMIC_RELAXED);
+
+    engine_test_password(engine, password, strlen_password);
+}
+
+
+/**                         [Private] engine_worker(void*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Body of the worker threads. Each worker takes the next base word from the shared wordlist
+ *                          under the engine lock, then mangles it with every rule and tests the results outside the
+ *                          lock, so that only base words cross the storage path and mangling is spread over the
+ *                          workers. Terminates when the wordlist is exhausted, on read error or once the password is
+ *                          found by any worker.
+ *
+ * @param arg:              engine_t the worker belongs to.
+ * @return:                 NULL.
+ */
+static void *engine_worker(void *arg) {
+    engine_t *engine = (engine_t *) arg;
+
+    unsigned char word[PSK_HEX_LENGTH + 1], candidate[MAX_LENGTH];
+    uint32_t strlen_word, strlen_candidate;
+    int rc;
+
+    for (;;) {
+        pthread_mutex_lock(&engine->mutex);
+
+        if (engine->found || engine->error || engine->interrupted) {
+            pthread_mutex_unlock(&engine->mutex);
+            break;
+        }
+
+        /* Lines one character longer than any passphrase are read as well, they may be raw PSKs */
+        rc = wordlist_next_line(engine->wordlist, word, sizeof(word), &strlen_word);
+        if (rc == -1) {
+            engine->error = true;
+        }
+
+        pthread_mutex_unlock(&engine->mutex);
+
+        if (rc != 1) break;
+
+        if (engine->rules == NULL || strlen_word == PSK_HEX_LENGTH) {
+            engine_test_candidate(engine, word, strlen_word);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < engine->rules->rules_cnt; i++) {
+            if (__atomic_load_n(&engine->found, __ATOMIC_ACQUIRE) || engine->interrupted) break;
+
+            if (rules_apply(&engine->rules->rules[i], word, strlen_word, candidate, &strlen_candidate)) {
+                engine_test_candidate(engine, candidate, strlen_candidate);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+/**                         engine_run_wordlist(engine_t*, const char*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tests every line of the wordlist, mangled by every rule if the engine has rules, until the
+ *                          password is found, spreading the work over the worker threads. When the engine has a
+ *                          filter, candidates already tested (in this or in an earlier wordlist) are skipped without
+ *                          running pbkdf2 on them; being probabilistic, the filter may rarely skip an untested
+ *                          candidate.
+ *
+ * @param engine:           engine the candidates have to be tested with.
+ * @param path:             name of the wordlist file.
+ * @return:                 1 if the password was found, 0 if the wordlist was exhausted, -1 on error.
+ */
+int engine_run_wordlist(engine_t *engine, const char *path) {
+
+    wordlist_t wordlist;
+    pthread_t *workers;
+
+    uint64_t tested = engine->tested, skipped = engine->skipped;
+
+    if (wordlist_open(&wordlist, path) != 0) {
+        fprintf(stderr, "Error in opening wordlist file \"%s\".\n", path);
+        return -1;
+    }
+
+    engine->wordlist = &wordlist;
+    engine->error = false;
+
+    /* Lines come from blocks prefetched asynchronously, so storage latency is hidden behind pbkdf2 */
+    workers = (pthread_t *) malloc(engine->threads * sizeof(pthread_t));
+
+    for (uint32_t i = 0; i < engine->threads; i++) {
+        pthread_create(&workers[i], NULL, engine_worker, engine);
+    }
+
+    for (uint32_t i = 0; i < engine->threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+
+    wordlist_close(&wordlist);
+    engine->wordlist = NULL;
+
+    if (engine->error) {
+        fprintf(stderr, "Error in reading wordlist file \"%s\".\n", path);
+        return -1;
+    }
+
+    if (engine->bloom) {
+        printf("Wordlist \"%s\": %" PRIu64 " tested, %" PRIu64 " skipped as already tested.\n", path,
+               engine->tested - tested, engine->skipped - skipped);
+    }
+
+    return engine->found ? 1 : 0;
+}
+
+
+/**
+ * Definition of the structure engine_worker_t, containing the argument of a keyspace worker:
+ *
+ *  - engine:               engine the worker belongs to.
+ *
+ *  - id:                   index of the worker in engine->batch_starts.
+ */
+typedef struct {
+    engine_t *engine;
+    uint32_t id;
+} engine_worker_t;
+
+
+/**                         [Private] engine_keyspace_reserve(engine_t*, uint32_t, unsigned char*, uint32_t*, ...);
+ *
+ *  Requires:               [engine->mutex held]
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Reserves for a worker the next batch of at most [ENGINE_KEYSPACE_BATCH] candidates, all
+ *                          sharing the same outer word, moving to the next outer word once every inner element has
+ *                          been handed out. Batches are handed out in index order, so that the keyspace is enumerated
+ *                          deterministically whatever the number of workers.
+ *
+ * @param engine:           engine whose keyspace has to be reserved.
+ * @param id:               index of the worker in engine->batch_starts.
+ * @param outer:            output buffer receiving the outer word of the batch.
+ * @param strlen_outer:     output length of the outer word.
+ * @param first:            output first inner index of the batch.
+ * @param last:             output end of the inner indices of the batch (excluded).
+ * @return:                 true if a batch was reserved, false if the slice is exhausted.
+ */
+static bit_t engine_keyspace_reserve(engine_t *engine, uint32_t id, unsigned char outer[MAX_LENGTH],
+                                     uint32_t *strlen_outer, uint64_t *first, uint64_t *last) {
+    uint64_t inner_cnt = engine->keyspace->inner_cnt, start;
+    int rc;
+
+    if (engine->inner_next >= inner_cnt) {
+        if (engine->wordlist == NULL) return false;
+
+        rc = wordlist_next(engine->wordlist, engine->outer, &engine->strlen_outer);
+        if (rc == -1) engine->error = true;
+        if (rc != 1) return false;
+
+        engine->outer_index++;
+        engine->inner_next = 0;
+    }
+
+    /* The index of a candidate has to fit in 64 bits for the restore point to be expressed */
+    if (engine->outer_index > (UINT64_MAX - engine->inner_next) / inner_cnt) return false;
+
+    start = engine->outer_index * inner_cnt + engine->inner_next;
+    if (start >= engine->end_index) return false;
+
+    *first = engine->inner_next;
+    *last = inner_cnt - *first < ENGINE_KEYSPACE_BATCH ? inner_cnt : *first + ENGINE_KEYSPACE_BATCH;
+    if (*last - *first > engine->end_index - start) *last = *first + (engine->end_index - start);
+
+    memcpy(outer, engine->outer, engine->strlen_outer);
+    *strlen_outer = engine->strlen_outer;
+
+    engine->inner_next = *last;
+    engine->batch_starts[id] = start;
+
+    return true;
+}
+
+
+/**                         [Private] engine_keyspace_done(engine_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether a generated attack has nothing left to crack: every target, or every target
+ *                          of engine->only_group if set, has been cracked.
+ *
+ * @param engine:           engine running the attack.
+ * @return:                 true if the workers have to stop, false otherwise.
+ */
+static bit_t engine_keyspace_done(engine_t *engine) {
+    if (__atomic_load_n(&engine->found, __ATOMIC_ACQUIRE)) return true;
+
+    return engine->only_group && __atomic_load_n(&engine->only_group->remaining, __ATOMIC_ACQUIRE) == 0;
+}
+
+
+/**                         [Private] engine_keyspace_worker(void*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Body of the worker threads of a generated attack. Each worker reserves the next batch
+ *                          under the engine lock and builds its candidates straight into its own buffer, so that no
+ *                          candidate is ever stored or transferred between threads. The start of the batch in
+ *                          progress is published so that a restore point can be computed at any time.
+ *
+ * @param arg:              engine_worker_t describing the worker.
+ * @return:                 NULL.
+ */
+static void *engine_keyspace_worker(void *arg) {
+    engine_t *engine = ((engine_worker_t *) arg)->engine;
+    uint32_t id = ((engine_worker_t *) arg)->id;
+
+    unsigned char outer[MAX_LENGTH], candidate[MAX_LENGTH];
+    uint32_t strlen_outer, strlen_candidate;
+    uint64_t first, last, index;
+    bit_t reserved;
+
+    for (;;) {
+        pthread_mutex_lock(&engine->mutex);
+
+        engine->batch_starts[id] = UINT64_MAX;
+
+        reserved = !engine_keyspace_done(engine) && !engine->error && !engine->interrupted &&
+                   engine_keyspace_reserve(engine, id, outer, &strlen_outer, &first, &last);
+
+        pthread_mutex_unlock(&engine->mutex);
+
+        if (!reserved) break;
+
+        for (index = first; index < last; index++) {
+            if (engine_keyspace_done(engine) || engine->interrupted) break;
+
+            if (keyspace_candidate(engine->keyspace, outer, strlen_outer, index, candidate, &strlen_candidate)) {
+                engine_test_candidate(engine, candidate, strlen_candidate);
+            }
+        }
+
+        /* An interrupted batch stays published, it is where the keyspace has to be resumed from */
+        if (index < last) break;
+    }
+
+    return NULL;
+}
+
+
+/**                         engine_run_keyspace(engine_t*, const keyspace_t*, const char*, uint64_t, uint64_t);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tests the slice [skip, skip + limit) of a generated attack, spreading it over the worker
+ *                          threads. The candidate of index i combines outer word i / inner_cnt with inner element
+ *                          i % inner_cnt; outer words are streamed from the outer wordlist, inner elements are either
+ *                          mapped from the mask or looked up in memory. The keyspace can thus be split between
+ *                          processes or machines with --skip/--limit, and an interrupted run can be resumed from
+ *                          engine->restore.
+ *
+ * @param engine:           engine the candidates have to be tested with.
+ * @param keyspace:         inner part of the attack.
+ * @param outer_path:       name of the outer wordlist, NULL for the pure mask attack.
+ * @param skip:             first index of the slice.
+ * @param limit:            number of indices of the slice, 0 for the whole remaining keyspace.
+ * @return:                 1 if the password was found, 0 if the slice was exhausted or the run interrupted, -1 on
+ *                          error.
+ */
+int engine_run_keyspace(engine_t *engine, const keyspace_t *keyspace, const char *outer_path, uint64_t skip,
+                        uint64_t limit) {
+
+    wordlist_t wordlist;
+    engine_worker_t *workers;
+    pthread_t *threads;
+
+    uint64_t skip_outer = skip / keyspace->inner_cnt;
+    int rc = 1;
+
+    engine->keyspace = keyspace;
+    engine->wordlist = NULL;
+    engine->error = false;
+    engine->end_index = (limit == 0 || limit > UINT64_MAX - skip) ? UINT64_MAX : skip + limit;
+
+    /* Positioning on the outer word holding the first index of the slice */
+    engine->strlen_outer = 0;
+    engine->outer_index = skip_outer;
+    engine->inner_next = skip % keyspace->inner_cnt;
+
+    if (outer_path) {
+        if (wordlist_open(&wordlist, outer_path) != 0) {
+            fprintf(stderr, "Error in opening wordlist file \"%s\".\n", outer_path);
+            return -1;
+        }
+
+        engine->wordlist = &wordlist;
+
+        for (uint64_t i = 0; i <= skip_outer && rc == 1; i++) {
+            rc = wordlist_next(&wordlist, engine->outer, &engine->strlen_outer);
+        }
+
+        if (rc == -1) engine->error = true;
+        if (rc != 1) engine->inner_next = keyspace->inner_cnt;
+    } else if (skip_outer > 0) {
+        engine->inner_next = keyspace->inner_cnt;
+    }
+
+    engine->batch_starts = (uint64_t *) malloc(engine->threads * sizeof(uint64_t));
+    workers = (engine_worker_t *) malloc(engine->threads * sizeof(engine_worker_t));
+    threads = (pthread_t *) malloc(engine->threads * sizeof(pthread_t));
+
+    for (uint32_t i = 0; i < engine->threads; i++) {
+        engine->batch_starts[i] = UINT64_MAX;
+        workers[i].engine = engine;
+        workers[i].id = i;
+        pthread_create(&threads[i], NULL, engine_keyspace_worker, &workers[i]);
+    }
+
+    for (uint32_t i = 0; i < engine->threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* Batches are handed out in order, so everything below the oldest unfinished batch has been tested */
+    engine->restore = engine->outer_index * keyspace->inner_cnt + engine->inner_next;
+    for (uint32_t i = 0; i < engine->threads; i++) {
+        if (engine->batch_starts[i] < engine->restore) engine->restore = engine->batch_starts[i];
+    }
+
+    free(threads);
+    free(workers);
+    free(engine->batch_starts);
+    engine->batch_starts = NULL;
+    engine->keyspace = NULL;
+
+    if (outer_path) {
+        wordlist_close(&wordlist);
+        engine->wordlist = NULL;
+    }
+
+    if (engine->error) {
+        fprintf(stderr, "Error in reading wordlist file \"%s\".\n", outer_path);
+        return -1;
+    }
+
+    return engine->found ? 1 : 0;
+}
+
+
+/**                         [Private] engine_table_reserve(engine_t*, uint64_t*, uint64_t*);
+ *
+ *  Requires:               [engine->mutex held]
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Reserves for a worker the next [ENGINE_KEYSPACE_BATCH] records of the PMK table, checking
+ *                          that every record lies within the table (third party tables are not trusted).
+ *
+ * @param engine:           engine whose table has to be reserved.
+ * @param first:            output offset of the first record of the batch.
+ * @param last:             output offset following the last record of the batch.
+ * @return:                 true if a batch was reserved, false if the table is exhausted or corrupted.
+ */
+static bit_t engine_table_reserve(engine_t *engine, uint64_t *first, uint64_t *last) {
+    const pmktable_t *table = engine->table;
+    uint64_t offset = engine->table_next, record_len;
+    uint32_t strlen_password;
+
+    for (uint32_t i = 0; i < ENGINE_KEYSPACE_BATCH && offset < table->records_len; i++) {
+        strlen_password = (uint32_t) table->records[offset] - table->length_bias;
+        record_len = 1 + (uint64_t) strlen_password + 32;
+
+        if (table->records[offset] < table->length_bias || strlen_password >= MAX_LENGTH ||
+            record_len > table->records_len - offset) {
+            engine->error = true;
+            return false;
+        }
+
+        offset += record_len;
+    }
+
+    *first = engine->table_next;
+    *last = offset;
+    engine->table_next = offset;
+
+    return *first < *last;
+}
+
+
+/**                         [Private] engine_table_worker(void*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Body of the worker threads of a PMK table run: each worker reserves the next batch of
+ *                          records and checks their PMKs against the targets sharing the ESSID of the table, no pbkdf2
+ *                          involved. When the engine has a filter and the table covers its only group, the passphrases
+ *                          are added to the filter so that later wordlists skip them: with several groups, the other
+ *                          ESSIDs still have to test them.
+ *
+ * @param arg:              engine_t the worker belongs to.
+ * @return:                 NULL.
+ */
+static void *engine_table_worker(void *arg) {
+    engine_t *engine = (engine_t *) arg;
+
+    unsigned char password[MAX_LENGTH];
+    const unsigned char *record;
+    uint32_t strlen_password, pmk[8];
+    uint64_t first, last;
+    bit_t reserved;
+
+    for (;;) {
+        pthread_mutex_lock(&engine->mutex);
+        reserved = engine->table_group->remaining > 0 && !engine->error && !engine->interrupted &&
+                   engine_table_reserve(engine, &first, &last);
+        pthread_mutex_unlock(&engine->mutex);
+
+        if (!reserved) break;
+
+        while (first < last) {
+            if (__atomic_load_n(&engine->table_group->remaining, __ATOMIC_ACQUIRE) == 0 || engine->interrupted) break;
+
+            record = engine->table->records + first;
+            strlen_password = record[0] - engine->table->length_bias;
+            memcpy(password, record + 1, strlen_password);
+            password[strlen_password] = '\0';
+            record += 1 + strlen_password;
+
+            for (uint32_t i = 0; i < 8; i++) {
+                pmk[i] = (uint32_t) record[i * 4] << 24 | (uint32_t) record[i * 4 + 1] << 16 |
+                         (uint32_t) record[i * 4 + 2] << 8 | record[i * 4 + 3];
+            }
+
+            first += 1 + strlen_password + 32;
+
+            if (engine->bloom && engine->groups_cnt == 1) {
+                bloom_check_and_add(engine->bloom, password, strlen_password);
+            }
+
+            if (!engine->quiet) {
+                printf("Testing password:\t%s\n", password);
+            }
+
+            engine_test_pmk(engine, engine->table_group, pmk, password, strlen_password);
+        }
+    }
+
+    return NULL;
+}
+
+
+/**                         engine_run_table(engine_t*, const pmktable_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *                          - pmktable_open(pmktable_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tests every record of a precomputed PMK table (own table, coWPAtty hashfile or chunk of an
+ *                          airolib-ng database), spreading the records over the worker threads. Each record only costs
+ *                          the PTK/MIC check, so a table is exhausted orders of magnitude faster than the wordlist it
+ *                          was computed from.
+ *
+ * @param engine:           engine the records have to be tested with.
+ * @param table:            table computed for the ESSID of some of the targets.
+ * @return:                 1 if the password was found, 0 if the table was exhausted or the run interrupted, -1 on
+ *                          error.
+ */
+int engine_run_table(engine_t *engine, const pmktable_t *table) {
+
+    pthread_t *workers;
+
+    engine->table_group = engine_find_group(engine, table->essid, table->essid_len);
+    if (engine->table_group == NULL) {
+        fprintf(stderr, "PMK table computed for another ESSID.\n");
+        return -1;
+    }
+
+    engine->table = table;
+    engine->table_next = 0;
+    engine->error = false;
+
+    workers = (pthread_t *) malloc(engine->threads * sizeof(pthread_t));
+
+    for (uint32_t i = 0; i < engine->threads; i++) {
+        pthread_create(&workers[i], NULL, engine_table_worker, engine);
+    }
+
+    for (uint32_t i = 0; i < engine->threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+    engine->table = NULL;
+    engine->table_group = NULL;
+
+    if (engine->error) {
+        fprintf(stderr, "Corrupted PMK table.\n");
+        return -1;
+    }
+
+    return engine->found ? 1 : 0;
+}
+
+
+/**                         engine_dispose(engine_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that disposes the synchronization primitives of the engine. The targets,
+ *                          and the passwords found, are kept until engine_free_targets(engine_t*) is called.
+ *
+ * @param engine:           engine_t struct that has to be disposed.
+ */
+void engine_dispose(engine_t *engine) {
+    pthread_mutex_destroy(&engine->mutex);
+}
+
+
+/**                         engine_free_targets(engine_t*);
+ *
+ *  Requires:               - engine_init(engine_t*, const hccapx_t*, uint32_t, bloom_t*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that frees the targets of the engine and their groups.
+ *
+ * @param engine:           engine_t struct whose targets have to be freed.
+ */
+void engine_free_targets(engine_t *engine) {
+    engine_free_groups(engine);
+    free(engine->targets);
+}
@@ -0,0 +1,195 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+/** Includes */
+#include <pthread.h>
+#include <signal.h>
+#include "pbkdf2.h"
+#include "bloom.h"
+#include "rules.h"
+#include "keyspace.h"
+#include "pmkcache.h"
+#include "pmktable.h"
+
+/** Defines */
+/** Number of consecutive indices of a keyspace reserved at once by a worker */
+#define ENGINE_KEYSPACE_BATCH           64
+#include "../cap2hccapx/cap2hccapx.h"
+
+/**
+ * Definition of the structure engine_target_t, containing:
+ *
+ *  - hccapx:               handshake (or PMKID) the candidates are tested against.
+ *
+ *  - cracked:              true once the password of the handshake has been found, the handshake is no longer tested.
+ *
+ *  - retired:              true once the handshake has gone through a whole attack without being cracked, when targets
+ *                          are added for another one (follow mode), or once another handshake of its AP/STA pair has
+ *                          been cracked with a PMK it does not match (a broken handshake): it is no longer tested
+ *                          either.
+ *
+ *  - password:             the password (or raw PSK in hex) found, valid only if cracked is true.
+ *
+ *  - strlen_password:      length of the password, which may hold NULL bytes (mask charset ?b).
+ */
+typedef struct {
+    hccapx_t hccapx;
+    bit_t cracked;
+    bit_t retired;
+    unsigned char password[PSK_HEX_LENGTH + 1];
+    uint32_t strlen_password;
+} engine_target_t;
+
+/**
+ * Definition of the structure engine_group_t, containing the targets sharing an ESSID, hence a PMK for every
+ * candidate:
+ *
+ *  - essid, essid_len:     ESSID of the group, the salt of pbkdf2.
+ *
+ *  - members:              array of [members_cnt] indices of the targets of the group.
+ *
+ *  - members_cnt:          number of targets of the group.
+ *
+ *  - clusters:             array of [clusters_cnt + 1] offsets in members, the first target of every cluster (the
+ *                          contiguous targets of an AP/STA pair, best ranked first), then members_cnt.
+ *
+ *  - clusters_cnt:         number of clusters of the group.
+ *
+ *  - remaining:            number of targets of the group not cracked yet, pbkdf2 is skipped for the group once 0.
+ */
+typedef struct {
+    const uint8_t *essid;
+    uint32_t essid_len;
+    uint32_t *members;
+    uint32_t members_cnt;
+    uint32_t *clusters;
+    uint32_t clusters_cnt;
+    uint32_t remaining;
+} engine_group_t;
+
+/**
+ * Definition of the structure engine_t, containing:
+ *
+ *  - targets:              array of [targets_cnt] handshakes the candidates are tested against.
+ *
+ *  - targets_cnt:          number of targets.
+ *
+ *  - groups:               array of [groups_cnt] groups of the targets still tested, one per distinct ESSID.
+ *
+ *  - groups_cnt:           number of groups.
+ *
+ *  - remaining:            number of targets not cracked (nor retired) yet.
+ *
+ *  - bloom:                optional filter of the candidates already tested (NULL if cross-list dedup is disabled).
+ *
+ *  - rules:                optional rules every base word is mangled with (NULL to test the base words as they are).
+ *
+ *  - pmkcache:             optional cache of PMKs consulted before running pbkdf2 (NULL to always run it).
+ *
+ *  - threads:              number of worker threads testing candidates.
+ *
+ *  - quiet:                true if the candidates must not be printed while being tested.
+ *
+ *  - mutex:                serializes the workers on the shared wordlist and on the result.
+ *
+ *  - wordlist:             wordlist the workers are currently taking base (or outer) words from.
+ *
+ *  - error:                true if reading the current wordlist failed.
+ *
+ *  - keyspace:             keyspace the workers are currently generating candidates from.
+ *
+ *  - outer, strlen_outer:  outer word the next batch is combined with, and its length.
+ *
+ *  - outer_index:          index of the outer word in the outer wordlist.
+ *
+ *  - inner_next:           next inner index to be reserved by a worker for the current outer word.
+ *
+ *  - end_index:            end of the slice of the keyspace to be tested (index = outer_index * inner_cnt + inner).
+ *
+ *  - table:                PMK table the workers are currently testing.
+ *
+ *  - table_group:          group of the targets sharing the ESSID of the table.
+ *
+ *  - table_next:           offset of the next record of the table to be reserved by a worker.
+ *
+ *  - only_group:           group the candidates are tested against alone (ESSID pre-pass), NULL for every group. The
+ *                          candidates are then neither looked up in the filter nor added to it, since the other
+ *                          groups have not tested them.
+ *
+ *  - batch_starts:         first index of the batch every worker is testing, UINT64_MAX for idle workers.
+ *
+ *  - restore:              index the keyspace can be resumed from (every lower index has been tested), valid after
+ *                          an interrupted run.
+ *
+ *  - interrupted:          set asynchronously (e.g. by a signal handler) in order to stop the workers.
+ *
+ *  - tested:               number of candidates run through pbkdf2 so far.
+ *
+ *  - derived:              number of PMKs derived so far (one per candidate and group), by pbkdf2 or from the cache.
+ *
+ *  - skipped:              number of candidates skipped since the filter reported them as already tested.
+ *
+ *  - found:                true once every target still tested has been cracked.
+ */
+typedef struct {
+    engine_target_t *targets;
+    uint32_t targets_cnt;
+    engine_group_t *groups;
+    uint32_t groups_cnt;
+    uint32_t remaining;
+    bloom_t *bloom;
+    rules_t *rules;
+    pmkcache_t *pmkcache;
+    uint32_t threads;
+    bit_t quiet;
+    pthread_mutex_t mutex;
+    wordlist_t *wordlist;
+    bit_t error;
+    const keyspace_t *keyspace;
+    unsigned char outer[MAX_LENGTH];
+    uint32_t strlen_outer;
+    uint64_t outer_index;
+    uint64_t inner_next;
+    uint64_t end_index;
+    const pmktable_t *table;
+    engine_group_t *table_group;
+    uint64_t table_next;
+    engine_group_t *only_group;
+    uint64_t *batch_starts;
+    uint64_t restore;
+    volatile sig_atomic_t interrupted;
+    uint64_t tested;
+    uint64_t derived;
+    uint64_t skipped;
+    bit_t found;
+} engine_t;
+
+/** Function declarations */
+unsigned char *min(unsigned char *A, unsigned char *S, uint32_t strlen);
+
+unsigned char *max(unsigned char *A, unsigned char *S, uint32_t strlen);
+
+void engine_init(engine_t *engine, const hccapx_t *hccapx, uint32_t hccapx_cnt, bloom_t *bloom, rules_t *rules,
+                 pmkcache_t *pmkcache, uint32_t threads, bit_t quiet);
+
+void engine_add_targets(engine_t *engine, const hccapx_t *hccapx, uint32_t hccapx_cnt);
+
+engine_group_t *engine_find_group(engine_t *engine, const uint8_t *essid, uint32_t essid_len);
+
+bit_t engine_test_pmk(engine_t *engine, engine_group_t *group, const uint32_t pmk[8], const unsigned char *password,
+                      uint32_t strlen_password);
+
+bit_t engine_test_password(engine_t *engine, unsigned char *password, uint32_t strlen_password);
+
+int engine_run_wordlist(engine_t *engine, const char *path);
+
+int engine_run_keyspace(engine_t *engine, const keyspace_t *keyspace, const char *outer_path, uint64_t skip,
+                        uint64_t limit);
+
+int engine_run_table(engine_t *engine, const pmktable_t *table);
+
+void engine_dispose(engine_t *engine);
+
+void engine_free_targets(engine_t *engine);
+
+#endif /* ENGINE_H */
@@ -0,0 +1,210 @@
+#include "essid.h"
+#include "hash.h"
+
+#include <string.h>
+
+/** Suffixes appended to every base, most common first */
+static const char *essid_suffixes[] = {
+        "", "1", "12", "123", "1234", "12345", "123456", "1234567", "12345678", "123456789", "0", "2", "3", "4",
+        "5", "6", "7", "8", "9", "01", "007", "69", "88", "99", "321", "!", "!!", "1!", "123!", "@", "#", "$", "*",
+        "_", ".", "wifi", "WiFi", "WIFI", "wlan", "WLAN", "pass", "password", "admin", "home", "house", "net", "online",
+        "2g", "5g", "2.4", "guest", NULL
+};
+
+
+/**                         [Private] essid_add(essid_t*, const unsigned char*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends a variant to the keyspace unless it cannot be a WPA2 passphrase or has already been
+ *                          generated.
+ *
+ *  @param essid:           generator state.
+ *  @param variant:         candidate that has to be added.
+ *  @param strlen_variant:  length of the candidate.
+ */
+static void essid_add(essid_t *essid, const unsigned char *variant, uint32_t strlen_variant) {
+    uint64_t hash, slot;
+
+    if (strlen_variant < ESSID_MIN_LENGTH || strlen_variant >= MAX_LENGTH) return;
+    if (essid->generated >= ESSID_TABLE_SIZE / 2) return;
+
+    hash = hash64(variant, strlen_variant, 0) | 1;
+    slot = hash & (ESSID_TABLE_SIZE - 1);
+
+    while (essid->table[slot]) {
+        if (essid->table[slot] == hash) return;
+        slot = (slot + 1) & (ESSID_TABLE_SIZE - 1);
+    }
+
+    essid->table[slot] = hash;
+    essid->generated++;
+
+    keyspace_add_word(essid->keyspace, variant, strlen_variant);
+}
+
+
+/**                         [Private] essid_add_pair(essid_t*, const char*, uint32_t, const char*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends the concatenation of two strings as a variant.
+ *
+ *  @param essid:           generator state.
+ *  @param head:            first part of the variant.
+ *  @param strlen_head:     length of the first part.
+ *  @param tail:            second part of the variant.
+ *  @param strlen_tail:     length of the second part.
+ */
+static void essid_add_pair(essid_t *essid, const char *head, uint32_t strlen_head, const char *tail,
+                           uint32_t strlen_tail) {
+    unsigned char variant[2 * MAX_LENGTH];
+
+    if (strlen_head + strlen_tail >= MAX_LENGTH) return;
+
+    memcpy(variant, head, strlen_head);
+    memcpy(variant + strlen_head, tail, strlen_tail);
+
+    essid_add(essid, variant, strlen_head + strlen_tail);
+}
+
+
+/**                         [Private] essid_bases(const hccapx_t*, char[][MAX_LENGTH], uint32_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Derives the bases the variants are built from: the ESSID as is, in lower, upper and
+ *                          capitalized case, without separators, and its first and last words.
+ *
+ *  @param hccapx:          handshake holding the ESSID.
+ *  @param bases:           output array of [ESSID_MAX_BASES] NULL terminated bases.
+ *  @return:                number of bases (duplicates included, they are filtered when generating).
+ */
+static uint32_t essid_bases(const hccapx_t *hccapx, char bases[ESSID_MAX_BASES][MAX_LENGTH]) {
+    uint32_t len = hccapx->essid_len, bases_cnt = 0, compact_len = 0, start, end;
+    char essid[MAX_ESSID_LENGTH + 1], compact[MAX_ESSID_LENGTH + 1];
+
+    if (len > MAX_ESSID_LENGTH) len = MAX_ESSID_LENGTH;
+    memcpy(essid, hccapx->essid, len);
+    essid[len] = '\0';
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (essid[i] != ' ' && essid[i] != '-' && essid[i] != '_' && essid[i] != '.') compact[compact_len++] = essid[i];
+    }
+    compact[compact_len] = '\0';
+
+    for (uint32_t variant = 0; variant < 2; variant++) {
+        const char *source = variant == 0 ? essid : compact;
+
+        strcpy(bases[bases_cnt++], source);
+
+        strcpy(bases[bases_cnt], source);
+        for (char *c = bases[bases_cnt]; *c; c++) if (*c >= 'A' && *c <= 'Z') *c += 32;
+        bases_cnt++;
+
+        strcpy(bases[bases_cnt], source);
+        for (char *c = bases[bases_cnt]; *c; c++) if (*c >= 'a' && *c <= 'z') *c -= 32;
+        bases_cnt++;
+
+        strcpy(bases[bases_cnt], bases[bases_cnt - 2]);
+        if (bases[bases_cnt][0] >= 'a' && bases[bases_cnt][0] <= 'z') bases[bases_cnt][0] -= 32;
+        bases_cnt++;
+    }
+
+    /* First and last word of multi-word ESSIDs ("FASTWEB-1-A1B2C3" -> "FASTWEB", "A1B2C3") */
+    for (end = 0; end < len && essid[end] != ' ' && essid[end] != '-' && essid[end] != '_'; end++);
+    if (end < len) {
+        memcpy(bases[bases_cnt], essid, end);
+        bases[bases_cnt++][end] = '\0';
+
+        for (start = len; start > 0 && essid[start - 1] != ' ' && essid[start - 1] != '-' &&
+                          essid[start - 1] != '_'; start--);
+        memcpy(bases[bases_cnt], essid + start, len - start);
+        bases[bases_cnt++][len - start] = '\0';
+    }
+
+    return bases_cnt;
+}
+
+
+/**                         essid_candidates(keyspace_t*, const hccapx_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - keyspace_candidate(const keyspace_t*, const unsigned char*, uint32_t, uint64_t, ...);
+ *                          - keyspace_dispose(keyspace_t*);
+ *
+ *  Description:            Generates the ESSID pre-pass: a few thousand variants of the network name (case changes,
+ *                          common suffixes, years) and of the AP MAC address (full, trailing digits, neighbouring
+ *                          addresses), which default and user chosen PSKs are often derived from. Variants are
+ *                          deduplicated and stored most likely first, in an in-memory keyspace that can be run as any
+ *                          other generated attack.
+ *
+ *  @param keyspace:        keyspace_t struct that has to be initialized with the variants.
+ *  @param hccapx:          handshake holding the ESSID and the AP MAC address.
+ *  @return:                number of variants generated.
+ */
+uint32_t essid_candidates(keyspace_t *keyspace, const hccapx_t *hccapx) {
+    essid_t *essid = (essid_t *) calloc(1, sizeof(essid_t));
+    char bases[ESSID_MAX_BASES][MAX_LENGTH], mac[6][13], year[5];
+    uint32_t bases_cnt, generated, mac_len;
+    uint64_t address = 0, neighbour;
+
+    keyspace_init_words(keyspace);
+    essid->keyspace = keyspace;
+
+    bases_cnt = essid_bases(hccapx, bases);
+
+    /* The AP MAC address in hex, lower and upper case, as is and incremented/decremented by one */
+    for (uint32_t i = 0; i < 6; i++) address = address << 8 | hccapx->mac_ap[i];
+
+    for (uint32_t i = 0; i < 3; i++) {
+        neighbour = (i == 0 ? address : (i == 1 ? address + 1 : address - 1)) & 0xffffffffffffULL;
+        sprintf(mac[i * 2], "%012" PRIx64, neighbour);
+        sprintf(mac[i * 2 + 1], "%012" PRIX64, neighbour);
+    }
+
+    for (uint32_t b = 0; b < bases_cnt; b++) {
+        for (uint32_t s = 0; essid_suffixes[s]; s++) {
+            essid_add_pair(essid, bases[b], (uint32_t) strlen(bases[b]), essid_suffixes[s],
+                           (uint32_t) strlen(essid_suffixes[s]));
+        }
+    }
+
+    for (uint32_t b = 0; b < bases_cnt; b++) {
+        for (uint32_t y = ESSID_YEAR_LAST; y >= ESSID_YEAR_FIRST; y--) {
+            sprintf(year, "%04" PRIu32, y);
+            essid_add_pair(essid, bases[b], (uint32_t) strlen(bases[b]), year, 4);
+            essid_add_pair(essid, year, 4, bases[b], (uint32_t) strlen(bases[b]));
+        }
+
+        for (uint32_t y = 0; y < 100; y++) {
+            sprintf(year, "%02" PRIu32, y);
+            essid_add_pair(essid, bases[b], (uint32_t) strlen(bases[b]), year, 2);
+        }
+    }
+
+    for (uint32_t m = 0; m < 6; m++) {
+        essid_add(essid, (unsigned char *) mac[m], 12);
+
+        /* Trailing 8, 6 and 4 hex digits, alone or appended to the bases */
+        for (mac_len = 8; mac_len >= 4; mac_len -= 2) {
+            essid_add(essid, (unsigned char *) mac[m] + 12 - mac_len, mac_len);
+
+            for (uint32_t b = 0; b < bases_cnt; b++) {
+                essid_add_pair(essid, bases[b], (uint32_t) strlen(bases[b]), mac[m] + 12 - mac_len, mac_len);
+            }
+        }
+    }
+
+    generated = essid->generated;
+    free(essid);
+
+    return generated;
+}
@@ -0,0 +1,42 @@
+#ifndef ESSID_H
+#define ESSID_H
+
+/** Includes */
+#include "keyspace.h"
+#include "../cap2hccapx/cap2hccapx.h"
+
+/** Defines */
+/** Minimum length of a WPA2 passphrase, shorter variants are never tested */
+#define ESSID_MIN_LENGTH                8
+
+/** Slots of the table deduplicating the variants (a power of two, at most half of it is filled) */
+#define ESSID_TABLE_SIZE                16384
+
+/** First year appended to and prepended to every base */
+#define ESSID_YEAR_FIRST                1970
+
+/** Last year appended to and prepended to every base (years are generated from the most recent) */
+#define ESSID_YEAR_LAST                 2030
+
+/** Maximum number of bases (case and separator variants of the ESSID) */
+#define ESSID_MAX_BASES                 16
+
+/**
+ * Definition of the structure essid_t, containing the state of the ESSID variant generator:
+ *
+ *  - keyspace:             in-memory wordlist the variants are appended to, in the order they have to be tested.
+ *
+ *  - table:                hashes of the variants generated so far (0 for empty slots).
+ *
+ *  - generated:            number of distinct variants appended to keyspace.
+ */
+typedef struct {
+    keyspace_t *keyspace;
+    uint64_t table[ESSID_TABLE_SIZE];
+    uint32_t generated;
+} essid_t;
+
+/** Function declarations */
+uint32_t essid_candidates(keyspace_t *keyspace, const hccapx_t *hccapx);
+
+#endif /* ESSID_H */
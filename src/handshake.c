@@ -0,0 +1,381 @@
+#include "handshake.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+/** From essid_len on, a hccapx struct only holds what the verification reads */
+#define HANDSHAKE_VERIFIED_SIZE         (sizeof(hccapx_t) - offsetof(hccapx_t, essid_len))
+
+/**
+ * Definition of the structure handshake_ref_t, a handshake being sorted:
+ *
+ *  - hccapx:               the handshake.
+ *
+ *  - index:                position of the handshake in the input.
+ *
+ *  - first:                lowest position in the input of a handshake of the same AP/STA pair.
+ *
+ *  - rank:                 rank of the handshake, as returned by handshake_rank.
+ *
+ *  - dropped:              true if an equivalent handshake of better rank is kept instead.
+ */
+typedef struct {
+    const hccapx_t *hccapx;
+    uint32_t index;
+    uint32_t first;
+    uint32_t rank;
+    bit_t dropped;
+} handshake_ref_t;
+
+/**
+ * Rank of every message pair, best first: the PMKID is computed by the AP itself; M32E2, M14E4 and M34E4 are
+ * authorized, the AP having answered (or the station having acknowledged) the MIC; M12E2 may be the attempt of a
+ * station mistyping the password; M32E3 and M34E3 are not even exported by cap2hccapx.
+ */
+static const uint32_t handshake_ranks[HANDSHAKE_RANKS] = {
+        [HCCAPX_MESSAGE_PAIR_PMKID] = 0,
+        [HANDSHAKE_M32E2] = 1,
+        [HANDSHAKE_M14E4] = 2,
+        [HANDSHAKE_M34E4] = 3,
+        [HANDSHAKE_M12E2] = 4,
+        [HANDSHAKE_M32E3] = 5,
+        [HANDSHAKE_M34E3] = 6,
+        [HANDSHAKE_M34E4 + 1] = 7     /* not a message pair */
+};
+
+
+/**                         handshake_rank(const hccapx_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Ranks a handshake by how reliably it stands for the password of its AP/STA pair: the
+ *                          message pair first, a replay counter mismatch ranking after every matching handshake.
+ *
+ *  @param hccapx:          handshake (or PMKID) that has to be ranked.
+ *  @return:                rank, lower is better.
+ */
+uint32_t handshake_rank(const hccapx_t *hccapx) {
+    uint32_t rank = handshake_ranks[hccapx->message_pair & HANDSHAKE_MESSAGE_PAIR_MASK];
+
+    if (hccapx->message_pair != HCCAPX_MESSAGE_PAIR_PMKID && (hccapx->message_pair & HANDSHAKE_REPLAY_COUNTER_BIT)) {
+        rank += HANDSHAKE_RANKS;
+    }
+
+    return rank;
+}
+
+
+/**                         handshake_trusted(const hccapx_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether a handshake can stand alone for its AP/STA pair: an authorized message pair
+ *                          whose replay counters match. The password of the pair is then the one of the handshake, the
+ *                          other handshakes of the pair need not be tested against every candidate. A PMKID, though
+ *                          ranked first, is not trusted: some APs send a bogus one, which must not hide the EAPOL
+ *                          handshakes of the pair.
+ *
+ *  @param hccapx:          handshake (or PMKID) that has to be evaluated.
+ *  @return:                true if the handshake is trusted, false otherwise.
+ */
+bit_t handshake_trusted(const hccapx_t *hccapx) {
+    return hccapx->message_pair != HCCAPX_MESSAGE_PAIR_PMKID &&
+           handshake_rank(hccapx) < handshake_ranks[HANDSHAKE_M12E2];
+}
+
+
+/**                         handshake_same_pair(const hccapx_t*, const hccapx_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether two handshakes belong to the same AP/STA pair of the same ESSID, hence share
+ *                          the password.
+ *
+ *  @param a:               first handshake.
+ *  @param b:               second handshake.
+ *  @return:                true if the handshakes share the ESSID, the AP MAC and the station MAC, false otherwise.
+ */
+bit_t handshake_same_pair(const hccapx_t *a, const hccapx_t *b) {
+    return a->essid_len == b->essid_len && memcmp(a->essid, b->essid, a->essid_len) == 0 &&
+           memcmp(a->mac_ap, b->mac_ap, 6) == 0 && memcmp(a->mac_sta, b->mac_sta, 6) == 0;
+}
+
+
+/**                         [Private] handshake_equivalent(const hccapx_t*, const hccapx_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether two handshakes are equivalent for the verification: they only differ by the
+ *                          message pair, so that a PMK matches either both or none of them.
+ *
+ *  @param a:               first handshake.
+ *  @param b:               second handshake.
+ *  @return:                true if the handshakes are equivalent, false otherwise.
+ */
+static bit_t handshake_equivalent(const hccapx_t *a, const hccapx_t *b) {
+    return memcmp(&a->essid_len, &b->essid_len, HANDSHAKE_VERIFIED_SIZE) == 0;
+}
+
+
+/**                         [Private] handshake_compare_pair(const handshake_ref_t*, const handshake_ref_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Orders handshakes by AP/STA pair, then by the fields the verification reads (everything
+ *                          but the message pair), then by rank and position, so that equivalent handshakes are
+ *                          contiguous, the best ranked first.
+ *
+ *  @param a:               first handshake.
+ *  @param b:               second handshake.
+ *  @return:                negative, zero or positive as a sorts before, equal to or after b.
+ */
+static int handshake_compare_pair(const handshake_ref_t *a, const handshake_ref_t *b) {
+    const hccapx_t *x = a->hccapx, *y = b->hccapx;
+    int rc;
+
+    if (x->essid_len != y->essid_len) return x->essid_len < y->essid_len ? -1 : 1;
+    if ((rc = memcmp(x->essid, y->essid, x->essid_len)) != 0) return rc;
+    if ((rc = memcmp(x->mac_ap, y->mac_ap, 6)) != 0) return rc;
+    if ((rc = memcmp(x->mac_sta, y->mac_sta, 6)) != 0) return rc;
+
+    if ((rc = memcmp(&x->essid_len, &y->essid_len, HANDSHAKE_VERIFIED_SIZE)) != 0) return rc;
+
+    if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+    if (a->index != b->index) return a->index < b->index ? -1 : 1;
+
+    return 0;
+}
+
+
+/**                         [Private] handshake_compare_rank(const handshake_ref_t*, const handshake_ref_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Orders handshakes by first occurrence of their AP/STA pair, then by rank and position.
+ *
+ *  @param a:               first handshake.
+ *  @param b:               second handshake.
+ *  @return:                negative, zero or positive as a sorts before, equal to or after b.
+ */
+static int handshake_compare_rank(const handshake_ref_t *a, const handshake_ref_t *b) {
+    if (a->first != b->first) return a->first < b->first ? -1 : 1;
+    if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+    if (a->index != b->index) return a->index < b->index ? -1 : 1;
+
+    return 0;
+}
+
+
+/** qsort wrappers of handshake_compare_pair and handshake_compare_rank */
+static int handshake_qsort_pair(const void *p1, const void *p2) {
+    return handshake_compare_pair((const handshake_ref_t *) p1, (const handshake_ref_t *) p2);
+}
+
+static int handshake_qsort_rank(const void *p1, const void *p2) {
+    return handshake_compare_rank((const handshake_ref_t *) p1, (const handshake_ref_t *) p2);
+}
+
+
+/**                         handshake_dedup(hccapx_t*, uint32_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Collapses the handshakes equivalent for the verification (same ESSID, MACs, nonces,
+ *                          EAPOL frame and MIC, whatever the message pair they were built from), keeping the best
+ *                          ranked of them, and ranks the rest: the handshakes of an AP/STA pair are made contiguous,
+ *                          best first, the pairs staying in order of first occurrence. The engine relies on this
+ *                          order to test the best handshake of every pair first.
+ *
+ *  @param hccapx:          array of handshakes, compacted and reordered in place.
+ *  @param hccapx_cnt:      number of handshakes, updated.
+ *  @return:                number of handshakes collapsed.
+ */
+uint32_t handshake_dedup(hccapx_t *hccapx, uint32_t *hccapx_cnt) {
+    handshake_ref_t *refs;
+    hccapx_t *sorted;
+    uint32_t kept = 0, first;
+
+    if (*hccapx_cnt < 2) return 0;
+
+    refs = (handshake_ref_t *) malloc(*hccapx_cnt * sizeof(handshake_ref_t));
+    sorted = (hccapx_t *) malloc(*hccapx_cnt * sizeof(hccapx_t));
+    if (refs == NULL || sorted == NULL) {
+        /* Not worth failing the run: the handshakes are simply tested as they are */
+        free(refs);
+        free(sorted);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < *hccapx_cnt; i++) {
+        refs[i].hccapx = &hccapx[i];
+        refs[i].index = i;
+        refs[i].rank = handshake_rank(&hccapx[i]);
+        refs[i].dropped = false;
+    }
+
+    qsort(refs, *hccapx_cnt, sizeof(handshake_ref_t), handshake_qsort_pair);
+
+    /* Every run of equivalent handshakes keeps its first, best ranked, handshake; every AP/STA pair takes the position
+     * of its first occurrence */
+    for (uint32_t start = 0, end; start < *hccapx_cnt; start = end) {
+        first = refs[start].index;
+
+        for (end = start + 1; end < *hccapx_cnt && handshake_same_pair(refs[start].hccapx, refs[end].hccapx); end++) {
+            if (refs[end].index < first) first = refs[end].index;
+            refs[end].dropped = handshake_equivalent(refs[end - 1].hccapx, refs[end].hccapx);
+        }
+
+        for (uint32_t i = start; i < end; i++) refs[i].first = first;
+    }
+
+    qsort(refs, *hccapx_cnt, sizeof(handshake_ref_t), handshake_qsort_rank);
+
+    for (uint32_t i = 0; i < *hccapx_cnt; i++) {
+        if (!refs[i].dropped) sorted[kept++] = *refs[i].hccapx;
+    }
+
+    memcpy(hccapx, sorted, kept * sizeof(hccapx_t));
+
+    free(sorted);
+    free(refs);
+
+    first = *hccapx_cnt;
+    *hccapx_cnt = kept;
+
+    return first - kept;
+}
+
+
+/**                         handshake_index_init(handshake_index_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - handshake_index_add(handshake_index_t*, const hccapx_t*);
+ *                          - handshake_index_dispose(handshake_index_t*);
+ *
+ *  Description:            Initializes an empty set of handshakes, allocated on the first insertion.
+ *
+ *  @param index:           handshake_index_t struct that has to be initialized.
+ */
+void handshake_index_init(handshake_index_t *index) {
+    memset(index, 0, sizeof(handshake_index_t));
+}
+
+
+/**                         [Private] handshake_index_find(const handshake_index_t*, const hccapx_t*, uint64_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Probes the table linearly from the home slot of the hash, until the handshake or an empty
+ *                          slot is found. Handshakes of equal hash are compared in full.
+ *
+ *  @param index:           set of handshakes, with at least one empty slot.
+ *  @param hccapx:          handshake that has to be found.
+ *  @param hash:            hash of the handshake.
+ *  @return:                the slot holding the handshake, or the empty slot it would be stored in.
+ */
+static uint32_t *handshake_index_find(const handshake_index_t *index, const hccapx_t *hccapx, uint64_t hash) {
+    uint32_t mask = index->slots_cnt - 1, *slot;
+
+    for (uint32_t i = (uint32_t) hash & mask;; i = (i + 1) & mask) {
+        slot = &index->slots[i];
+        if (*slot == 0) return slot;
+
+        if (index->hashes[*slot - 1] == hash && memcmp(&index->handshakes[*slot - 1], hccapx, sizeof(hccapx_t)) == 0) {
+            return slot;
+        }
+    }
+}
+
+
+/**                         handshake_index_add(handshake_index_t*, const hccapx_t*);
+ *
+ *  Requires:               - handshake_index_init(handshake_index_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Adds a handshake to the set, unless an identical one is already in it, so that a long
+ *                          lived run (watch mode) tells the handshakes already queued in constant time. The table is
+ *                          doubled and rebuilt once half full.
+ *
+ *  @param index:           set of handshakes.
+ *  @param hccapx:          handshake that has to be added.
+ *  @return:                1 if the handshake was added, 0 if it already was in the set, -1 on allocation failure.
+ */
+int handshake_index_add(handshake_index_t *index, const hccapx_t *hccapx) {
+    uint64_t hash = hash64((const unsigned char *) hccapx, sizeof(hccapx_t), 0), *hashes;
+    uint32_t size, *slots, *slot;
+    hccapx_t *handshakes;
+
+    if ((index->handshakes_cnt + 1) * 2 > index->slots_cnt) {
+        size = index->slots_cnt ? index->slots_cnt * 2 : HANDSHAKE_INDEX_SLOTS;
+        slots = (uint32_t *) calloc(size, sizeof(uint32_t));
+        if (slots == NULL) return -1;
+
+        free(index->slots);
+        index->slots = slots;
+        index->slots_cnt = size;
+
+        for (uint32_t i = 0; i < index->handshakes_cnt; i++) {
+            *handshake_index_find(index, &index->handshakes[i], index->hashes[i]) = i + 1;
+        }
+    }
+
+    slot = handshake_index_find(index, hccapx, hash);
+    if (*slot != 0) return 0;
+
+    if (index->handshakes_cnt == index->handshakes_size) {
+        size = index->handshakes_size ? index->handshakes_size * 2 : HANDSHAKE_INDEX_SLOTS / 2;
+
+        handshakes = (hccapx_t *) realloc(index->handshakes, size * sizeof(hccapx_t));
+        if (handshakes == NULL) return -1;
+        index->handshakes = handshakes;
+
+        hashes = (uint64_t *) realloc(index->hashes, size * sizeof(uint64_t));
+        if (hashes == NULL) return -1;
+        index->hashes = hashes;
+
+        index->handshakes_size = size;
+    }
+
+    index->handshakes[index->handshakes_cnt] = *hccapx;
+    index->hashes[index->handshakes_cnt++] = hash;
+    *slot = index->handshakes_cnt;
+
+    return 1;
+}
+
+
+/**                         handshake_index_dispose(handshake_index_t*);
+ *
+ *  Requires:               - handshake_index_init(handshake_index_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that frees a set of handshakes.
+ *
+ *  @param index:           set of handshakes that has to be freed.
+ */
+void handshake_index_dispose(handshake_index_t *index) {
+    free(index->handshakes);
+    free(index->hashes);
+    free(index->slots);
+}
@@ -0,0 +1,65 @@
+#ifndef HANDSHAKE_H
+#define HANDSHAKE_H
+
+/** Includes */
+#include "sha1.h"
+#include "../cap2hccapx/cap2hccapx.h"
+
+/** Defines */
+/** Bits of the message pair telling which messages the handshake was built from */
+#define HANDSHAKE_MESSAGE_PAIR_MASK     0x07
+
+/** Message pairs: the two messages of the exchange (AP, station) and the one the EAPOL frame and MIC come from */
+#define HANDSHAKE_M12E2                 0
+#define HANDSHAKE_M14E4                 1
+#define HANDSHAKE_M32E2                 2
+#define HANDSHAKE_M32E3                 3
+#define HANDSHAKE_M34E3                 4
+#define HANDSHAKE_M34E4                 5
+
+/** Bit of the message pair set when the replay counters of the two messages do not match (or were not checked) */
+#define HANDSHAKE_REPLAY_COUNTER_BIT    0x80
+
+/** Number of ranks of the message pair alone, a replay counter mismatch ranks after all of them */
+#define HANDSHAKE_RANKS                 8
+
+/** Initial number of slots of a handshake index (a power of two) */
+#define HANDSHAKE_INDEX_SLOTS           1024
+
+/**
+ * Definition of the structure handshake_index_t, a set of handshakes growing for the whole run:
+ *
+ *  - handshakes:           dynamic array of [handshakes_cnt] copies of the handshakes of the set, in insertion order.
+ *
+ *  - handshakes_size:      capacity of handshakes.
+ *
+ *  - hashes:               hash of every handshake of the set.
+ *
+ *  - slots, slots_cnt:     open addressing table of [slots_cnt] slots (a power of two, at most half full), every slot
+ *                          holding the position + 1 of a handshake, 0 if empty.
+ */
+typedef struct {
+    hccapx_t *handshakes;
+    uint64_t *hashes;
+    uint32_t handshakes_cnt;
+    uint32_t handshakes_size;
+    uint32_t *slots;
+    uint32_t slots_cnt;
+} handshake_index_t;
+
+/** Function declarations */
+uint32_t handshake_rank(const hccapx_t *hccapx);
+
+bit_t handshake_trusted(const hccapx_t *hccapx);
+
+bit_t handshake_same_pair(const hccapx_t *a, const hccapx_t *b);
+
+uint32_t handshake_dedup(hccapx_t *hccapx, uint32_t *hccapx_cnt);
+
+void handshake_index_init(handshake_index_t *index);
+
+int handshake_index_add(handshake_index_t *index, const hccapx_t *hccapx);
+
+void handshake_index_dispose(handshake_index_t *index);
+
+#endif /* HANDSHAKE_H */
@@ -0,0 +1,34 @@
+#include "hash.h"
+
+
+/**                         hash64(const unsigned char*, uint32_t, uint64_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Non cryptographic 64 bit hash used to index candidates and keys in memory and on disk:
+ *                          FNV-1a over the data followed by the splitmix64 finalizer, so that every output bit depends
+ *                          on every input byte. Different seeds give independent hash functions.
+ *
+ *  @param data:            bytes that have to be hashed.
+ *  @param strlen:          number of bytes in data.
+ *  @param seed:            value selecting the hash function.
+ *  @return:                64 bit hash of data.
+ */
+uint64_t hash64(const unsigned char *data, uint32_t strlen, uint64_t seed) {
+    uint64_t hash = HASH_OFFSET_BASIS ^ seed;
+
+    for (uint32_t i = 0; i < strlen; i++) {
+        hash ^= data[i];
+        hash *= HASH_PRIME;
+    }
+
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+
+    return hash;
+}
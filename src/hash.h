@@ -0,0 +1,17 @@
+#ifndef HASH_H
+#define HASH_H
+
+/** Includes */
+#include <stdint.h>
+
+/** Defines */
+/** FNV-1a 64 bit offset basis */
+#define HASH_OFFSET_BASIS               0xcbf29ce484222325ULL
+
+/** FNV-1a 64 bit prime */
+#define HASH_PRIME                      0x100000001b3ULL
+
+/** Function declarations */
+uint64_t hash64(const unsigned char *data, uint32_t strlen, uint64_t seed);
+
+#endif /* HASH_H */
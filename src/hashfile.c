@@ -0,0 +1,327 @@
+#include "hashfile.h"
+#include "handshake.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** Maximum number of '*' separated fields of a hash line (WPA*02 lines have 9) */
+#define HASHFILE_MAX_FIELDS             9
+
+
+/**                         hashfile_is_hashfile(const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether a file name is the one of a hash file: ".hccapx", ".22000", ".hc22000" or
+ *                          ".16800" extension.
+ *
+ *  @param name:            file name, possibly preceded by its directory.
+ *  @return:                true if the file is a hash file, false otherwise.
+ */
+bit_t hashfile_is_hashfile(const char *name) {
+    const char *base = strrchr(name, '/');
+    const char *extension = strrchr(name, '.');
+
+    if (extension == NULL || (base && extension < base)) return false;
+
+    return strcmp(extension, HCCAPX_EXTENSION) == 0 || strcmp(extension, HASHFILE_22000_EXTENSION) == 0 ||
+           strcmp(extension, HASHFILE_HC22000_EXTENSION) == 0 || strcmp(extension, PMKID_EXTENSION) == 0;
+}
+
+
+/**                         [Private] hashfile_parse_hex(const char*, uint32_t, uint8_t*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Decodes a field of exactly [2 * len] hex digits.
+ *
+ *  @param hex:             hex digits, not NULL terminated.
+ *  @param strlen_hex:      number of hex digits of the field.
+ *  @param bytes:           output buffer of [len] bytes.
+ *  @param len:             number of bytes the field has to hold.
+ *  @return:                0 on success, -1 if the field has another length or is not made of hex digits.
+ */
+static int hashfile_parse_hex(const char *hex, uint32_t strlen_hex, uint8_t *bytes, uint32_t len) {
+    uint8_t nibble;
+
+    if (strlen_hex != 2 * len) return -1;
+
+    for (uint32_t i = 0; i < strlen_hex; i++) {
+        if (hex[i] >= '0' && hex[i] <= '9') nibble = hex[i] - '0';
+        else if (hex[i] >= 'a' && hex[i] <= 'f') nibble = hex[i] - 'a' + 10;
+        else if (hex[i] >= 'A' && hex[i] <= 'F') nibble = hex[i] - 'A' + 10;
+        else return -1;
+
+        if (i % 2 == 0) bytes[i / 2] = nibble << 4;
+        else bytes[i / 2] |= nibble;
+    }
+
+    return 0;
+}
+
+
+/**                         [Private] hashfile_parse_line(const char*, uint32_t, hccapx_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Parses a hash line into a hccapx struct, the PMKIDs taking HCCAPX_MESSAGE_PAIR_PMKID as
+ *                          message pair and the PMKID as MIC:
+ *                          - WPA*01*PMKID*MAC_AP*MAC_STA*ESSID*** (hashcat -m 22000 PMKID);
+ *                          - WPA*02*MIC*MAC_AP*MAC_STA*ESSID*NONCE*EAPOL*MESSAGE_PAIR (hashcat -m 22000 handshake,
+ *                            NONCE being the one the EAPOL frame does not hold);
+ *                          - PMKID*MAC_AP*MAC_STA*ESSID (hashcat -m 16800, as written by cap2hccapx).
+ *
+ *  @param line:            hash line, without line terminator, not NULL terminated.
+ *  @param strlen_line:     length of the line.
+ *  @param hccapx:          output hccapx struct.
+ *  @return:                0 on success, -1 if the line is malformed.
+ */
+static int hashfile_parse_line(const char *line, uint32_t strlen_line, hccapx_t *hccapx) {
+    const char *fields[HASHFILE_MAX_FIELDS];
+    uint32_t lens[HASHFILE_MAX_FIELDS], fields_cnt = 0, first, essid_len, eapol_len;
+    const char *start = line, *end = line + strlen_line, *star;
+    uint8_t nonce[32];
+    bit_t wpa;
+
+    while (fields_cnt < HASHFILE_MAX_FIELDS) {
+        star = (const char *) memchr(start, '*', end - start);
+
+        fields[fields_cnt] = start;
+        lens[fields_cnt++] = (uint32_t) ((star ? star : end) - start);
+
+        if (star == NULL) break;
+        start = star + 1;
+    }
+
+    if (star != NULL) return -1;
+
+    wpa = fields_cnt >= 6 && lens[0] == 3 && memcmp(fields[0], "WPA", 3) == 0 && lens[1] == 2;
+    if (!wpa && fields_cnt != 4) return -1;
+
+    memset(hccapx, 0, sizeof(hccapx_t));
+    hccapx->signature = HASHFILE_HCCAPX_SIGNATURE;
+    hccapx->version = HASHFILE_HCCAPX_VERSION;
+
+    /* MIC (or PMKID), MAC_AP, MAC_STA and ESSID, in this order in every format */
+    first = wpa ? 2 : 0;
+    essid_len = lens[first + 3] / 2;
+
+    if (hashfile_parse_hex(fields[first], lens[first], hccapx->keymic, 16) != 0 ||
+        hashfile_parse_hex(fields[first + 1], lens[first + 1], hccapx->mac_ap, 6) != 0 ||
+        hashfile_parse_hex(fields[first + 2], lens[first + 2], hccapx->mac_sta, 6) != 0 ||
+        essid_len == 0 || essid_len > MAX_ESSID_LENGTH ||
+        hashfile_parse_hex(fields[first + 3], lens[first + 3], hccapx->essid, essid_len) != 0) {
+        return -1;
+    }
+    hccapx->essid_len = (uint8_t) essid_len;
+
+    if (!wpa || memcmp(fields[1], "01", 2) == 0) {
+        hccapx->message_pair = HCCAPX_MESSAGE_PAIR_PMKID;
+        return 0;
+    }
+
+    if (memcmp(fields[1], "02", 2) != 0 || fields_cnt != 9) return -1;
+
+    eapol_len = lens[7] / 2;
+
+    if (hashfile_parse_hex(fields[6], lens[6], nonce, 32) != 0 ||
+        eapol_len < HASHFILE_EAPOL_MIN || eapol_len > sizeof(hccapx->eapol) ||
+        hashfile_parse_hex(fields[7], lens[7], hccapx->eapol, eapol_len) != 0 ||
+        hashfile_parse_hex(fields[8], lens[8], &hccapx->message_pair, 1) != 0) {
+        return -1;
+    }
+
+    hccapx->eapol_len = (uint16_t) eapol_len;
+    hccapx->keyver = hccapx->eapol[6] & 0x07;
+    memset(hccapx->eapol + HASHFILE_EAPOL_MIC, 0, 16);
+
+    /* The EAPOL frame holds the nonce of its sender: the AP for message 3, the station otherwise */
+    if ((hccapx->message_pair & HANDSHAKE_MESSAGE_PAIR_MASK) == HANDSHAKE_M32E3 ||
+        (hccapx->message_pair & HANDSHAKE_MESSAGE_PAIR_MASK) == HANDSHAKE_M34E3) {
+        memcpy(hccapx->nonce_ap, hccapx->eapol + HASHFILE_EAPOL_NONCE, 32);
+        memcpy(hccapx->nonce_sta, nonce, 32);
+    } else {
+        memcpy(hccapx->nonce_ap, nonce, 32);
+        memcpy(hccapx->nonce_sta, hccapx->eapol + HASHFILE_EAPOL_NONCE, 32);
+    }
+
+    return 0;
+}
+
+
+/**                         [Private] hashfile_load_hccapx(const uint8_t*, size_t, hccapx_t*, uint32_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Loads the records of a hccapx file, little endian on disk, skipping the ones whose
+ *                          signature, version or lengths are invalid.
+ *
+ *  @param map:             mapped file, made of whole records.
+ *  @param size:            size of the file.
+ *  @param hccapx:          output array, room for every record.
+ *  @param hccapx_cnt:      output number of records loaded.
+ *  @return:                number of records skipped.
+ */
+static uint32_t hashfile_load_hccapx(const uint8_t *map, size_t size, hccapx_t *hccapx, uint32_t *hccapx_cnt) {
+    uint32_t skipped = 0;
+    hccapx_t *cur;
+
+    *hccapx_cnt = 0;
+
+    for (size_t offset = 0; offset < size; offset += sizeof(hccapx_t)) {
+        cur = &hccapx[*hccapx_cnt];
+        memcpy(cur, map + offset, sizeof(hccapx_t));
+
+        cur->signature = le32toh(cur->signature);
+        cur->version = le32toh(cur->version);
+        cur->eapol_len = le16toh(cur->eapol_len);
+
+        if (cur->signature != HASHFILE_HCCAPX_SIGNATURE || cur->version != HASHFILE_HCCAPX_VERSION ||
+            cur->essid_len == 0 || cur->essid_len > MAX_ESSID_LENGTH || cur->eapol_len > sizeof(cur->eapol)) {
+            skipped++;
+            continue;
+        }
+
+        (*hccapx_cnt)++;
+    }
+
+    return skipped;
+}
+
+
+/**                         [Private] hashfile_load_lines(const char*, size_t, hccapx_t*, uint32_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Loads the hash lines of a hashcat -m 22000 (or -m 16800) file, skipping the malformed
+ *                          ones. Empty lines are ignored.
+ *
+ *  @param map:             mapped file.
+ *  @param size:            size of the file.
+ *  @param hccapx:          output array, room for a handshake per line.
+ *  @param hccapx_cnt:      output number of handshakes loaded.
+ *  @return:                number of lines skipped.
+ */
+static uint32_t hashfile_load_lines(const char *map, size_t size, hccapx_t *hccapx, uint32_t *hccapx_cnt) {
+    const char *line = map, *end = map + size, *newline;
+    uint32_t skipped = 0, strlen_line;
+
+    *hccapx_cnt = 0;
+
+    while (line < end) {
+        newline = (const char *) memchr(line, '\n', end - line);
+        strlen_line = (uint32_t) ((newline ? newline : end) - line);
+
+        if (strlen_line > 0 && line[strlen_line - 1] == '\r') strlen_line--;
+
+        if (strlen_line > 0) {
+            if (hashfile_parse_line(line, strlen_line, &hccapx[*hccapx_cnt]) == 0) (*hccapx_cnt)++;
+            else skipped++;
+        }
+
+        line = newline ? newline + 1 : end;
+    }
+
+    return skipped;
+}
+
+
+/**                         hashfile_load(const char*, uint32_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Loads the handshakes of a hash file, so that a capture converted once needs no parsing
+ *                          again. The file is memory mapped and its format told by its content: a hccapx file starts
+ *                          with the signature of its first record, anything else is read as hash lines. The output
+ *                          array is sized from the file (one handshake per record or line) and allocated once.
+ *
+ *  @param path:            name of the hash file.
+ *  @param hccapx_cnt:      output number of handshakes loaded.
+ *  @return:                dynamic array of the handshakes (possibly 0) the caller frees, NULL on error (printed).
+ */
+hccapx_t *hashfile_load(const char *path, uint32_t *hccapx_cnt) {
+    hccapx_t *hccapx;
+    uint8_t *map = NULL;
+    uint32_t signature = 0, skipped = 0, records_cnt = 1;
+    struct stat st;
+    int fd;
+
+    *hccapx_cnt = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+
+    if (st.st_size > 0) {
+        map = (uint8_t *) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            close(fd);
+            return NULL;
+        }
+        madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+        if (st.st_size >= (off_t) sizeof(signature)) {
+            memcpy(&signature, map, sizeof(signature));
+        }
+    }
+    close(fd);
+
+    if (le32toh(signature) == HASHFILE_HCCAPX_SIGNATURE) {
+        if (st.st_size % sizeof(hccapx_t) != 0) {
+            fprintf(stderr, "%s: Truncated hccapx file\n", path);
+            munmap(map, (size_t) st.st_size);
+            return NULL;
+        }
+        records_cnt = (uint32_t) (st.st_size / sizeof(hccapx_t));
+    } else {
+        for (const uint8_t *ptr = map; ptr && ptr < map + st.st_size; records_cnt++) {
+            ptr = (const uint8_t *) memchr(ptr, '\n', map + st.st_size - ptr);
+            if (ptr) ptr++;
+        }
+    }
+
+    hccapx = (hccapx_t *) malloc((records_cnt ? records_cnt : 1) * sizeof(hccapx_t));
+    if (hccapx == NULL) {
+        fprintf(stderr, "%s: Not enough memory for %" PRIu32 " handshakes\n", path, records_cnt);
+        if (map) munmap(map, (size_t) st.st_size);
+        return NULL;
+    }
+
+    if (le32toh(signature) == HASHFILE_HCCAPX_SIGNATURE) {
+        skipped = hashfile_load_hccapx(map, (size_t) st.st_size, hccapx, hccapx_cnt);
+    } else if (map) {
+        skipped = hashfile_load_lines((const char *) map, (size_t) st.st_size, hccapx, hccapx_cnt);
+    }
+
+    if (map) munmap(map, (size_t) st.st_size);
+
+    if (skipped > 0) {
+        fprintf(stderr, "%s: %" PRIu32 " invalid records skipped\n", path, skipped);
+    }
+
+    return hccapx;
+}
@@ -0,0 +1,35 @@
+#ifndef HASHFILE_H
+#define HASHFILE_H
+
+/** Includes */
+#include "sha1.h"
+#include "../cap2hccapx/cap2hccapx.h"
+
+/** Defines */
+/** Signature of a hccapx record, "HCPX" */
+#define HASHFILE_HCCAPX_SIGNATURE       0x58504348
+
+/** Version of the hccapx records supported */
+#define HASHFILE_HCCAPX_VERSION         4
+
+/** Extension of the hashcat -m 22000 files, PMKIDs (WPA*01) and handshakes (WPA*02) */
+#define HASHFILE_22000_EXTENSION        ".22000"
+
+/** Extension of the hashcat -m 22000 files as named by hcxpcapngtool */
+#define HASHFILE_HC22000_EXTENSION      ".hc22000"
+
+/** Minimum length of the EAPOL frame of a handshake: 4 bytes of 802.1X header and 95 bytes of EAPOL-Key frame */
+#define HASHFILE_EAPOL_MIN              99
+
+/** Offset of the nonce in the EAPOL frame of a handshake */
+#define HASHFILE_EAPOL_NONCE            17
+
+/** Offset of the MIC in the EAPOL frame of a handshake, zeroed in the frame the MIC is computed on */
+#define HASHFILE_EAPOL_MIC              81
+
+/** Function declarations */
+bit_t hashfile_is_hashfile(const char *name);
+
+hccapx_t *hashfile_load(const char *path, uint32_t *hccapx_cnt);
+
+#endif /* HASHFILE_H */
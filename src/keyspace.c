@@ -0,0 +1,211 @@
+#include "keyspace.h"
+
+#include <string.h>
+
+
+/**                         keyspace_init_mask(keyspace_t*, const mask_t*, bit_t);
+ *
+ *  Requires:               - mask_compile(mask_t*, const char*, const mask_charset_t**);
+ *
+ *  Allows:                 - keyspace_candidate(const keyspace_t*, const unsigned char*, uint32_t, uint64_t, ...);
+ *                          - keyspace_dispose(keyspace_t*);
+ *
+ *  Description:            Initializes a keyspace whose inner part is a mask (mask attack, hybrid attacks).
+ *
+ *  @param keyspace:        keyspace_t struct that has to be initialized.
+ *  @param mask:            compiled mask, which has to outlive the keyspace.
+ *  @param inner_first:     true if the mask precedes the outer word.
+ */
+void keyspace_init_mask(keyspace_t *keyspace, const mask_t *mask, bit_t inner_first) {
+    memset(keyspace, 0, sizeof(keyspace_t));
+
+    keyspace->mask = mask;
+    keyspace->inner_cnt = mask->keyspace;
+    keyspace->inner_first = inner_first;
+}
+
+
+/**                         keyspace_init_markov(keyspace_t*, const markov_t*);
+ *
+ *  Requires:               - markov_train(markov_t*, const char*, uint32_t, uint32_t, uint32_t);
+ *
+ *  Allows:                 - keyspace_candidate(const keyspace_t*, const unsigned char*, uint32_t, uint64_t, ...);
+ *                          - keyspace_dispose(keyspace_t*);
+ *
+ *  Description:            Initializes a keyspace whose inner part is a Markov model (Markov attack).
+ *
+ *  @param keyspace:        keyspace_t struct that has to be initialized.
+ *  @param markov:          trained model, which has to outlive the keyspace.
+ */
+void keyspace_init_markov(keyspace_t *keyspace, const markov_t *markov) {
+    memset(keyspace, 0, sizeof(keyspace_t));
+
+    keyspace->markov = markov;
+    keyspace->inner_cnt = markov->keyspace;
+}
+
+
+/**                         keyspace_init_words(keyspace_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - keyspace_add_word(keyspace_t*, const unsigned char*, uint32_t);
+ *                          - keyspace_candidate(const keyspace_t*, const unsigned char*, uint32_t, uint64_t, ...);
+ *                          - keyspace_dispose(keyspace_t*);
+ *
+ *  Description:            Initializes a keyspace whose inner part is an (initially empty) in-memory wordlist.
+ *
+ *  @param keyspace:        keyspace_t struct that has to be initialized.
+ */
+void keyspace_init_words(keyspace_t *keyspace) {
+    memset(keyspace, 0, sizeof(keyspace_t));
+}
+
+
+/**                         keyspace_add_word(keyspace_t*, const unsigned char*, uint32_t);
+ *
+ *  Requires:               - keyspace_init_words(keyspace_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends a word to the in-memory wordlist of the keyspace, as a length prefixed record plus
+ *                          its offset, so that any inner word can be addressed by index.
+ *
+ *  @param keyspace:        keyspace the word has to be added to.
+ *  @param word:            word that has to be added.
+ *  @param strlen_word:     length of the word (lower than MAX_LENGTH).
+ */
+void keyspace_add_word(keyspace_t *keyspace, const unsigned char *word, uint32_t strlen_word) {
+    if (keyspace->words_len + 1 + strlen_word > keyspace->words_size) {
+        keyspace->words_size = keyspace->words_size ? keyspace->words_size * 2 : 64 * 1024;
+        keyspace->words = (unsigned char *) realloc(keyspace->words, keyspace->words_size);
+    }
+
+    if (keyspace->words_cnt == keyspace->offsets_size) {
+        keyspace->offsets_size = keyspace->offsets_size ? keyspace->offsets_size * 2 : 4096;
+        keyspace->offsets = (uint64_t *) realloc(keyspace->offsets, keyspace->offsets_size * sizeof(uint64_t));
+    }
+
+    keyspace->offsets[keyspace->words_cnt++] = keyspace->words_len;
+    keyspace->words[keyspace->words_len++] = (unsigned char) strlen_word;
+    memcpy(keyspace->words + keyspace->words_len, word, strlen_word);
+    keyspace->words_len += strlen_word;
+
+    keyspace->inner_cnt = keyspace->words_cnt;
+}
+
+
+/**                         keyspace_init_wordlist(keyspace_t*, const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - keyspace_candidate(const keyspace_t*, const unsigned char*, uint32_t, uint64_t, ...);
+ *                          - keyspace_dispose(keyspace_t*);
+ *
+ *  Description:            Initializes a keyspace whose inner part is a wordlist (combinator attack), loading it in
+ *                          memory.
+ *
+ *  @param keyspace:        keyspace_t struct that has to be initialized.
+ *  @param path:            name of the inner (right) wordlist.
+ *  @return:                0 on success, -1 if the wordlist could not be read or is empty.
+ */
+int keyspace_init_wordlist(keyspace_t *keyspace, const char *path) {
+    wordlist_t wordlist;
+
+    unsigned char password[MAX_LENGTH];
+    uint32_t strlen_password;
+    int rc;
+
+    keyspace_init_words(keyspace);
+
+    if (wordlist_open(&wordlist, path) != 0) {
+        return -1;
+    }
+
+    while ((rc = wordlist_next(&wordlist, password, &strlen_password)) == 1) {
+        keyspace_add_word(keyspace, password, strlen_password);
+    }
+
+    wordlist_close(&wordlist);
+
+    if (rc == -1 || keyspace->words_cnt == 0) {
+        keyspace_dispose(keyspace);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**                         keyspace_candidate(const keyspace_t*, const unsigned char*, uint32_t, uint64_t, ...);
+ *
+ *  Requires:               - keyspace_init_mask(keyspace_t*, const mask_t*, bit_t);
+ *                            or keyspace_init_markov(keyspace_t*, const markov_t*);
+ *                            or keyspace_init_words(keyspace_t*);
+ *                            or keyspace_init_wordlist(keyspace_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Builds the candidate made of an outer word and of the inner element of the given index,
+ *                          directly in the buffer of the caller.
+ *
+ *  @param keyspace:        keyspace the inner element belongs to.
+ *  @param outer:           outer word (empty for the pure mask attack).
+ *  @param strlen_outer:    length of the outer word.
+ *  @param inner_index:     index of the inner element, lower than inner_cnt.
+ *  @param candidate:       output buffer receiving the candidate, NULL terminated.
+ *  @param strlen_candidate: output length of the candidate.
+ *  @return:                true if the candidate was built, false if it would not fit in a password.
+ */
+bit_t keyspace_candidate(const keyspace_t *keyspace, const unsigned char *outer, uint32_t strlen_outer,
+                         uint64_t inner_index, unsigned char candidate[MAX_LENGTH], uint32_t *strlen_candidate) {
+    unsigned char inner[MAX_LENGTH];
+    const unsigned char *record;
+    uint32_t strlen_inner;
+
+    if (keyspace->mask) {
+        mask_candidate(keyspace->mask, inner_index, inner, &strlen_inner);
+    } else if (keyspace->markov) {
+        markov_candidate(keyspace->markov, inner_index, inner, &strlen_inner);
+    } else {
+        record = keyspace->words + keyspace->offsets[inner_index];
+        strlen_inner = record[0];
+        memcpy(inner, record + 1, strlen_inner);
+    }
+
+    if (strlen_outer + strlen_inner >= MAX_LENGTH) return false;
+
+    if (keyspace->inner_first) {
+        memcpy(candidate, inner, strlen_inner);
+        memcpy(candidate + strlen_inner, outer, strlen_outer);
+    } else {
+        memcpy(candidate, outer, strlen_outer);
+        memcpy(candidate + strlen_outer, inner, strlen_inner);
+    }
+
+    *strlen_candidate = strlen_outer + strlen_inner;
+    candidate[*strlen_candidate] = '\0';
+
+    return true;
+}
+
+
+/**                         keyspace_dispose(keyspace_t*);
+ *
+ *  Requires:               - keyspace_init_mask(keyspace_t*, const mask_t*, bit_t);
+ *                            or keyspace_init_markov(keyspace_t*, const markov_t*);
+ *                            or keyspace_init_words(keyspace_t*);
+ *                            or keyspace_init_wordlist(keyspace_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that disposes the inner wordlist of the keyspace, if any.
+ *
+ *  @param keyspace:        keyspace_t struct that has to be disposed.
+ */
+void keyspace_dispose(keyspace_t *keyspace) {
+    free(keyspace->words);
+    free(keyspace->offsets);
+    keyspace->words = NULL;
+    keyspace->offsets = NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef KEYSPACE_H
+#define KEYSPACE_H
+
+/** Includes */
+#include "mask.h"
+#include "markov.h"
+#include "wordlist.h"
+
+/**
+ * Definition of the structure keyspace_t, containing the inner part of a generated attack. Every candidate is the
+ * combination of a word of the outer wordlist, streamed from storage (a single empty word for the pure mask attack),
+ * with an element of the inner part, held in memory and addressable by index:
+ *
+ *  - mask:                 inner mask (mask and hybrid attacks), NULL otherwise.
+ *
+ *  - markov:               inner Markov model (Markov attack), NULL otherwise.
+ *
+ *  - words:                inner wordlist (combinator attack, ESSID pre-pass), stored as consecutive
+ *                          [1 byte length][word] records.
+ *
+ *  - words_len, words_size: bytes used in words and its capacity.
+ *
+ *  - offsets:              offset in words of every inner word.
+ *
+ *  - words_cnt, offsets_size: number of inner words and capacity of offsets.
+ *
+ *  - inner_cnt:            number of elements of the inner part (keyspace of the mask or number of inner words).
+ *
+ *  - inner_first:          true if the inner element precedes the outer word in the candidate (-a 7), false if it
+ *                          follows it (-a 1, -a 6).
+ */
+typedef struct {
+    const mask_t *mask;
+    const markov_t *markov;
+    unsigned char *words;
+    uint64_t words_len;
+    uint64_t words_size;
+    uint64_t *offsets;
+    uint64_t words_cnt;
+    uint64_t offsets_size;
+    uint64_t inner_cnt;
+    bit_t inner_first;
+} keyspace_t;
+
+/** Function declarations */
+void keyspace_init_mask(keyspace_t *keyspace, const mask_t *mask, bit_t inner_first);
+
+void keyspace_init_markov(keyspace_t *keyspace, const markov_t *markov);
+
+void keyspace_init_words(keyspace_t *keyspace);
+
+void keyspace_add_word(keyspace_t *keyspace, const unsigned char *word, uint32_t strlen_word);
+
+int keyspace_init_wordlist(keyspace_t *keyspace, const char *path);
+
+bit_t keyspace_candidate(const keyspace_t *keyspace, const unsigned char *outer, uint32_t strlen_outer,
+                         uint64_t inner_index, unsigned char candidate[MAX_LENGTH], uint32_t *strlen_candidate);
+
+void keyspace_dispose(keyspace_t *keyspace);
+
+#endif /* KEYSPACE_H */
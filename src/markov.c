@@ -0,0 +1,264 @@
+#include "markov.h"
+
+#include <string.h>
+
+
+/**                         [Private] markov_compare_desc(const void*, const void*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            qsort comparator ordering 64 bit keys in decreasing order.
+ *
+ *  @param p1:              first key.
+ *  @param p2:              second key.
+ *  @return:                negative, zero or positive as the first key is greater than, equal to or lower than the
+ *                          second one.
+ */
+static int markov_compare_desc(const void *p1, const void *p2) {
+    uint64_t a = *(const uint64_t *) p1, b = *(const uint64_t *) p2;
+
+    return a > b ? -1 : (a < b ? 1 : 0);
+}
+
+
+/**                         [Private] markov_build_tables(markov_t*);
+ *
+ *  Requires:               [markov->length_min, length_max and threshold set]
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Computes the number of rank sequences of every length and rank sum, and the cumulative
+ *                          number of candidates of every (rank sum, length) pair, which is what maps an index to its
+ *                          candidate without enumerating the ones before it.
+ *
+ *  @param markov:          model whose tables have to be built.
+ *  @return:                0 on success, -1 if the keyspace exceeds 64 bits.
+ */
+static int markov_build_tables(markov_t *markov) {
+    uint32_t lengths_cnt = markov->length_max - markov->length_min + 1;
+    uint64_t power, total = 0, cumulative = 0;
+
+    /* The keyspace is the sum of threshold^length: once it fits, every partial count fits too */
+    for (uint32_t n = markov->length_min; n <= markov->length_max; n++) {
+        power = 1;
+        for (uint32_t i = 0; i < n; i++) {
+            if (power > UINT64_MAX / markov->threshold) return -1;
+            power *= markov->threshold;
+        }
+
+        if (total > UINT64_MAX - power) return -1;
+        total += power;
+    }
+
+    markov->keyspace = total;
+    markov->sums_cnt = markov->length_max * (markov->threshold - 1) + 1;
+
+    markov->counts = (uint64_t *) calloc((uint64_t) (markov->length_max + 1) * markov->sums_cnt, sizeof(uint64_t));
+    markov->levels = (uint64_t *) malloc((uint64_t) markov->sums_cnt * lengths_cnt * sizeof(uint64_t));
+
+    markov->counts[0] = 1;
+    for (uint32_t n = 1; n <= markov->length_max; n++) {
+        for (uint32_t s = 0; s < markov->sums_cnt; s++) {
+            uint64_t count = 0;
+
+            for (uint32_t d = 0; d < markov->threshold && d <= s; d++) {
+                count += markov->counts[(n - 1) * markov->sums_cnt + s - d];
+            }
+
+            markov->counts[n * markov->sums_cnt + s] = count;
+        }
+    }
+
+    /* Lower rank sums first (more likely candidates), shorter candidates first within the same rank sum */
+    for (uint32_t s = 0; s < markov->sums_cnt; s++) {
+        for (uint32_t n = markov->length_min; n <= markov->length_max; n++) {
+            cumulative += markov->counts[n * markov->sums_cnt + s];
+            markov->levels[s * lengths_cnt + (n - markov->length_min)] = cumulative;
+        }
+    }
+
+    return 0;
+}
+
+
+/**                         markov_train(markov_t*, const char*, uint32_t, uint32_t, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - markov_candidate(const markov_t*, uint64_t, unsigned char*, uint32_t*);
+ *                          - markov_dispose(markov_t*);
+ *
+ *  Description:            Trains a per-position Markov model on a sample wordlist: for every position and every
+ *                          preceding character, the characters of the alphabet (the bytes occurring in the sample)
+ *                          are ranked by how often they follow it there. A candidate is a sequence of ranks, and
+ *                          candidates are enumerated by increasing sum of ranks, which approximates decreasing
+ *                          probability, so that likely passwords are reached first.
+ *
+ *  @param markov:          markov_t struct that has to be initialized.
+ *  @param path:            name of the sample wordlist.
+ *  @param length_min:      minimum length of the candidates (at least 1).
+ *  @param length_max:      maximum length of the candidates (lower than MAX_LENGTH).
+ *  @param threshold:       number of successors considered after every character, 0 for the whole alphabet.
+ *  @return:                0 on success, -1 if the sample could not be read or is empty, or the keyspace exceeds
+ *                          64 bits.
+ */
+int markov_train(markov_t *markov, const char *path, uint32_t length_min, uint32_t length_max, uint32_t threshold) {
+    wordlist_t wordlist;
+
+    unsigned char password[MAX_LENGTH], alphabet[256];
+    uint32_t strlen_password, alphabet_cnt = 0, state, *frequencies;
+    uint64_t global[256] = {0}, keys[256], *row;
+    int rc;
+
+    memset(markov, 0, sizeof(markov_t));
+    markov->length_min = length_min;
+    markov->length_max = length_max;
+
+    if (wordlist_open(&wordlist, path) != 0) {
+        fprintf(stderr, "Error in opening wordlist file \"%s\".\n", path);
+        return -1;
+    }
+
+    frequencies = (uint32_t *) calloc((uint64_t) length_max * MARKOV_STATES * 256, sizeof(uint32_t));
+
+    while ((rc = wordlist_next(&wordlist, password, &strlen_password)) == 1) {
+        state = MARKOV_STATE_START;
+
+        for (uint32_t i = 0; i < strlen_password; i++) {
+            global[password[i]]++;
+
+            if (i < length_max) {
+                frequencies[((uint64_t) i * MARKOV_STATES + state) * 256 + password[i]]++;
+            }
+            state = password[i];
+        }
+    }
+
+    wordlist_close(&wordlist);
+
+    if (rc == -1) {
+        fprintf(stderr, "Error in reading wordlist file \"%s\".\n", path);
+        free(frequencies);
+        return -1;
+    }
+
+    /* The alphabet, most frequent bytes first: ties within a position are broken by global frequency */
+    for (uint32_t c = 0; c < 256; c++) {
+        if (global[c]) keys[alphabet_cnt++] = global[c] << 8 | (255 - c);
+    }
+    qsort(keys, alphabet_cnt, sizeof(uint64_t), markov_compare_desc);
+    for (uint32_t i = 0; i < alphabet_cnt; i++) {
+        alphabet[i] = (unsigned char) (255 - (keys[i] & 0xff));
+    }
+
+    if (alphabet_cnt == 0) {
+        fprintf(stderr, "Wordlist file \"%s\" is empty.\n", path);
+        free(frequencies);
+        return -1;
+    }
+
+    markov->threshold = (threshold == 0 || threshold > alphabet_cnt) ? alphabet_cnt : threshold;
+    markov->order = (unsigned char *) malloc((uint64_t) length_max * MARKOV_STATES * markov->threshold);
+
+    for (uint64_t i = 0; i < (uint64_t) length_max * MARKOV_STATES; i++) {
+        row = keys;
+
+        /* Key: frequency in this position after this state, then rank in the alphabet */
+        for (uint32_t a = 0; a < alphabet_cnt; a++) {
+            row[a] = (uint64_t) frequencies[i * 256 + alphabet[a]] << 8 | (255 - a);
+        }
+        qsort(row, alphabet_cnt, sizeof(uint64_t), markov_compare_desc);
+
+        for (uint32_t r = 0; r < markov->threshold; r++) {
+            markov->order[i * markov->threshold + r] = alphabet[255 - (row[r] & 0xff)];
+        }
+    }
+
+    free(frequencies);
+
+    if (markov_build_tables(markov) != 0) {
+        fprintf(stderr, "Markov keyspace exceeds 64 bits, lower the threshold or the maximum length.\n");
+        markov_dispose(markov);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**                         markov_candidate(const markov_t*, uint64_t, unsigned char*, uint32_t*);
+ *
+ *  Requires:               - markov_train(markov_t*, const char*, uint32_t, uint32_t, uint32_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Maps an index to its candidate: a binary search over the cumulative counts finds the rank
+ *                          sum and the length of the candidate, then its sequence of ranks is unranked position by
+ *                          position among the sequences of that length and sum (in lexicographic order), and every
+ *                          rank is translated into a character given the preceding one. Any index can thus be
+ *                          generated directly, which makes the enumeration resumable and splittable.
+ *
+ *  @param markov:          trained model.
+ *  @param index:           index of the candidate, lower than the keyspace.
+ *  @param candidate:       output buffer receiving the candidate, NULL terminated.
+ *  @param strlen_candidate: output length of the candidate.
+ */
+void markov_candidate(const markov_t *markov, uint64_t index, unsigned char candidate[MAX_LENGTH],
+                      uint32_t *strlen_candidate) {
+    uint32_t lengths_cnt = markov->length_max - markov->length_min + 1, length, sum, state, rank;
+    uint64_t low = 0, high = (uint64_t) markov->sums_cnt * lengths_cnt - 1, middle, count;
+
+    while (low < high) {
+        middle = low + (high - low) / 2;
+
+        if (markov->levels[middle] > index) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    sum = (uint32_t) (low / lengths_cnt);
+    length = markov->length_min + (uint32_t) (low % lengths_cnt);
+    index -= low > 0 ? markov->levels[low - 1] : 0;
+
+    state = MARKOV_STATE_START;
+
+    for (uint32_t i = 0; i < length; i++) {
+        for (rank = 0; rank < markov->threshold && rank <= sum; rank++) {
+            count = markov->counts[(length - i - 1) * markov->sums_cnt + sum - rank];
+
+            if (index < count) break;
+            index -= count;
+        }
+
+        sum -= rank;
+        candidate[i] = markov->order[((uint64_t) i * MARKOV_STATES + state) * markov->threshold + rank];
+        state = candidate[i];
+    }
+
+    candidate[length] = '\0';
+    *strlen_candidate = length;
+}
+
+
+/**                         markov_dispose(markov_t*);
+ *
+ *  Requires:               - markov_train(markov_t*, const char*, uint32_t, uint32_t, uint32_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that disposes the tables of the model.
+ *
+ *  @param markov:          markov_t struct that has to be disposed.
+ */
+void markov_dispose(markov_t *markov) {
+    free(markov->order);
+    free(markov->counts);
+    free(markov->levels);
+    markov->order = NULL;
+    markov->counts = NULL;
+    markov->levels = NULL;
+}
@@ -0,0 +1,54 @@
+#ifndef MARKOV_H
+#define MARKOV_H
+
+/** Includes */
+#include "wordlist.h"
+
+/** Defines */
+/** Number of predecessor states of a position: the 256 byte values, plus the start of the candidate */
+#define MARKOV_STATES                   257
+
+/** Predecessor state of the first position */
+#define MARKOV_STATE_START              256
+
+/**
+ * Definition of the structure markov_t, containing a Markov model trained on a sample wordlist and the tables needed
+ * to enumerate its candidates by index:
+ *
+ *  - length_min, length_max: range of lengths of the candidates.
+ *
+ *  - threshold:            number of successors considered after every character (at most the alphabet size).
+ *
+ *  - order:                for every position and predecessor state, the [threshold] most frequent successors in
+ *                          decreasing order of frequency ([length_max][MARKOV_STATES][threshold] bytes).
+ *
+ *  - counts:               counts[n * sums_cnt + s] is the number of sequences of n ranks in [0, threshold) whose
+ *                          sum is s.
+ *
+ *  - sums_cnt:             number of possible rank sums, length_max * (threshold - 1) + 1.
+ *
+ *  - levels:               cumulative number of candidates up to every (rank sum, length) pair, in enumeration
+ *                          order: levels[s * (length_max - length_min + 1) + (n - length_min)].
+ *
+ *  - keyspace:             total number of candidates.
+ */
+typedef struct {
+    uint32_t length_min;
+    uint32_t length_max;
+    uint32_t threshold;
+    unsigned char *order;
+    uint64_t *counts;
+    uint32_t sums_cnt;
+    uint64_t *levels;
+    uint64_t keyspace;
+} markov_t;
+
+/** Function declarations */
+int markov_train(markov_t *markov, const char *path, uint32_t length_min, uint32_t length_max, uint32_t threshold);
+
+void markov_candidate(const markov_t *markov, uint64_t index, unsigned char candidate[MAX_LENGTH],
+                      uint32_t *strlen_candidate);
+
+void markov_dispose(markov_t *markov);
+
+#endif /* MARKOV_H */
@@ -0,0 +1,215 @@
+#include "mask.h"
+
+#include <string.h>
+
+
+/**                         [Private] mask_charset_add(mask_charset_t*, unsigned char);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that appends a character to a charset unless it is already part of it, so
+ *                          that no candidate is enumerated twice.
+ *
+ *  @param charset:         charset that has to be extended.
+ *  @param c:               character that has to be added.
+ */
+static void mask_charset_add(mask_charset_t *charset, unsigned char c) {
+    if (memchr(charset->chars, c, charset->chars_cnt)) return;
+
+    charset->chars[charset->chars_cnt++] = c;
+}
+
+
+/**                         [Private] mask_charset_add_range(mask_charset_t*, unsigned char, unsigned char);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that appends a range of characters to a charset.
+ *
+ *  @param charset:         charset that has to be extended.
+ *  @param first:           first character of the range.
+ *  @param last:            last character of the range (included).
+ */
+static void mask_charset_add_range(mask_charset_t *charset, unsigned char first, unsigned char last) {
+    for (uint32_t c = first; c <= last; c++) {
+        mask_charset_add(charset, (unsigned char) c);
+    }
+}
+
+
+/**                         [Private] mask_charset_add_placeholder(mask_charset_t*, char, const mask_charset_t**);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends to a charset the characters a placeholder stands for:
+ *
+ *                          - ?l: abcdefghijklmnopqrstuvwxyz
+ *                          - ?u: ABCDEFGHIJKLMNOPQRSTUVWXYZ
+ *                          - ?d: 0123456789
+ *                          - ?h: 0123456789abcdef
+ *                          - ?H: 0123456789ABCDEF
+ *                          - ?s: the printable ASCII symbols, space included
+ *                          - ?a: ?l?u?d?s
+ *                          - ?b: every byte from 0x00 to 0xff
+ *                          - ?1 to ?4: the user defined charsets
+ *                          - ??: the character '?' itself
+ *
+ *  @param charset:         charset that has to be extended.
+ *  @param placeholder:     character following the '?'.
+ *  @param custom:          user defined charsets, NULL entries for the undefined ones.
+ *  @return:                0 on success, -1 if the placeholder is unknown or refers to an undefined charset.
+ */
+static int mask_charset_add_placeholder(mask_charset_t *charset, char placeholder,
+                                        const mask_charset_t *custom[MASK_CUSTOM_CHARSETS]) {
+    const mask_charset_t *user;
+
+    switch (placeholder) {
+        case 'l':
+            mask_charset_add_range(charset, 'a', 'z');
+            break;
+        case 'u':
+            mask_charset_add_range(charset, 'A', 'Z');
+            break;
+        case 'd':
+            mask_charset_add_range(charset, '0', '9');
+            break;
+        case 'h':
+            mask_charset_add_range(charset, '0', '9');
+            mask_charset_add_range(charset, 'a', 'f');
+            break;
+        case 'H':
+            mask_charset_add_range(charset, '0', '9');
+            mask_charset_add_range(charset, 'A', 'F');
+            break;
+        case 's':
+            for (const char *c = MASK_CHARSET_SPECIAL; *c; c++) mask_charset_add(charset, (unsigned char) *c);
+            break;
+        case 'a':
+            mask_charset_add_range(charset, 'a', 'z');
+            mask_charset_add_range(charset, 'A', 'Z');
+            mask_charset_add_range(charset, '0', '9');
+            for (const char *c = MASK_CHARSET_SPECIAL; *c; c++) mask_charset_add(charset, (unsigned char) *c);
+            break;
+        case 'b':
+            mask_charset_add_range(charset, 0x00, 0xff);
+            break;
+        case '?':
+            mask_charset_add(charset, '?');
+            break;
+        case '1': case '2': case '3': case '4':
+            user = custom ? custom[placeholder - '1'] : NULL;
+            if (user == NULL) return -1;
+            for (uint32_t i = 0; i < user->chars_cnt; i++) mask_charset_add(charset, user->chars[i]);
+            break;
+        default:
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/**                         mask_charset_parse(mask_charset_t*, const char*, const mask_charset_t**);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Parses a user defined charset (-1 to -4), made of literal characters and placeholders.
+ *
+ *  @param charset:         charset that has to be filled.
+ *  @param text:            charset as written on the command line, e.g. "?dabcdef".
+ *  @param custom:          user defined charsets the text may refer to, NULL entries for the undefined ones.
+ *  @return:                0 on success, -1 if the charset is empty or malformed.
+ */
+int mask_charset_parse(mask_charset_t *charset, const char *text, const mask_charset_t *custom[MASK_CUSTOM_CHARSETS]) {
+    charset->chars_cnt = 0;
+
+    for (; *text; text++) {
+        if (*text != '?') {
+            mask_charset_add(charset, (unsigned char) *text);
+            continue;
+        }
+
+        if (*++text == '\0' || mask_charset_add_placeholder(charset, *text, custom) != 0) return -1;
+    }
+
+    return charset->chars_cnt > 0 ? 0 : -1;
+}
+
+
+/**                         mask_compile(mask_t*, const char*, const mask_charset_t**);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - mask_candidate(const mask_t*, uint64_t, unsigned char*, uint32_t*);
+ *
+ *  Description:            Compiles a mask, e.g. "?d?d?d?d?d?d?d?d" or "router?h?h?h?h", into the charsets of its
+ *                          positions and computes its keyspace.
+ *
+ *  @param mask:            mask_t struct that has to be filled.
+ *  @param text:            mask as written on the command line.
+ *  @param custom:          user defined charsets the mask may refer to, NULL entries for the undefined ones.
+ *  @return:                0 on success, -1 if the mask is malformed, too long or its keyspace exceeds 64 bits.
+ */
+int mask_compile(mask_t *mask, const char *text, const mask_charset_t *custom[MASK_CUSTOM_CHARSETS]) {
+    mask_charset_t *charset;
+
+    mask->positions_cnt = 0;
+    mask->keyspace = 1;
+
+    for (; *text; text++) {
+        if (mask->positions_cnt == MAX_LENGTH - 1) return -1;
+
+        charset = &mask->positions[mask->positions_cnt++];
+        charset->chars_cnt = 0;
+
+        if (*text != '?') {
+            mask_charset_add(charset, (unsigned char) *text);
+        } else if (*++text == '\0' || mask_charset_add_placeholder(charset, *text, custom) != 0) {
+            return -1;
+        }
+
+        if (mask->keyspace > UINT64_MAX / charset->chars_cnt) return -1;
+        mask->keyspace *= charset->chars_cnt;
+    }
+
+    return mask->positions_cnt > 0 ? 0 : -1;
+}
+
+
+/**                         mask_candidate(const mask_t*, uint64_t, unsigned char*, uint32_t*);
+ *
+ *  Requires:               - mask_compile(mask_t*, const char*, const mask_charset_t**);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Maps an index of the keyspace to its candidate in O(length), reading the index as a mixed
+ *                          radix number whose digits are the positions of the mask (the last position varies
+ *                          fastest). Any slice of the keyspace can thus be generated by any thread or process, with
+ *                          no need to enumerate what precedes it.
+ *
+ *  @param mask:            compiled mask.
+ *  @param index:           index of the candidate, lower than the keyspace of the mask.
+ *  @param candidate:       output buffer receiving the candidate, NULL terminated.
+ *  @param strlen_candidate: output length of the candidate.
+ */
+void mask_candidate(const mask_t *mask, uint64_t index, unsigned char candidate[MAX_LENGTH],
+                    uint32_t *strlen_candidate) {
+    const mask_charset_t *charset;
+
+    for (uint32_t i = mask->positions_cnt; i > 0; i--) {
+        charset = &mask->positions[i - 1];
+        candidate[i - 1] = charset->chars[index % charset->chars_cnt];
+        index /= charset->chars_cnt;
+    }
+
+    candidate[mask->positions_cnt] = '\0';
+    *strlen_candidate = mask->positions_cnt;
+}
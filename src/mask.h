@@ -0,0 +1,49 @@
+#ifndef MASK_H
+#define MASK_H
+
+/** Includes */
+#include "pbkdf2.h"
+
+/** Defines */
+/** Number of user defined charsets (?1 to ?4) */
+#define MASK_CUSTOM_CHARSETS            4
+
+/** Characters of the built-in charset ?s */
+#define MASK_CHARSET_SPECIAL            " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"
+
+/**
+ * Definition of the structure mask_charset_t, containing the characters a position of the mask can take:
+ *
+ *  - chars:                distinct characters of the charset, in the order they are enumerated.
+ *
+ *  - chars_cnt:            number of entries in chars (1 to 256).
+ */
+typedef struct {
+    unsigned char chars[256];
+    uint32_t chars_cnt;
+} mask_charset_t;
+
+/**
+ * Definition of the structure mask_t, containing a compiled mask:
+ *
+ *  - positions:            charset of every position of the candidates.
+ *
+ *  - positions_cnt:        length of the candidates.
+ *
+ *  - keyspace:             number of candidates of the mask, product of the sizes of the charsets.
+ */
+typedef struct {
+    mask_charset_t positions[MAX_LENGTH - 1];
+    uint32_t positions_cnt;
+    uint64_t keyspace;
+} mask_t;
+
+/** Function declarations */
+int mask_charset_parse(mask_charset_t *charset, const char *text, const mask_charset_t *custom[MASK_CUSTOM_CHARSETS]);
+
+int mask_compile(mask_t *mask, const char *text, const mask_charset_t *custom[MASK_CUSTOM_CHARSETS]);
+
+void mask_candidate(const mask_t *mask, uint64_t index, unsigned char candidate[MAX_LENGTH],
+                    uint32_t *strlen_candidate);
+
+#endif /* MASK_H */
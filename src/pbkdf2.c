@@ -1,5 +1,7 @@
 #include "pbkdf2.h"
 
+#include <string.h>
+
 
 /**                         pbkdf2_ctx_init(pbkdf2_ctx_t*);
  *
@@ -103,6 +105,45 @@ void pbkdf2_ctx_dispose(pbkdf2_ctx_t *ctx) {
     free(ctx->T);
 }
 
+/**                         pbkdf2_pmk(const unsigned char*, uint32_t, const unsigned char*, uint32_t, uint32_t[8]);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Derives the WPA2 Pairwise Master Key of a passphrase: pbkdf2 with the ESSID as salt, 4096
+ *                          iterations and a 256 bit output.
+ *
+ * @param password:         passphrase (lower than MAX_LENGTH bytes).
+ * @param strlen_password:  length of the passphrase.
+ * @param essid:            ESSID of the network.
+ * @param essid_len:        length of the ESSID (lower than MAX_LENGTH bytes).
+ * @param pmk:              output PMK, as the 8 words output by pbkdf2.
+ */
+void pbkdf2_pmk(const unsigned char *password, uint32_t strlen_password, const unsigned char *essid,
+                uint32_t essid_len, uint32_t pmk[8]) {
+    pbkdf2_ctx_t ctx;
+
+    memset(ctx.password, 0, MAX_LENGTH);
+    memset(ctx.salt, 0, MAX_LENGTH);
+
+    memcpy(ctx.password, password, strlen_password);
+    memcpy(ctx.salt, essid, essid_len);
+
+    ctx.strlen_password = strlen_password;
+    ctx.strlen_salt = essid_len;
+    ctx.iteration_count = 4096;
+    ctx.bits_in_result_hash = 256;
+
+    pbkdf2_ctx_init(&ctx);
+
+    pbkdf2(&ctx);
+
+    memcpy(pmk, ctx.T, 8 * sizeof(uint32_t));
+
+    pbkdf2_ctx_dispose(&ctx);
+}
+
 /*     CHEATSHEET
 
 Input:
@@ -15,6 +15,9 @@
 /** Max length of the password */
 #define MAX_LENGTH          64
 
+/** Length of a raw 256 bit PSK written in hex, which WPA2 accepts in place of a passphrase (used as the PMK) */
+#define PSK_HEX_LENGTH      64
+
 /**
  * Definition of the structure pbkdf2_ctx_t, containing:
  *
@@ -56,4 +59,7 @@ void pbkdf2(pbkdf2_ctx_t *ctx);
 
 void pbkdf2_ctx_dispose(pbkdf2_ctx_t *ctx);
 
+void pbkdf2_pmk(const unsigned char *password, uint32_t strlen_password, const unsigned char *essid,
+                uint32_t essid_len, uint32_t pmk[8]);
+
 #endif /* PBKDF2_H */
@@ -0,0 +1,374 @@
+#include "pmkcache.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/**                         [Private] pmkcache_key(const unsigned char*, uint32_t, const unsigned char*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Hashes an (ESSID, passphrase) pair: the hash of the ESSID seeds the hash of the passphrase,
+ *                          so that the same passphrase lands in unrelated slots for different networks.
+ *
+ *  @param essid:           ESSID.
+ *  @param essid_len:       length of the ESSID.
+ *  @param password:        passphrase.
+ *  @param strlen_password: length of the passphrase.
+ *  @return:                the key of the pair, never 0.
+ */
+static uint64_t pmkcache_key(const unsigned char *essid, uint32_t essid_len, const unsigned char *password,
+                             uint32_t strlen_password) {
+    return hash64(password, strlen_password, hash64(essid, essid_len, PMKCACHE_SEED)) | 1;
+}
+
+
+/**                         [Private] pmkcache_find(pmkcache_t*, uint64_t, const unsigned char*, uint32_t, ...);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Probes the table linearly from the home slot of the key, until the pair or an empty slot is
+ *                          found. Filled slots are compared in full, hash collisions never return a wrong PMK.
+ *
+ *  @param cache:           cache that has to be searched.
+ *  @param key:             key of the pair.
+ *  @param essid:           ESSID.
+ *  @param essid_len:       length of the ESSID.
+ *  @param password:        passphrase.
+ *  @param strlen_password: length of the passphrase.
+ *  @return:                the slot holding the pair, or the empty slot it would be stored in (NULL if the table has
+ *                          no empty slot left).
+ */
+static pmkcache_slot_t *pmkcache_find(pmkcache_t *cache, uint64_t key, const unsigned char *essid,
+                                      uint32_t essid_len, const unsigned char *password, uint32_t strlen_password) {
+    uint64_t mask = cache->header->slots_cnt - 1, slot_key;
+    pmkcache_slot_t *slot;
+
+    for (uint64_t i = 0, index = key & mask; i <= mask; i++, index = (index + 1) & mask) {
+        slot = &cache->slots[index];
+        slot_key = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+
+        if (slot_key == 0) return slot;
+
+        if (slot_key == key && slot->essid_len == essid_len && slot->password_len == strlen_password &&
+            memcmp(slot->essid, essid, essid_len) == 0 && memcmp(slot->password, password, strlen_password) == 0) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**                         [Private] pmkcache_grow(pmkcache_t*, const char*, const pmkcache_header_t*, uint64_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Rehashes the PMKs of the cache into a new file of the given number of slots, which then
+ *                          replaces the cache file. Runs still holding the old file go on with it, those waiting for
+ *                          the lock open the new one. The caller holds the lock of the cache file.
+ *
+ *  @param cache:           cache being opened, its descriptor is replaced by the one of the new file (locked).
+ *  @param path:            name of the cache file.
+ *  @param header:          header of the current cache file.
+ *  @param slots_cnt:       number of slots of the new file (a power of two).
+ *  @return:                0 on success, -1 on error (printed), the current file being left as it is.
+ */
+static int pmkcache_grow(pmkcache_t *cache, const char *path, const pmkcache_header_t *header, uint64_t slots_cnt) {
+    size_t old_size = sizeof(pmkcache_header_t) + header->slots_cnt * sizeof(pmkcache_slot_t);
+    size_t size = sizeof(pmkcache_header_t) + slots_cnt * sizeof(pmkcache_slot_t);
+    pmkcache_t old, grown;
+    pmkcache_slot_t *slot, *empty;
+    char *temp;
+    int fd;
+
+    temp = (char *) malloc(strlen(path) + sizeof(".XXXXXX"));
+    sprintf(temp, "%s.XXXXXX", path);
+
+    fd = mkstemp(temp);
+    if (fd == -1) {
+        fprintf(stderr, "%s: %s\n", temp, strerror(errno));
+        free(temp);
+        return -1;
+    }
+
+    old.header = (pmkcache_header_t *) mmap(NULL, old_size, PROT_READ, MAP_SHARED, cache->fd, 0);
+    grown.header = MAP_FAILED;
+
+    if (old.header == MAP_FAILED || fchmod(fd, 0644) != 0 || ftruncate(fd, (off_t) size) != 0 ||
+        (grown.header = (pmkcache_header_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                                                   0)) == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", temp, strerror(errno));
+        if (old.header != MAP_FAILED) munmap(old.header, old_size);
+        unlink(temp);
+        close(fd);
+        free(temp);
+        return -1;
+    }
+
+    old.slots = (pmkcache_slot_t *) (old.header + 1);
+    grown.slots = (pmkcache_slot_t *) (grown.header + 1);
+
+    memcpy(grown.header, header, sizeof(pmkcache_header_t));
+    grown.header->slots_cnt = slots_cnt;
+    grown.header->used = 0;
+
+    for (uint64_t i = 0; i < header->slots_cnt; i++) {
+        slot = &old.slots[i];
+        if (slot->key == 0) continue;
+
+        empty = pmkcache_find(&grown, slot->key, slot->essid, slot->essid_len, slot->password, slot->password_len);
+        if (empty && empty->key == 0) {
+            memcpy(empty, slot, sizeof(pmkcache_slot_t));
+            grown.header->used++;
+        }
+    }
+
+    munmap(grown.header, size);
+    munmap(old.header, old_size);
+
+    /* Locked before it becomes visible, the new file is handed over to the runs waiting for the old one */
+    flock(fd, LOCK_EX);
+    if (rename(temp, path) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        unlink(temp);
+        close(fd);
+        free(temp);
+        return -1;
+    }
+
+    close(cache->fd);
+    cache->fd = fd;
+    free(temp);
+
+    return 0;
+}
+
+
+/**                         pmkcache_open(pmkcache_t*, const char*, uint64_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - pmkcache_lookup(pmkcache_t*, const unsigned char*, uint32_t, const unsigned char*, ...);
+ *                          - pmkcache_insert(pmkcache_t*, const unsigned char*, uint32_t, const unsigned char*, ...);
+ *                          - pmkcache_close(pmkcache_t*);
+ *
+ *  Description:            Opens a PMK cache, creating it with the given number of empty slots if the file does not
+ *                          exist, and maps it in memory. An existing cache with fewer slots, or already at its maximum
+ *                          load, is first rehashed into a larger file (twice as large when full). The PMK only depends
+ *                          on the passphrase and on the ESSID, so a cache shared by every run turns the test of an
+ *                          already seen (ESSID, passphrase) pair into a lookup plus the cheap PTK/MIC check. Several
+ *                          processes may share the same cache.
+ *
+ *  @param cache:           pmkcache_t struct that has to be initialized.
+ *  @param path:            name of the cache file.
+ *  @param slots_cnt:       minimum number of slots of the cache, rounded up to a power of two (at most
+ *                          PMKCACHE_MAX_SLOTS), 0 to create it with PMKCACHE_DEFAULT_SLOTS and keep the size of an
+ *                          existing cache.
+ *  @return:                0 on success, -1 on error (printed).
+ */
+int pmkcache_open(pmkcache_t *cache, const char *path, uint64_t slots_cnt) {
+    pmkcache_header_t header;
+    struct stat st, st_path;
+    uint64_t grow;
+
+    memset(cache, 0, sizeof(pmkcache_t));
+
+    if (slots_cnt > PMKCACHE_MAX_SLOTS) slots_cnt = PMKCACHE_MAX_SLOTS;
+    for (grow = 1; grow < slots_cnt; grow <<= 1);
+    if (slots_cnt) slots_cnt = grow;
+
+    /* Creation happens under the lock, a concurrent run never maps a half initialized file. A run growing the cache
+     * replaces the file while this one waits for the lock, which is then taken again on the new file */
+    for (;;) {
+        cache->fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (cache->fd == -1) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            return -1;
+        }
+
+        flock(cache->fd, LOCK_EX);
+
+        if (fstat(cache->fd, &st) != 0 || stat(path, &st_path) != 0 ||
+            (st.st_dev == st_path.st_dev && st.st_ino == st_path.st_ino)) {
+            break;
+        }
+
+        close(cache->fd);
+    }
+
+    if (fstat(cache->fd, &st) == 0 && st.st_size == 0) {
+        memset(&header, 0, sizeof(pmkcache_header_t));
+        memcpy(header.magic, PMKCACHE_MAGIC, sizeof(PMKCACHE_MAGIC));
+        header.version = PMKCACHE_VERSION;
+        header.slot_size = (uint32_t) sizeof(pmkcache_slot_t);
+        header.slots_cnt = slots_cnt ? slots_cnt : PMKCACHE_DEFAULT_SLOTS;
+
+        if (ftruncate(cache->fd, (off_t) (sizeof(pmkcache_header_t) +
+                                          header.slots_cnt * sizeof(pmkcache_slot_t))) != 0 ||
+            pwrite(cache->fd, &header, sizeof(pmkcache_header_t), 0) != (ssize_t) sizeof(pmkcache_header_t)) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            flock(cache->fd, LOCK_UN);
+            close(cache->fd);
+            return -1;
+        }
+    }
+
+    if (fstat(cache->fd, &st) != 0 || (size_t) st.st_size < sizeof(pmkcache_header_t) ||
+        pread(cache->fd, &header, sizeof(pmkcache_header_t), 0) != (ssize_t) sizeof(pmkcache_header_t) ||
+        memcmp(header.magic, PMKCACHE_MAGIC, sizeof(PMKCACHE_MAGIC)) != 0 || header.version != PMKCACHE_VERSION ||
+        header.slot_size != sizeof(pmkcache_slot_t) || header.slots_cnt == 0 ||
+        (header.slots_cnt & (header.slots_cnt - 1)) != 0 ||
+        (uint64_t) st.st_size != sizeof(pmkcache_header_t) + header.slots_cnt * sizeof(pmkcache_slot_t)) {
+        fprintf(stderr, "%s: not a PMK cache file\n", path);
+        flock(cache->fd, LOCK_UN);
+        close(cache->fd);
+        return -1;
+    }
+
+    grow = header.slots_cnt < slots_cnt ? slots_cnt : header.slots_cnt;
+    if (grow == header.slots_cnt && header.used >= header.slots_cnt / 4 * 3 && grow < PMKCACHE_MAX_SLOTS) grow <<= 1;
+
+    /* Not being able to grow the cache is no reason to give it up, it is used as it is */
+    if (grow > header.slots_cnt && pmkcache_grow(cache, path, &header, grow) == 0) {
+        st.st_size = (off_t) (sizeof(pmkcache_header_t) + grow * sizeof(pmkcache_slot_t));
+    }
+
+    flock(cache->fd, LOCK_UN);
+
+    cache->map_size = (size_t) st.st_size;
+    cache->header = (pmkcache_header_t *) mmap(NULL, cache->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                               cache->fd, 0);
+    if (cache->header == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(cache->fd);
+        return -1;
+    }
+
+    cache->slots = (pmkcache_slot_t *) (cache->header + 1);
+    pthread_rwlock_init(&cache->lock, NULL);
+
+    return 0;
+}
+
+
+/**                         pmkcache_lookup(pmkcache_t*, const unsigned char*, uint32_t, const unsigned char*, ...);
+ *
+ *  Requires:               - pmkcache_open(pmkcache_t*, const char*, uint64_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Looks up the PMK of an (ESSID, passphrase) pair. Lookups of different threads run in
+ *                          parallel, they only wait for inserts of this process.
+ *
+ *  @param cache:           cache that has to be searched.
+ *  @param essid:           ESSID.
+ *  @param essid_len:       length of the ESSID (at most MAX_ESSID_LENGTH).
+ *  @param password:        passphrase.
+ *  @param strlen_password: length of the passphrase (lower than MAX_LENGTH).
+ *  @param pmk:             output PMK, as the 8 words output by pbkdf2.
+ *  @return:                true if the PMK was cached, false otherwise.
+ */
+bit_t pmkcache_lookup(pmkcache_t *cache, const unsigned char *essid, uint32_t essid_len,
+                      const unsigned char *password, uint32_t strlen_password, uint32_t pmk[8]) {
+    uint64_t key = pmkcache_key(essid, essid_len, password, strlen_password);
+    pmkcache_slot_t *slot;
+    bit_t hit = false;
+
+    pthread_rwlock_rdlock(&cache->lock);
+
+    slot = pmkcache_find(cache, key, essid, essid_len, password, strlen_password);
+    if (slot && slot->key != 0) {
+        memcpy(pmk, slot->pmk, sizeof(slot->pmk));
+        hit = true;
+    }
+
+    pthread_rwlock_unlock(&cache->lock);
+
+    if (hit) {
+        __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+    }
+
+    return hit;
+}
+
+
+/**                         pmkcache_insert(pmkcache_t*, const unsigned char*, uint32_t, const unsigned char*, ...);
+ *
+ *  Requires:               - pmkcache_open(pmkcache_t*, const char*, uint64_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Stores the PMK of an (ESSID, passphrase) pair, unless it is already cached or the table
+ *                          reached its maximum load (three quarters of the slots), after which the cache is only read
+ *                          until it is opened again, and grown.
+ *                          Writers of every process are serialized by a lock on the file.
+ *
+ *  @param cache:           cache the PMK has to be stored in.
+ *  @param essid:           ESSID.
+ *  @param essid_len:       length of the ESSID (at most MAX_ESSID_LENGTH).
+ *  @param password:        passphrase.
+ *  @param strlen_password: length of the passphrase (lower than MAX_LENGTH).
+ *  @param pmk:             PMK, as the 8 words output by pbkdf2.
+ */
+void pmkcache_insert(pmkcache_t *cache, const unsigned char *essid, uint32_t essid_len,
+                     const unsigned char *password, uint32_t strlen_password, const uint32_t pmk[8]) {
+    uint64_t key = pmkcache_key(essid, essid_len, password, strlen_password);
+    pmkcache_slot_t *slot;
+
+    if (__atomic_load_n(&cache->full, __ATOMIC_RELAXED)) return;
+
+    pthread_rwlock_wrlock(&cache->lock);
+    flock(cache->fd, LOCK_EX);
+
+    if (cache->header->used >= cache->header->slots_cnt / 4 * 3) {
+        __atomic_store_n(&cache->full, true, __ATOMIC_RELAXED);
+    } else {
+        slot = pmkcache_find(cache, key, essid, essid_len, password, strlen_password);
+
+        if (slot && slot->key == 0) {
+            memcpy(slot->pmk, pmk, sizeof(slot->pmk));
+            slot->essid_len = (uint8_t) essid_len;
+            slot->password_len = (uint8_t) strlen_password;
+            memcpy(slot->essid, essid, essid_len);
+            memcpy(slot->password, password, strlen_password);
+
+            __atomic_store_n(&slot->key, key, __ATOMIC_RELEASE);
+            cache->header->used++;
+        }
+    }
+
+    flock(cache->fd, LOCK_UN);
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+
+/**                         pmkcache_close(pmkcache_t*);
+ *
+ *  Requires:               - pmkcache_open(pmkcache_t*, const char*, uint64_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that unmaps and closes the cache, the PMKs stored so far stay in the file.
+ *
+ *  @param cache:           cache that has to be closed.
+ */
+void pmkcache_close(pmkcache_t *cache) {
+    munmap(cache->header, cache->map_size);
+    close(cache->fd);
+    pthread_rwlock_destroy(&cache->lock);
+}
@@ -0,0 +1,105 @@
+#ifndef PMKCACHE_H
+#define PMKCACHE_H
+
+/** Includes */
+#include <pthread.h>
+#include "pbkdf2.h"
+#include "../cap2hccapx/cap2hccapx.h"
+
+/** Defines */
+/** Magic number at the start of a PMK cache file */
+#define PMKCACHE_MAGIC                  "WPA2PMK"
+
+/** Version of the PMK cache file format */
+#define PMKCACHE_VERSION                1
+
+/** Number of slots of a newly created cache (a power of two, ~144 MiB, allocated lazily by the file system) */
+#define PMKCACHE_DEFAULT_SLOTS          (1ULL << 20)
+
+/** Maximum number of slots of a cache (~144 GiB) */
+#define PMKCACHE_MAX_SLOTS              (1ULL << 30)
+
+/** Seed of the hash of the ESSID, which in turn seeds the hash of the passphrase */
+#define PMKCACHE_SEED                   0x5bd1e9955bd1e995ULL
+
+/**
+ * Definition of the structure pmkcache_header_t, stored at the start of the cache file, containing:
+ *
+ *  - magic:                PMKCACHE_MAGIC, NULL terminated.
+ *
+ *  - version:              PMKCACHE_VERSION.
+ *
+ *  - slot_size:            sizeof(pmkcache_slot_t), so that caches written by an incompatible build are rejected.
+ *
+ *  - slots_cnt:            number of slots of the table (a power of two).
+ *
+ *  - used:                 number of filled slots.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t slots_cnt;
+    uint64_t used;
+} pmkcache_header_t;
+
+/**
+ * Definition of the structure pmkcache_slot_t, containing a cached Pairwise Master Key:
+ *
+ *  - key:                  hash of ESSID and passphrase (never 0), 0 for empty slots. Written last, so that a slot is
+ *                          never seen half filled.
+ *
+ *  - pmk:                  the PMK, as the 8 words output by pbkdf2 (host byte order).
+ *
+ *  - essid_len, essid:     ESSID the PMK was derived with.
+ *
+ *  - password_len, password: passphrase the PMK was derived from.
+ */
+typedef struct {
+    uint64_t key;
+    uint32_t pmk[8];
+    uint8_t essid_len;
+    uint8_t password_len;
+    uint8_t essid[MAX_ESSID_LENGTH];
+    uint8_t password[MAX_LENGTH - 1];
+} pmkcache_slot_t;
+
+/**
+ * Definition of the structure pmkcache_t, containing an open PMK cache:
+ *
+ *  - fd:                   descriptor of the cache file, locked (flock) by writers of any process.
+ *
+ *  - header:               header of the file, mapped in memory.
+ *
+ *  - slots:                dynamic array of [header->slots_cnt] slots, mapped in memory after the header.
+ *
+ *  - map_size:             size of the mapping (the whole file).
+ *
+ *  - lock:                 serializes the writers of this process with respect to the readers.
+ *
+ *  - full:                 true once the table reached its maximum load, nothing is inserted anymore.
+ *
+ *  - hits:                 number of lookups served by the cache.
+ */
+typedef struct {
+    int fd;
+    pmkcache_header_t *header;
+    pmkcache_slot_t *slots;
+    size_t map_size;
+    pthread_rwlock_t lock;
+    bit_t full;
+    uint64_t hits;
+} pmkcache_t;
+
+/** Function declarations */
+int pmkcache_open(pmkcache_t *cache, const char *path, uint64_t slots_cnt);
+
+bit_t pmkcache_lookup(pmkcache_t *cache, const unsigned char *essid, uint32_t essid_len,
+                      const unsigned char *password, uint32_t strlen_password, uint32_t pmk[8]);
+
+void pmkcache_insert(pmkcache_t *cache, const unsigned char *essid, uint32_t essid_len,
+                     const unsigned char *password, uint32_t strlen_password, const uint32_t pmk[8]);
+
+void pmkcache_close(pmkcache_t *cache);
+
+#endif /* PMKCACHE_H */
@@ -0,0 +1,584 @@
+#include "pmktable.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SQLITE3
+#include <sqlite3.h>
+#endif
+
+
+/**                         pmktable_path(const char*, const unsigned char*, uint32_t, char[PMKTABLE_MAX_PATH]);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Builds the name of the table of an ESSID inside a table directory: the ESSID in hex plus
+ *                          PMKTABLE_EXTENSION, so that any ESSID maps to a valid file name.
+ *
+ *  @param dir:             directory holding the tables.
+ *  @param essid:           ESSID of the table.
+ *  @param essid_len:       length of the ESSID (at most MAX_ESSID_LENGTH).
+ *  @param path:            output buffer receiving the name, NULL terminated.
+ *  @return:                0 on success, -1 if the name does not fit in PMKTABLE_MAX_PATH (printed).
+ */
+int pmktable_path(const char *dir, const unsigned char *essid, uint32_t essid_len, char path[PMKTABLE_MAX_PATH]) {
+    size_t len = strlen(dir);
+
+    if (len + 1 + 2 * essid_len + sizeof(PMKTABLE_EXTENSION) > PMKTABLE_MAX_PATH) {
+        fprintf(stderr, "%s: %s\n", dir, strerror(ENAMETOOLONG));
+        return -1;
+    }
+
+    memcpy(path, dir, len);
+    path[len++] = '/';
+    for (uint32_t i = 0; i < essid_len; i++) len += (size_t) sprintf(path + len, "%02x", essid[i]);
+    memcpy(path + len, PMKTABLE_EXTENSION, sizeof(PMKTABLE_EXTENSION));
+
+    return 0;
+}
+
+
+/**                         pmktable_open(pmktable_t*, const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - pmktable_close(pmktable_t*);
+ *
+ *  Description:            Maps a PMK table in memory, read only: either a table written by the precompute mode or a
+ *                          coWPAtty/genpmk hashfile, told apart by their magic number. Both store the records the same
+ *                          way but for the bias of the length byte, so they are tested by the same code straight from
+ *                          the mapping. Records are read sequentially, the kernel is told so in order to read ahead
+ *                          aggressively.
+ *
+ *  @param table:           pmktable_t struct that has to be initialized.
+ *  @param path:            name of the table file.
+ *  @return:                0 on success, -1 on error (printed).
+ */
+int pmktable_open(pmktable_t *table, const char *path) {
+    const pmktable_header_t *header;
+    const unsigned char *map;
+    struct stat st;
+    uint32_t magic;
+    int fd;
+
+    memset(table, 0, sizeof(pmktable_t));
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return -1;
+    }
+
+    if ((size_t) st.st_size < sizeof(pmktable_header_t) && (size_t) st.st_size < PMKTABLE_COWPATTY_HEADER) {
+        fprintf(stderr, "%s: not a PMK table file\n", path);
+        close(fd);
+        return -1;
+    }
+
+    table->map_size = (size_t) st.st_size;
+    table->map = mmap(NULL, table->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (table->map == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    map = (const unsigned char *) table->map;
+    header = (const pmktable_header_t *) map;
+    memcpy(&magic, map, sizeof(uint32_t));
+
+    if (table->map_size >= sizeof(pmktable_header_t) &&
+        memcmp(header->magic, PMKTABLE_MAGIC, sizeof(PMKTABLE_MAGIC)) == 0 && header->version == PMKTABLE_VERSION &&
+        header->essid_len <= MAX_ESSID_LENGTH) {
+        table->essid_len = header->essid_len;
+        memcpy(table->essid, header->essid, MAX_ESSID_LENGTH);
+        table->records = map + sizeof(pmktable_header_t);
+        table->records_len = table->map_size - sizeof(pmktable_header_t);
+        table->records_cnt = header->records_cnt;
+    } else if (magic == PMKTABLE_COWPATTY_MAGIC && map[7] <= MAX_ESSID_LENGTH) {
+        table->essid_len = map[7];
+        memcpy(table->essid, map + 8, MAX_ESSID_LENGTH);
+        table->records = map + PMKTABLE_COWPATTY_HEADER;
+        table->records_len = table->map_size - PMKTABLE_COWPATTY_HEADER;
+        table->length_bias = PMKTABLE_COWPATTY_BIAS;
+    } else {
+        fprintf(stderr, "%s: not a PMK table file\n", path);
+        munmap(table->map, table->map_size);
+        return -1;
+    }
+
+    madvise(table->map, table->map_size, MADV_SEQUENTIAL);
+
+    return 0;
+}
+
+
+/**                         pmktable_close(pmktable_t*);
+ *
+ *  Requires:               - pmktable_open(pmktable_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that unmaps the table.
+ *
+ *  @param table:           table that has to be closed.
+ */
+void pmktable_close(pmktable_t *table) {
+    munmap(table->map, table->map_size);
+}
+
+
+/**                         pmktable_is_airolib(const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether a file is an SQLite database, as the ones of airolib-ng.
+ *
+ *  @param path:            name of the file.
+ *  @return:                true if the file starts with the SQLite magic string, false otherwise.
+ */
+bit_t pmktable_is_airolib(const char *path) {
+    char magic[sizeof(PMKTABLE_SQLITE_MAGIC)];
+    FILE *file = fopen(path, "rb");
+    bit_t airolib;
+
+    if (file == NULL) return false;
+
+    airolib = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+              memcmp(magic, PMKTABLE_SQLITE_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+
+    return airolib;
+}
+
+
+/**                         pmktable_airolib_open(pmktable_airolib_t*, pmktable_t*, const char*, ...);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - pmktable_airolib_next(pmktable_airolib_t*, pmktable_t*);
+ *                          - pmktable_airolib_close(pmktable_airolib_t*, pmktable_t*);
+ *
+ *  Description:            Opens, read only, an airolib-ng database and prepares the query returning the PMKs it holds
+ *                          for an ESSID. The PMKs are then read in chunks of [PMKTABLE_AIROLIB_CHUNK] records, each
+ *                          one tested as an in-memory table, so that memory stays bounded whatever the size of the
+ *                          database.
+ *
+ *  @param cursor:          pmktable_airolib_t struct that has to be initialized.
+ *  @param table:           pmktable_t struct receiving the chunks.
+ *  @param path:            name of the database.
+ *  @param essid:           ESSID whose PMKs have to be read.
+ *  @param essid_len:       length of the ESSID (at most MAX_ESSID_LENGTH).
+ *  @return:                0 on success, -1 on error (printed), also when built without SQLite.
+ */
+int pmktable_airolib_open(pmktable_airolib_t *cursor, pmktable_t *table, const char *path,
+                          const unsigned char *essid, uint32_t essid_len) {
+    memset(cursor, 0, sizeof(pmktable_airolib_t));
+    memset(table, 0, sizeof(pmktable_t));
+
+    table->essid_len = essid_len;
+    memcpy(table->essid, essid, essid_len);
+
+#ifdef HAVE_SQLITE3
+    sqlite3 *db;
+    sqlite3_stmt *statement;
+
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "SELECT passwd.passwd, pmk.pmk FROM pmk "
+                               "JOIN passwd ON passwd.passwd_id = pmk.passwd_id "
+                               "JOIN essid ON essid.essid_id = pmk.essid_id "
+                               "WHERE essid.essid = ?1 AND pmk.pmk IS NOT NULL", -1, &statement, NULL) != SQLITE_OK ||
+        sqlite3_bind_text(statement, 1, (const char *) essid, (int) essid_len, SQLITE_TRANSIENT) != SQLITE_OK) {
+        fprintf(stderr, "%s: %s\n", path, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+
+    cursor->db = db;
+    cursor->statement = statement;
+
+    return 0;
+#else
+    fprintf(stderr, "%s: airolib-ng databases require SQLite, which was not available at build time\n", path);
+    return -1;
+#endif
+}
+
+
+/**                         pmktable_airolib_next(pmktable_airolib_t*, pmktable_t*);
+ *
+ *  Requires:               - pmktable_airolib_open(pmktable_airolib_t*, pmktable_t*, const char*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Reads the next chunk of (passphrase, PMK) pairs into the table, replacing the previous
+ *                          chunk. Pairs with a malformed passphrase or PMK are skipped.
+ *
+ *  @param cursor:          cursor over the database.
+ *  @param table:           table receiving the chunk.
+ *  @return:                1 if a chunk was read, 0 if the query is exhausted, -1 on error (printed).
+ */
+int pmktable_airolib_next(pmktable_airolib_t *cursor, pmktable_t *table) {
+#ifdef HAVE_SQLITE3
+    sqlite3_stmt *statement = (sqlite3_stmt *) cursor->statement;
+    const unsigned char *password, *pmk;
+    uint32_t strlen_password;
+    int rc = SQLITE_ROW;
+
+    if (table->buffer == NULL) {
+        table->buffer_size = (uint64_t) PMKTABLE_AIROLIB_CHUNK * (1 + MAX_LENGTH + 32);
+        table->buffer = (unsigned char *) malloc(table->buffer_size);
+    }
+
+    table->records = table->buffer;
+    table->records_len = 0;
+    table->records_cnt = 0;
+
+    while (table->records_cnt < PMKTABLE_AIROLIB_CHUNK && (rc = sqlite3_step(statement)) == SQLITE_ROW) {
+        password = sqlite3_column_text(statement, 0);
+        strlen_password = (uint32_t) sqlite3_column_bytes(statement, 0);
+        pmk = (const unsigned char *) sqlite3_column_blob(statement, 1);
+
+        if (password == NULL || strlen_password >= MAX_LENGTH || pmk == NULL ||
+            sqlite3_column_bytes(statement, 1) != 32) {
+            continue;
+        }
+
+        table->buffer[table->records_len++] = (unsigned char) strlen_password;
+        memcpy(table->buffer + table->records_len, password, strlen_password);
+        memcpy(table->buffer + table->records_len + strlen_password, pmk, 32);
+        table->records_len += strlen_password + 32;
+        table->records_cnt++;
+    }
+
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        fprintf(stderr, "airolib-ng database: %s\n", sqlite3_errmsg((sqlite3 *) cursor->db));
+        return -1;
+    }
+
+    return table->records_cnt > 0 ? 1 : 0;
+#else
+    (void) cursor;
+    (void) table;
+    return -1;
+#endif
+}
+
+
+/**                         pmktable_airolib_close(pmktable_airolib_t*, pmktable_t*);
+ *
+ *  Requires:               - pmktable_airolib_open(pmktable_airolib_t*, pmktable_t*, const char*, ...);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that closes the database and disposes the chunk buffer of the table.
+ *
+ *  @param cursor:          cursor that has to be closed.
+ *  @param table:           table that received the chunks.
+ */
+void pmktable_airolib_close(pmktable_airolib_t *cursor, pmktable_t *table) {
+#ifdef HAVE_SQLITE3
+    sqlite3_finalize((sqlite3_stmt *) cursor->statement);
+    sqlite3_close((sqlite3 *) cursor->db);
+#else
+    (void) cursor;
+#endif
+    free(table->buffer);
+    table->buffer = NULL;
+}
+
+
+/**                         [Private] pmktable_compare(const void*, const void*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            qsort comparator of two length prefixed passphrases, in byte order.
+ *
+ *  @param p1:              pointer to the first passphrase.
+ *  @param p2:              pointer to the second passphrase.
+ *  @return:                <0, 0 or >0 as memcmp.
+ */
+static int pmktable_compare(const void *p1, const void *p2) {
+    const unsigned char *a = *(unsigned char *const *) p1, *b = *(unsigned char *const *) p2;
+    int rc = memcmp(a + 1, b + 1, a[0] < b[0] ? a[0] : b[0]);
+
+    return rc != 0 ? rc : (int) a[0] - (int) b[0];
+}
+
+
+/**                         [Private] pmktable_worker(void*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Body of the precomputing threads: each thread reserves the next [PMKTABLE_BATCH]
+ *                          passphrases and derives their PMKs, until every passphrase has been handed out.
+ *
+ *  @param arg:             pmktable_job_t the thread works on.
+ *  @return:                NULL.
+ */
+static void *pmktable_worker(void *arg) {
+    pmktable_job_t *job = (pmktable_job_t *) arg;
+    uint64_t first, last;
+
+    for (;;) {
+        first = __atomic_fetch_add(&job->next, PMKTABLE_BATCH, __ATOMIC_RELAXED);
+        if (first >= job->words_cnt) break;
+
+        last = job->words_cnt - first < PMKTABLE_BATCH ? job->words_cnt : first + PMKTABLE_BATCH;
+
+        for (uint64_t i = first; i < last; i++) {
+            pbkdf2_pmk(job->words[i] + 1, job->words[i][0], job->essid, job->essid_len, job->pmks[i]);
+        }
+    }
+
+    return NULL;
+}
+
+
+/**                         [Private] pmktable_write(const char*, const pmktable_job_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Writes the table of a precomputed ESSID. The table is written next to its final name and
+ *                          renamed once complete, so that a crash never leaves a truncated table behind.
+ *
+ *  @param path:            name of the table file.
+ *  @param job:             precomputed ESSID.
+ *  @return:                0 on success, -1 on error (printed).
+ */
+static int pmktable_write(const char *path, const pmktable_job_t *job) {
+    char temp_path[PMKTABLE_MAX_PATH + 4];
+    pmktable_header_t header;
+    unsigned char pmk[32];
+    FILE *file;
+    int rc = 0;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    memset(&header, 0, sizeof(pmktable_header_t));
+    memcpy(header.magic, PMKTABLE_MAGIC, sizeof(PMKTABLE_MAGIC));
+    header.version = PMKTABLE_VERSION;
+    header.essid_len = job->essid_len;
+    memcpy(header.essid, job->essid, job->essid_len);
+    header.records_cnt = job->words_cnt;
+
+    file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "%s: %s\n", temp_path, strerror(errno));
+        return -1;
+    }
+
+    fwrite(&header, sizeof(pmktable_header_t), 1, file);
+
+    for (uint64_t i = 0; i < job->words_cnt; i++) {
+        for (uint32_t j = 0; j < 8; j++) {
+            pmk[j * 4] = (unsigned char) (job->pmks[i][j] >> 24);
+            pmk[j * 4 + 1] = (unsigned char) (job->pmks[i][j] >> 16);
+            pmk[j * 4 + 2] = (unsigned char) (job->pmks[i][j] >> 8);
+            pmk[j * 4 + 3] = (unsigned char) job->pmks[i][j];
+        }
+
+        fwrite(job->words[i], 1, 1 + job->words[i][0], file);
+        fwrite(pmk, 1, sizeof(pmk), file);
+    }
+
+    if (ferror(file)) rc = -1;
+    if (fclose(file) != 0) rc = -1;
+
+    if (rc != 0 || rename(temp_path, path) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        remove(temp_path);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+/**                         [Private] pmktable_usage(char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that prints the synopsis of the precompute mode and exits.
+ *
+ *  @param program:         name of the program.
+ */
+static void pmktable_usage(char *program) {
+    fprintf(stderr, "Usage: %s precompute [options] -o <table_dir> <essid_list> <wordlist>...\n"
+                    "\n"
+                    "  -o, --output <dir>      Directory the tables are written to, one per ESSID\n"
+                    "  -t, --threads <n>       Threads deriving the PMKs (default: online CPUs)\n",
+            program);
+    exit(-1);
+}
+
+
+/**                         pmktable_main(int, char**);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Entry point of the "precompute" mode: derives, ahead of capture time, the PMK of every
+ *                          passphrase of the wordlists for every ESSID of the list (one per line). Passphrases are
+ *                          sorted and deduplicated once, then each ESSID is spread over the threads and written as a
+ *                          sorted table, which the cracker tests at the cost of the PTK/MIC check only.
+ *
+ *  @param argc:            argument counter, argv[0] being the program name.
+ *  @param argv:            argument vector of the mode.
+ *  @return:                0 on success, -1 on error.
+ */
+int pmktable_main(int argc, char **argv) {
+
+    static struct option long_options[] = {
+            {"output",  required_argument, NULL, 'o'},
+            {"threads", required_argument, NULL, 't'},
+            {NULL, 0,                      NULL, 0}
+    };
+
+    keyspace_t loaded;
+    wordlist_t wordlist;
+    pmktable_job_t job;
+    pthread_t *threads;
+    FILE *essid_list;
+
+    unsigned char password[MAX_LENGTH];
+    char line[256], path[PMKTABLE_MAX_PATH], *output_dir = NULL;
+    uint32_t strlen_password, threads_cnt = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN), essids_cnt = 0;
+    uint64_t unique = 0;
+    size_t len;
+    int option, rc = 0;
+
+    while ((option = getopt_long(argc, argv, "o:t:", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'o':
+                output_dir = optarg;
+                break;
+            case 't':
+                threads_cnt = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                pmktable_usage(argv[0]);
+        }
+    }
+
+    if (output_dir == NULL || argc - optind < 2 || threads_cnt == 0) {
+        pmktable_usage(argv[0]);
+    }
+
+    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "%s: %s\n", output_dir, strerror(errno));
+        return -1;
+    }
+
+    essid_list = fopen(argv[optind], "r");
+    if (essid_list == NULL) {
+        fprintf(stderr, "Error in opening ESSID list \"%s\", exiting.\n", argv[optind]);
+        return -1;
+    }
+
+    /* Passphrases are loaded, sorted and deduplicated once, whatever the number of ESSIDs */
+    keyspace_init_words(&loaded);
+
+    for (int i = optind + 1; i < argc && rc == 0; i++) {
+        if (wordlist_open(&wordlist, argv[i]) != 0) {
+            fprintf(stderr, "Error in opening wordlist file \"%s\", exiting.\n", argv[i]);
+            rc = -1;
+            break;
+        }
+
+        while ((rc = wordlist_next(&wordlist, password, &strlen_password)) == 1) {
+            if (strlen_password >= PMKTABLE_MIN_LENGTH) keyspace_add_word(&loaded, password, strlen_password);
+        }
+
+        wordlist_close(&wordlist);
+
+        if (rc == -1) {
+            fprintf(stderr, "Error in reading wordlist file \"%s\", exiting.\n", argv[i]);
+        }
+    }
+
+    memset(&job, 0, sizeof(pmktable_job_t));
+    job.words = (unsigned char **) malloc((loaded.words_cnt + 1) * sizeof(unsigned char *));
+
+    for (uint64_t i = 0; i < loaded.words_cnt; i++) {
+        job.words[i] = loaded.words + loaded.offsets[i];
+    }
+
+    qsort(job.words, loaded.words_cnt, sizeof(unsigned char *), pmktable_compare);
+
+    for (uint64_t i = 0; i < loaded.words_cnt; i++) {
+        if (unique == 0 || pmktable_compare(&job.words[unique - 1], &job.words[i]) != 0) {
+            job.words[unique++] = job.words[i];
+        }
+    }
+
+    job.words_cnt = unique;
+    job.pmks = (uint32_t (*)[8]) malloc((unique + 1) * sizeof(*job.pmks));
+    threads = (pthread_t *) malloc(threads_cnt * sizeof(pthread_t));
+
+    printf("%" PRIu64 " unique passphrases of at least %d characters.\n", unique, PMKTABLE_MIN_LENGTH);
+
+    while (rc == 0 && fgets(line, sizeof(line), essid_list)) {
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+
+        if (len == 0) continue;
+
+        if (len > MAX_ESSID_LENGTH) {
+            fprintf(stderr, "ESSID \"%s\" longer than %d characters, skipped.\n", line, MAX_ESSID_LENGTH);
+            continue;
+        }
+
+        job.essid = (const unsigned char *) line;
+        job.essid_len = (uint32_t) len;
+        job.next = 0;
+
+        for (uint32_t i = 0; i < threads_cnt; i++) {
+            pthread_create(&threads[i], NULL, pmktable_worker, &job);
+        }
+
+        for (uint32_t i = 0; i < threads_cnt; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        rc = pmktable_path(output_dir, job.essid, job.essid_len, path);
+        if (rc == 0) rc = pmktable_write(path, &job);
+
+        if (rc == 0) {
+            printf("ESSID \"%s\": %" PRIu64 " PMKs written to: %s\n", line, unique, path);
+            essids_cnt++;
+        }
+    }
+
+    fclose(essid_list);
+    free(threads);
+    free(job.pmks);
+    free(job.words);
+    keyspace_dispose(&loaded);
+
+    if (rc == 0) {
+        printf("Precomputed %" PRIu32 " ESSIDs.\n", essids_cnt);
+    }
+
+    return rc;
+}
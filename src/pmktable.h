@@ -0,0 +1,147 @@
+#ifndef PMKTABLE_H
+#define PMKTABLE_H
+
+/** Includes */
+#include "keyspace.h"
+#include "../cap2hccapx/cap2hccapx.h"
+
+/** Defines */
+/** Magic number at the start of a PMK table file */
+#define PMKTABLE_MAGIC                  "WPA2PMT"
+
+/** Version of the PMK table file format */
+#define PMKTABLE_VERSION                1
+
+/** Extension of the PMK table files, named after the ESSID in hex */
+#define PMKTABLE_EXTENSION              ".pmk"
+
+/** Magic number of coWPAtty/genpmk hashfiles, stored in host byte order */
+#define PMKTABLE_COWPATTY_MAGIC         0x43575041
+
+/** Size of the header of coWPAtty/genpmk hashfiles: magic, 3 reserved bytes, ESSID length, ESSID */
+#define PMKTABLE_COWPATTY_HEADER        (4 + 3 + 1 + 32)
+
+/** Length byte of a coWPAtty record minus the length of its passphrase (length byte itself and PMK included) */
+#define PMKTABLE_COWPATTY_BIAS          33
+
+/** Magic string at the start of SQLite databases (airolib-ng) */
+#define PMKTABLE_SQLITE_MAGIC           "SQLite format 3"
+
+/** Number of PMKs read at once from an airolib-ng database */
+#define PMKTABLE_AIROLIB_CHUNK          65536
+
+/** Maximum length of the name of a PMK table file */
+#define PMKTABLE_MAX_PATH               4096
+
+/** Number of consecutive PMKs reserved at once by a precomputing thread */
+#define PMKTABLE_BATCH                  64
+
+/** Minimum length of a WPA2 passphrase, shorter words are not precomputed */
+#define PMKTABLE_MIN_LENGTH             8
+
+/**
+ * Definition of the structure pmktable_header_t, stored at the start of a PMK table file and followed by the records,
+ * sorted by passphrase and duplicate free: [1 byte length][passphrase][32 bytes PMK, big endian].
+ *
+ *  - magic:                PMKTABLE_MAGIC, NULL terminated.
+ *
+ *  - version:              PMKTABLE_VERSION.
+ *
+ *  - essid_len, essid:     ESSID every PMK of the table was derived with.
+ *
+ *  - records_cnt:          number of records following the header.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t essid_len;
+    uint8_t essid[MAX_ESSID_LENGTH];
+    uint64_t records_cnt;
+} pmktable_header_t;
+
+/**
+ * Definition of the structure pmktable_t, containing (passphrase, PMK) records held in memory, whatever their source:
+ * [1 byte length + length_bias][passphrase][32 bytes PMK, big endian].
+ *
+ *  - map, map_size:        mapping of the whole file, NULL for records read into memory (airolib-ng).
+ *
+ *  - essid_len, essid:     ESSID every PMK was derived with.
+ *
+ *  - records:              first record.
+ *
+ *  - records_len:          number of bytes of the records.
+ *
+ *  - records_cnt:          number of records, 0 if unknown (coWPAtty hashfiles do not record it).
+ *
+ *  - length_bias:          value added to the length of the passphrase in the length byte of a record (0 for the own
+ *                          tables and for airolib-ng, PMKTABLE_COWPATTY_BIAS for coWPAtty hashfiles).
+ *
+ *  - buffer, buffer_size:  dynamic array holding the records read into memory, and its capacity.
+ */
+typedef struct {
+    void *map;
+    size_t map_size;
+    uint32_t essid_len;
+    uint8_t essid[MAX_ESSID_LENGTH];
+    const unsigned char *records;
+    uint64_t records_len;
+    uint64_t records_cnt;
+    uint32_t length_bias;
+    unsigned char *buffer;
+    uint64_t buffer_size;
+} pmktable_t;
+
+/**
+ * Definition of the structure pmktable_airolib_t, containing a cursor over the PMKs of an ESSID stored in an
+ * airolib-ng database:
+ *
+ *  - db:                   the database (sqlite3*, opaque so that the header does not depend on SQLite).
+ *
+ *  - statement:            query returning the (passphrase, PMK) pairs of the ESSID (sqlite3_stmt*).
+ */
+typedef struct {
+    void *db;
+    void *statement;
+} pmktable_airolib_t;
+
+/**
+ * Definition of the structure pmktable_job_t, containing the PMKs of an ESSID being precomputed:
+ *
+ *  - essid, essid_len:     ESSID the PMKs are derived with.
+ *
+ *  - words:                dynamic array of [words_cnt] sorted, length prefixed passphrases.
+ *
+ *  - words_cnt:            number of passphrases.
+ *
+ *  - next:                 index of the next passphrase to be reserved by a thread.
+ *
+ *  - pmks:                 dynamic array of [words_cnt][8] PMK words, filled by the threads.
+ */
+typedef struct {
+    const unsigned char *essid;
+    uint32_t essid_len;
+    unsigned char **words;
+    uint64_t words_cnt;
+    uint64_t next;
+    uint32_t (*pmks)[8];
+} pmktable_job_t;
+
+/** Function declarations */
+int pmktable_path(const char *dir, const unsigned char *essid, uint32_t essid_len, char path[PMKTABLE_MAX_PATH]);
+
+int pmktable_open(pmktable_t *table, const char *path);
+
+void pmktable_close(pmktable_t *table);
+
+bit_t pmktable_is_airolib(const char *path);
+
+int pmktable_airolib_open(pmktable_airolib_t *cursor, pmktable_t *table, const char *path,
+                          const unsigned char *essid, uint32_t essid_len);
+
+int pmktable_airolib_next(pmktable_airolib_t *cursor, pmktable_t *table);
+
+void pmktable_airolib_close(pmktable_airolib_t *cursor, pmktable_t *table);
+
+int pmktable_main(int argc, char **argv);
+
+#endif /* PMKTABLE_H */
@@ -0,0 +1,422 @@
+#include "potfile.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/file.h>
+
+
+/**                         [Private] potfile_key(const hccapx_t*, char[POTFILE_KEY_LENGTH + 1]);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Formats the key a handshake is recorded under: MIC, AP MAC, STA MAC and ESSID in lower
+ *                          case hex, separated by '*'.
+ *
+ *  @param hccapx:          handshake whose key has to be formatted.
+ *  @param key:             output buffer, NULL terminated.
+ *  @return:                length of the key.
+ */
+static uint32_t potfile_key(const hccapx_t *hccapx, char key[POTFILE_KEY_LENGTH + 1]) {
+    uint32_t len = 0, essid_len = hccapx->essid_len > MAX_ESSID_LENGTH ? MAX_ESSID_LENGTH : hccapx->essid_len;
+
+    for (uint32_t i = 0; i < 16; i++) len += sprintf(key + len, "%02x", hccapx->keymic[i]);
+    key[len++] = '*';
+    for (uint32_t i = 0; i < 6; i++) len += sprintf(key + len, "%02x", hccapx->mac_ap[i]);
+    key[len++] = '*';
+    for (uint32_t i = 0; i < 6; i++) len += sprintf(key + len, "%02x", hccapx->mac_sta[i]);
+    key[len++] = '*';
+    for (uint32_t i = 0; i < essid_len; i++) len += sprintf(key + len, "%02x", hccapx->essid[i]);
+    key[len] = '\0';
+
+    return len;
+}
+
+
+/**                         [Private] potfile_decode(const char*, uint32_t, unsigned char*, uint32_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Decodes the password field of a potfile line, either plain or, for passwords holding
+ *                          non printable bytes, hex encoded as $HEX[...] (as hashcat does). Raw PSKs are stored as
+ *                          their [PSK_HEX_LENGTH] hex digits.
+ *
+ *  @param field:           password field.
+ *  @param strlen_field:    length of the field, line terminator excluded.
+ *  @param password:        output buffer, NULL terminated.
+ *  @param strlen_password: output length of the password.
+ *  @return:                0 on success, -1 if the field is malformed or too long.
+ */
+static int potfile_decode(const char *field, uint32_t strlen_field, unsigned char password[PSK_HEX_LENGTH + 1],
+                          uint32_t *strlen_password) {
+    unsigned int byte;
+
+    if (strlen_field > 6 && strncmp(field, "$HEX[", 5) == 0 && field[strlen_field - 1] == ']') {
+        if ((strlen_field - 6) % 2 != 0 || (strlen_field - 6) / 2 >= MAX_LENGTH) return -1;
+
+        *strlen_password = (strlen_field - 6) / 2;
+        for (uint32_t i = 0; i < *strlen_password; i++) {
+            if (sscanf(field + 5 + i * 2, "%2x", &byte) != 1) return -1;
+            password[i] = (unsigned char) byte;
+        }
+    } else {
+        if (strlen_field >= MAX_LENGTH && strlen_field != PSK_HEX_LENGTH) return -1;
+
+        *strlen_password = strlen_field;
+        memcpy(password, field, strlen_field);
+    }
+
+    password[*strlen_password] = '\0';
+
+    return 0;
+}
+
+
+/**                         [Private] potfile_field(char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that strips the line terminator of a potfile line and locates the password
+ *                          field, which follows the first ':' (keys never contain one).
+ *
+ *  @param line:            potfile line, modified in place.
+ *  @return:                the password field, NULL if the line is malformed.
+ */
+static char *potfile_field(char *line) {
+    char *colon = strchr(line, ':');
+    size_t len = strlen(line);
+
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+
+    return colon ? colon + 1 : NULL;
+}
+
+
+/**                         [Private] potfile_index_find(const potfile_t*, const char*, uint64_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Probes the index of the keys linearly from the home slot of the key, until the key or an
+ *                          empty slot is found.
+ *
+ *  @param potfile:         loaded potfile.
+ *  @param key:             key of a handshake, NULL terminated.
+ *  @param hash:            hash of the key.
+ *  @return:                the slot holding the key, or the empty slot it would be stored in.
+ */
+static uint32_t *potfile_index_find(const potfile_t *potfile, const char *key, uint64_t hash) {
+    uint32_t mask = potfile->index_size - 1, *slot;
+    const potfile_entry_t *entry;
+
+    for (uint32_t index = (uint32_t) hash & mask;; index = (index + 1) & mask) {
+        slot = &potfile->index[index];
+        if (*slot == 0) return slot;
+
+        entry = &potfile->entries[*slot - 1];
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) return slot;
+    }
+}
+
+
+/**                         [Private] potfile_add(potfile_t*, const potfile_entry_t*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends a decoded line to the loaded potfile, indexing its key unless an earlier line
+ *                          already holds it (the first line of a handshake is the one looked up, as when scanning the
+ *                          file). The index is doubled and rebuilt once half full.
+ *
+ *  @param potfile:         loaded potfile.
+ *  @param entry:           decoded line.
+ *  @return:                0 on success, -1 on allocation failure.
+ */
+static int potfile_add(potfile_t *potfile, const potfile_entry_t *entry) {
+    potfile_entry_t *entries;
+    uint32_t *index, *slot;
+
+    if (potfile->entries_cnt == potfile->entries_size) {
+        entries = (potfile_entry_t *) realloc(potfile->entries, (potfile->entries_size ? potfile->entries_size * 2 :
+                                                                  POTFILE_INDEX_SLOTS / 2) * sizeof(potfile_entry_t));
+        if (entries == NULL) return -1;
+
+        potfile->entries = entries;
+        potfile->entries_size = potfile->entries_size ? potfile->entries_size * 2 : POTFILE_INDEX_SLOTS / 2;
+    }
+
+    if ((potfile->entries_cnt + 1) * 2 > potfile->index_size) {
+        index = (uint32_t *) calloc(potfile->index_size * 2, sizeof(uint32_t));
+        if (index == NULL) return -1;
+
+        free(potfile->index);
+        potfile->index = index;
+        potfile->index_size *= 2;
+
+        for (uint32_t i = 0; i < potfile->entries_cnt; i++) {
+            slot = potfile_index_find(potfile, potfile->entries[i].key, potfile->entries[i].hash);
+            if (*slot == 0) *slot = i + 1;
+        }
+    }
+
+    potfile->entries[potfile->entries_cnt++] = *entry;
+
+    slot = potfile_index_find(potfile, entry->key, entry->hash);
+    if (*slot == 0) *slot = potfile->entries_cnt;
+
+    return 0;
+}
+
+
+/**                         potfile_open(potfile_t*, const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - potfile_refresh(potfile_t*);
+ *                          - potfile_lookup(const potfile_t*, const hccapx_t*, unsigned char*, uint32_t*);
+ *                          - potfile_load_passwords(const potfile_t*, keyspace_t*);
+ *                          - potfile_close(potfile_t*);
+ *
+ *  Description:            Loads the potfile in memory, indexed by handshake key, so that looking up a handshake does
+ *                          not scan the file. A missing potfile is an empty one.
+ *
+ *  @param potfile:         potfile_t struct that has to be initialized.
+ *  @param path:            name of the potfile.
+ *  @return:                0 on success, -1 on read error.
+ */
+int potfile_open(potfile_t *potfile, const char *path) {
+    memset(potfile, 0, sizeof(potfile_t));
+    potfile->path = path;
+
+    potfile->index_size = POTFILE_INDEX_SLOTS;
+    potfile->index = (uint32_t *) calloc(potfile->index_size, sizeof(uint32_t));
+    if (potfile->index == NULL) return -1;
+
+    return potfile_refresh(potfile);
+}
+
+
+/**                         potfile_refresh(potfile_t*);
+ *
+ *  Requires:               - potfile_open(potfile_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Loads the lines appended to the potfile since it was last loaded, by this run or by
+ *                          concurrent ones: the file is only ever appended to, under an exclusive lock, so reading
+ *                          from the previous end under a shared one never sees half a line.
+ *
+ *  @param potfile:         loaded potfile.
+ *  @return:                0 on success, -1 on read error.
+ */
+int potfile_refresh(potfile_t *potfile) {
+    char line[POTFILE_MAX_LINE + 1], *field;
+    potfile_entry_t entry;
+    size_t strlen_key;
+    FILE *file;
+    int rc = 0;
+
+    file = fopen(potfile->path, "r");
+    if (file == NULL) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    flock(fileno(file), LOCK_SH);
+
+    if (fseeko(file, potfile->offset, SEEK_SET) != 0) rc = -1;
+
+    while (rc == 0 && fgets(line, sizeof(line), file)) {
+        field = potfile_field(line);
+        if (field == NULL) continue;
+
+        strlen_key = (size_t) (field - 1 - line);
+        if (strlen_key > POTFILE_KEY_LENGTH ||
+            potfile_decode(field, (uint32_t) strlen(field), entry.password, &entry.strlen_password) != 0) continue;
+
+        memcpy(entry.key, line, strlen_key);
+        entry.key[strlen_key] = '\0';
+        entry.hash = hash64((const unsigned char *) entry.key, (uint32_t) strlen_key, 0);
+
+        rc = potfile_add(potfile, &entry);
+    }
+
+    if (ferror(file)) rc = -1;
+    if (rc == 0) potfile->offset = ftello(file);
+
+    flock(fileno(file), LOCK_UN);
+    fclose(file);
+
+    return rc;
+}
+
+
+/**                         potfile_lookup(const potfile_t*, const hccapx_t*, unsigned char*, uint32_t*);
+ *
+ *  Requires:               - potfile_open(potfile_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Looks for a handshake in the loaded potfile, so that handshakes cracked in an earlier run
+ *                          are not cracked again.
+ *
+ *  @param potfile:         loaded potfile.
+ *  @param hccapx:          handshake that has to be looked up.
+ *  @param password:        output buffer receiving the password, NULL terminated.
+ *  @param strlen_password: output length of the password.
+ *  @return:                true if the handshake has already been cracked, false otherwise.
+ */
+bit_t potfile_lookup(const potfile_t *potfile, const hccapx_t *hccapx, unsigned char password[PSK_HEX_LENGTH + 1],
+                     uint32_t *strlen_password) {
+    char key[POTFILE_KEY_LENGTH + 1];
+    uint32_t strlen_key = potfile_key(hccapx, key);
+    const potfile_entry_t *entry;
+    uint32_t *slot;
+
+    slot = potfile_index_find(potfile, key, hash64((const unsigned char *) key, strlen_key, 0));
+    if (*slot == 0) return false;
+
+    entry = &potfile->entries[*slot - 1];
+    memcpy(password, entry->password, entry->strlen_password + 1);
+    *strlen_password = entry->strlen_password;
+
+    return true;
+}
+
+
+/**                         potfile_append(const char*, const hccapx_t*, const unsigned char*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Records a cracked handshake at the end of the potfile. The file is only ever appended to,
+ *                          under an exclusive lock, so that concurrent runs sharing a potfile never interleave lines.
+ *
+ *  @param path:            name of the potfile.
+ *  @param hccapx:          handshake that has been cracked.
+ *  @param password:        password of the handshake.
+ *  @param strlen_password: length of the password.
+ *  @return:                0 on success, -1 on error.
+ */
+int potfile_append(const char *path, const hccapx_t *hccapx, const unsigned char *password,
+                   uint32_t strlen_password) {
+    char line[POTFILE_MAX_LINE + 1];
+    uint32_t len = potfile_key(hccapx, line);
+    bit_t printable = true;
+    FILE *file;
+    int rc = 0;
+
+    for (uint32_t i = 0; i < strlen_password; i++) {
+        if (password[i] < 0x20 || password[i] > 0x7e) printable = false;
+    }
+
+    /* A plain password looking like an encoded one has to be encoded too */
+    if (strlen_password > 6 && strncmp((const char *) password, "$HEX[", 5) == 0) printable = false;
+
+    line[len++] = ':';
+    if (printable) {
+        memcpy(line + len, password, strlen_password);
+        len += strlen_password;
+    } else {
+        len += sprintf(line + len, "$HEX[");
+        for (uint32_t i = 0; i < strlen_password; i++) len += sprintf(line + len, "%02x", password[i]);
+        line[len++] = ']';
+    }
+    line[len++] = '\n';
+
+    file = fopen(path, "a");
+    if (file == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    flock(fileno(file), LOCK_EX);
+
+    if (fwrite(line, 1, len, file) != len || fflush(file) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        rc = -1;
+    }
+
+    flock(fileno(file), LOCK_UN);
+    fclose(file);
+
+    return rc;
+}
+
+
+/**                         potfile_load_passwords(const potfile_t*, keyspace_t*);
+ *
+ *  Requires:               - potfile_open(potfile_t*, const char*);
+ *
+ *  Allows:                 - keyspace_candidate(const keyspace_t*, const unsigned char*, uint32_t, uint64_t, ...);
+ *                          - keyspace_dispose(keyspace_t*);
+ *
+ *  Description:            Loads the distinct passwords of the potfile into an in-memory keyspace, most recent first,
+ *                          for the loopback pre-pass: passwords cracked on a network are often reused on others.
+ *
+ *  @param potfile:         loaded potfile.
+ *  @param keyspace:        keyspace_t struct that has to be initialized with the passwords.
+ *  @return:                number of passwords loaded, -1 on allocation failure.
+ */
+int potfile_load_passwords(const potfile_t *potfile, keyspace_t *keyspace) {
+    const potfile_entry_t *entry, *other;
+    uint32_t *seen, seen_size = 1, mask, index, passwords_cnt = 0;
+    uint64_t hash;
+
+    keyspace_init_words(keyspace);
+
+    /* Set of the passwords already loaded, as positions + 1 in the entries, at most half full */
+    while (seen_size < potfile->entries_cnt * 2) seen_size <<= 1;
+    seen = (uint32_t *) calloc(seen_size, sizeof(uint32_t));
+    if (seen == NULL) return -1;
+    mask = seen_size - 1;
+
+    for (uint32_t i = potfile->entries_cnt; i > 0; i--) {
+        entry = &potfile->entries[i - 1];
+
+        /* Raw PSKs do not fit in a keyspace candidate, only passphrases are looped back */
+        if (entry->strlen_password >= MAX_LENGTH) continue;
+
+        hash = hash64(entry->password, entry->strlen_password, 0);
+        for (index = (uint32_t) hash & mask; seen[index] != 0; index = (index + 1) & mask) {
+            other = &potfile->entries[seen[index] - 1];
+            if (other->strlen_password == entry->strlen_password &&
+                memcmp(other->password, entry->password, entry->strlen_password) == 0) break;
+        }
+        if (seen[index] != 0) continue;
+
+        seen[index] = i;
+        keyspace_add_word(keyspace, entry->password, entry->strlen_password);
+        passwords_cnt++;
+    }
+
+    free(seen);
+
+    return (int) passwords_cnt;
+}
+
+
+/**                         potfile_close(potfile_t*);
+ *
+ *  Requires:               - potfile_open(potfile_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that frees the loaded potfile.
+ *
+ *  @param potfile:         potfile that has to be freed.
+ */
+void potfile_close(potfile_t *potfile) {
+    free(potfile->entries);
+    free(potfile->index);
+}
@@ -0,0 +1,77 @@
+#ifndef POTFILE_H
+#define POTFILE_H
+
+/** Includes */
+#include <sys/types.h>
+#include "keyspace.h"
+#include "../cap2hccapx/cap2hccapx.h"
+
+/** Defines */
+/** Default potfile, in the working directory */
+#define POTFILE_DEFAULT_PATH            "wpa2.potfile"
+
+/** Length of the key of a potfile line: mic*mac_ap*mac_sta*essid, all in hex */
+#define POTFILE_KEY_LENGTH              (32 + 1 + 12 + 1 + 12 + 1 + 2 * MAX_ESSID_LENGTH)
+
+/** Maximum length of a potfile line: key, ':', password possibly encoded as $HEX[...], newline */
+#define POTFILE_MAX_LINE                (POTFILE_KEY_LENGTH + 1 + 6 + 2 * MAX_LENGTH + 1 + 1)
+
+/** Initial number of slots of the index of the loaded potfile (a power of two) */
+#define POTFILE_INDEX_SLOTS             1024
+
+/**
+ * Definition of the structure potfile_entry_t, containing a decoded potfile line:
+ *
+ *  - key:                  key of the handshake (mic*mac_ap*mac_sta*essid in hex), NULL terminated.
+ *
+ *  - hash:                 hash of the key.
+ *
+ *  - password, strlen_password: password of the handshake, NULL terminated, and its length.
+ */
+typedef struct {
+    char key[POTFILE_KEY_LENGTH + 1];
+    uint64_t hash;
+    unsigned char password[PSK_HEX_LENGTH + 1];
+    uint32_t strlen_password;
+} potfile_entry_t;
+
+/**
+ * Definition of the structure potfile_t, containing the potfile loaded in memory:
+ *
+ *  - path:                 name of the potfile.
+ *
+ *  - offset:               bytes of the potfile loaded so far (the file is only ever appended to).
+ *
+ *  - entries, entries_cnt: dynamic array of the lines loaded, in file order.
+ *
+ *  - entries_size:         capacity of entries.
+ *
+ *  - index, index_size:    open addressing table of [index_size] slots (a power of two, at most half full) indexing
+ *                          the keys, every slot holding the position + 1 of the first entry of its key, 0 if empty.
+ */
+typedef struct {
+    const char *path;
+    off_t offset;
+    potfile_entry_t *entries;
+    uint32_t entries_cnt;
+    uint32_t entries_size;
+    uint32_t *index;
+    uint32_t index_size;
+} potfile_t;
+
+/** Function declarations */
+int potfile_open(potfile_t *potfile, const char *path);
+
+int potfile_refresh(potfile_t *potfile);
+
+bit_t potfile_lookup(const potfile_t *potfile, const hccapx_t *hccapx, unsigned char password[PSK_HEX_LENGTH + 1],
+                     uint32_t *strlen_password);
+
+int potfile_append(const char *path, const hccapx_t *hccapx, const unsigned char *password,
+                   uint32_t strlen_password);
+
+int potfile_load_passwords(const potfile_t *potfile, keyspace_t *keyspace);
+
+void potfile_close(potfile_t *potfile);
+
+#endif /* POTFILE_H */
@@ -0,0 +1,500 @@
+#include "rules.h"
+
+#include <string.h>
+#include <errno.h>
+
+
+/**                         [Private] rules_operands(uint8_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that tells which operands follow a hashcat rule function: 'N' stands for
+ *                          a position (0-9, A-Z), 'X' for a character. Functions relying on the memorized word (M, 4,
+ *                          6, X, Q) are not supported.
+ *
+ *  @param function:        function character.
+ *  @return:                string describing the operands ("" if none), NULL if the function is not supported.
+ */
+static const char *rules_operands(uint8_t function) {
+    switch (function) {
+        case ':': case 'l': case 'u': case 'c': case 'C': case 't': case 'r': case 'd': case 'f':
+        case '{': case '}': case '[': case ']': case 'q': case 'k': case 'K': case 'E':
+            return "";
+        case 'T': case 'p': case 'D': case '\'': case 'z': case 'Z': case 'L': case 'R': case '+':
+        case '-': case '.': case ',': case 'y': case 'Y': case '<': case '>': case '_':
+            return "N";
+        case '$': case '^': case '@': case '!': case '/': case '(': case ')': case 'e':
+            return "X";
+        case 'x': case 'O': case '*':
+            return "NN";
+        case 'i': case 'o': case '=': case '%': case '3':
+            return "NX";
+        case 's':
+            return "XX";
+        default:
+            return NULL;
+    }
+}
+
+
+/**                         [Private] rules_position(char);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that decodes a hashcat position operand.
+ *
+ *  @param c:               operand character.
+ *  @return:                0-9 for '0'-'9', 10-35 for 'A'-'Z', -1 otherwise.
+ */
+static int rules_position(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+
+    return -1;
+}
+
+
+/** ASCII case helpers, independent of the locale */
+static uint8_t rules_lower(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+}
+
+static uint8_t rules_upper(uint8_t c) {
+    return (c >= 'a' && c <= 'z') ? c - 32 : c;
+}
+
+static uint8_t rules_toggle(uint8_t c) {
+    if (c >= 'a' && c <= 'z') return c - 32;
+    if (c >= 'A' && c <= 'Z') return c + 32;
+
+    return c;
+}
+
+
+/**                         rules_compile(rule_t*, const char*, uint32_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - rules_apply(const rule_t*, const unsigned char*, uint32_t, unsigned char*, uint32_t*);
+ *
+ *  Description:            Compiles a rule written in the hashcat rule language into bytecode, so that operands are
+ *                          parsed once per rule instead of once per candidate. Spaces between functions are ignored.
+ *
+ *  @param rule:            rule_t struct that has to be filled.
+ *  @param text:            rule as written in the rule file.
+ *  @param strlen_text:     length of the rule.
+ *  @return:                0 on success, -1 if the rule is malformed, uses an unsupported function or is too long.
+ */
+int rules_compile(rule_t *rule, const char *text, uint32_t strlen_text) {
+    const char *operands;
+    uint32_t i = 0;
+    int position;
+
+    rule->code_len = 0;
+
+    while (i < strlen_text) {
+        if (text[i] == ' ') {
+            i++;
+            continue;
+        }
+
+        operands = rules_operands((uint8_t) text[i]);
+        if (operands == NULL) return -1;
+        if (rule->code_len + 1 + strlen(operands) > RULES_MAX_CODE) return -1;
+
+        rule->code[rule->code_len++] = (uint8_t) text[i++];
+
+        for (; *operands; operands++, i++) {
+            if (i >= strlen_text) return -1;
+
+            if (*operands == 'N') {
+                position = rules_position(text[i]);
+                if (position < 0) return -1;
+                rule->code[rule->code_len++] = (uint8_t) position;
+            } else {
+                rule->code[rule->code_len++] = (uint8_t) text[i];
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/**                         rules_load(rules_t*, const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - rules_apply(const rule_t*, const unsigned char*, uint32_t, unsigned char*, uint32_t*);
+ *                          - rules_dispose(rules_t*);
+ *
+ *  Description:            Reads and compiles a hashcat compatible rule file, one rule per line. Empty lines and lines
+ *                          starting with '#' are ignored; rules that cannot be compiled are reported and skipped, as
+ *                          hashcat does.
+ *
+ *  @param rules:           rules_t struct that has to be filled.
+ *  @param path:            name of the rule file.
+ *  @return:                0 on success, -1 if the file could not be read.
+ */
+int rules_load(rules_t *rules, const char *path) {
+    char line[RULES_MAX_LINE + 2];
+    uint32_t strlen_line, line_no = 0, rules_size = 0;
+    FILE *file;
+
+    memset(rules, 0, sizeof(rules_t));
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        line_no++;
+        strlen_line = (uint32_t) strlen(line);
+
+        while (strlen_line > 0 && (line[strlen_line - 1] == '\n' || line[strlen_line - 1] == '\r')) {
+            line[--strlen_line] = '\0';
+        }
+
+        if (strlen_line == 0 || line[0] == '#') continue;
+
+        if (rules->rules_cnt == rules_size) {
+            rules_size = rules_size ? rules_size * 2 : 64;
+            rules->rules = (rule_t *) realloc(rules->rules, rules_size * sizeof(rule_t));
+        }
+
+        if (rules_compile(&rules->rules[rules->rules_cnt], line, strlen_line) != 0) {
+            fprintf(stderr, "Skipping invalid or unsupported rule in file \"%s\" on line %" PRIu32 ": %s\n", path,
+                    line_no, line);
+            rules->invalid++;
+            continue;
+        }
+
+        rules->rules_cnt++;
+    }
+
+    if (ferror(file)) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        fclose(file);
+        rules_dispose(rules);
+        return -1;
+    }
+
+    fclose(file);
+
+    return 0;
+}
+
+
+/**                         rules_apply(const rule_t*, const unsigned char*, uint32_t, unsigned char*, uint32_t*);
+ *
+ *  Requires:               - rules_compile(rule_t*, const char*, uint32_t);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Runs the bytecode of a rule over a base word. As in hashcat, functions whose positions
+ *                          fall outside the word, or that would overflow the working buffer, leave the word unchanged.
+ *                          The function only touches its arguments, so it can be called concurrently.
+ *
+ *  @param rule:            compiled rule.
+ *  @param word:            base word.
+ *  @param strlen_word:     length of the base word.
+ *  @param candidate:       output buffer receiving the mangled candidate, NULL terminated.
+ *  @param strlen_candidate: output length of the mangled candidate.
+ *  @return:                true if a candidate was produced, false if the rule rejected the word or the result does
+ *                          not fit in a password.
+ */
+bit_t rules_apply(const rule_t *rule, const unsigned char *word, uint32_t strlen_word,
+                  unsigned char candidate[MAX_LENGTH], uint32_t *strlen_candidate) {
+    uint8_t buffer[RULES_BUFFER_SIZE], temp[RULES_BUFFER_SIZE];
+    uint32_t len = strlen_word, pc = 0, i, count;
+    uint8_t op, n, m, x, y;
+    bit_t next_upper;
+
+    if (len >= RULES_BUFFER_SIZE) return false;
+    memcpy(buffer, word, len);
+
+    while (pc < rule->code_len) {
+        op = rule->code[pc++];
+        n = m = x = y = 0;
+
+        /* Operands were validated at compile time, their layout only depends on the function */
+        switch (op) {
+            case 'T': case 'p': case 'D': case '\'': case 'z': case 'Z': case 'L': case 'R': case '+':
+            case '-': case '.': case ',': case 'y': case 'Y': case '<': case '>': case '_':
+                n = rule->code[pc++];
+                break;
+            case '$': case '^': case '@': case '!': case '/': case '(': case ')': case 'e':
+                x = rule->code[pc++];
+                break;
+            case 'x': case 'O': case '*':
+                n = rule->code[pc++];
+                m = rule->code[pc++];
+                break;
+            case 'i': case 'o': case '=': case '%': case '3':
+                n = rule->code[pc++];
+                x = rule->code[pc++];
+                break;
+            case 's':
+                x = rule->code[pc++];
+                y = rule->code[pc++];
+                break;
+            default:
+                break;
+        }
+
+        switch (op) {
+            case ':':
+                break;
+            case 'l':
+                for (i = 0; i < len; i++) buffer[i] = rules_lower(buffer[i]);
+                break;
+            case 'u':
+                for (i = 0; i < len; i++) buffer[i] = rules_upper(buffer[i]);
+                break;
+            case 'c':
+                for (i = 0; i < len; i++) buffer[i] = rules_lower(buffer[i]);
+                if (len > 0) buffer[0] = rules_upper(buffer[0]);
+                break;
+            case 'C':
+                for (i = 0; i < len; i++) buffer[i] = rules_upper(buffer[i]);
+                if (len > 0) buffer[0] = rules_lower(buffer[0]);
+                break;
+            case 't':
+                for (i = 0; i < len; i++) buffer[i] = rules_toggle(buffer[i]);
+                break;
+            case 'T':
+                if (n < len) buffer[n] = rules_toggle(buffer[n]);
+                break;
+            case 'r':
+                for (i = 0; i < len / 2; i++) {
+                    x = buffer[i];
+                    buffer[i] = buffer[len - 1 - i];
+                    buffer[len - 1 - i] = x;
+                }
+                break;
+            case 'd':
+                if (len * 2 > RULES_BUFFER_SIZE) break;
+                memcpy(buffer + len, buffer, len);
+                len *= 2;
+                break;
+            case 'p':
+                if (len * (n + 1) > RULES_BUFFER_SIZE) break;
+                for (i = 1; i <= n; i++) memcpy(buffer + len * i, buffer, len);
+                len *= n + 1;
+                break;
+            case 'f':
+                if (len * 2 > RULES_BUFFER_SIZE) break;
+                for (i = 0; i < len; i++) buffer[len + i] = buffer[len - 1 - i];
+                len *= 2;
+                break;
+            case '{':
+                if (len == 0) break;
+                x = buffer[0];
+                memmove(buffer, buffer + 1, len - 1);
+                buffer[len - 1] = x;
+                break;
+            case '}':
+                if (len == 0) break;
+                x = buffer[len - 1];
+                memmove(buffer + 1, buffer, len - 1);
+                buffer[0] = x;
+                break;
+            case '$':
+                if (len + 1 > RULES_BUFFER_SIZE) break;
+                buffer[len++] = x;
+                break;
+            case '^':
+                if (len + 1 > RULES_BUFFER_SIZE) break;
+                memmove(buffer + 1, buffer, len++);
+                buffer[0] = x;
+                break;
+            case '[':
+                if (len == 0) break;
+                memmove(buffer, buffer + 1, --len);
+                break;
+            case ']':
+                if (len > 0) len--;
+                break;
+            case 'D':
+                if (n >= len) break;
+                memmove(buffer + n, buffer + n + 1, len - n - 1);
+                len--;
+                break;
+            case 'x':
+                if (n >= len || n + m > len) break;
+                memmove(buffer, buffer + n, m);
+                len = m;
+                break;
+            case 'O':
+                if (n >= len || n + m > len) break;
+                memmove(buffer + n, buffer + n + m, len - n - m);
+                len -= m;
+                break;
+            case 'i':
+                if (n > len || len + 1 > RULES_BUFFER_SIZE) break;
+                memmove(buffer + n + 1, buffer + n, len - n);
+                buffer[n] = x;
+                len++;
+                break;
+            case 'o':
+                if (n < len) buffer[n] = x;
+                break;
+            case '\'':
+                if (n < len) len = n;
+                break;
+            case 's':
+                for (i = 0; i < len; i++) if (buffer[i] == x) buffer[i] = y;
+                break;
+            case '@':
+                for (i = 0, count = 0; i < len; i++) if (buffer[i] != x) buffer[count++] = buffer[i];
+                len = count;
+                break;
+            case 'z':
+                if (len == 0 || len + n > RULES_BUFFER_SIZE) break;
+                memmove(buffer + n, buffer, len);
+                memset(buffer, buffer[n], n);
+                len += n;
+                break;
+            case 'Z':
+                if (len == 0 || len + n > RULES_BUFFER_SIZE) break;
+                memset(buffer + len, buffer[len - 1], n);
+                len += n;
+                break;
+            case 'q':
+                if (len * 2 > RULES_BUFFER_SIZE) break;
+                for (i = len; i > 0; i--) {
+                    buffer[i * 2 - 1] = buffer[i - 1];
+                    buffer[i * 2 - 2] = buffer[i - 1];
+                }
+                len *= 2;
+                break;
+            case 'k':
+                if (len < 2) break;
+                x = buffer[0];
+                buffer[0] = buffer[1];
+                buffer[1] = x;
+                break;
+            case 'K':
+                if (len < 2) break;
+                x = buffer[len - 2];
+                buffer[len - 2] = buffer[len - 1];
+                buffer[len - 1] = x;
+                break;
+            case '*':
+                if (n >= len || m >= len) break;
+                x = buffer[n];
+                buffer[n] = buffer[m];
+                buffer[m] = x;
+                break;
+            case 'L':
+                if (n < len) buffer[n] = (uint8_t) (buffer[n] << 1);
+                break;
+            case 'R':
+                if (n < len) buffer[n] = (uint8_t) (buffer[n] >> 1);
+                break;
+            case '+':
+                if (n < len) buffer[n]++;
+                break;
+            case '-':
+                if (n < len) buffer[n]--;
+                break;
+            case '.':
+                if ((uint32_t) n + 1 < len) buffer[n] = buffer[n + 1];
+                break;
+            case ',':
+                if (n >= 1 && n < len) buffer[n] = buffer[n - 1];
+                break;
+            case 'y':
+                if (n > len || len + n > RULES_BUFFER_SIZE) break;
+                memcpy(temp, buffer, n);
+                memmove(buffer + n, buffer, len);
+                memcpy(buffer, temp, n);
+                len += n;
+                break;
+            case 'Y':
+                if (n > len || len + n > RULES_BUFFER_SIZE) break;
+                memcpy(buffer + len, buffer + len - n, n);
+                len += n;
+                break;
+            case 'E':
+            case 'e':
+                if (op == 'E') x = ' ';
+                next_upper = true;
+                for (i = 0; i < len; i++) {
+                    buffer[i] = next_upper ? rules_upper(buffer[i]) : rules_lower(buffer[i]);
+                    next_upper = buffer[i] == x;
+                }
+                break;
+            case '3':
+                for (i = 0, count = 0; i < len; i++) {
+                    if (buffer[i] != x) continue;
+                    if (count++ == n) {
+                        if (i + 1 < len) buffer[i + 1] = rules_toggle(buffer[i + 1]);
+                        break;
+                    }
+                }
+                break;
+            case '<':
+                if (len > n) return false;
+                break;
+            case '>':
+                if (len < n) return false;
+                break;
+            case '_':
+                if (len != n) return false;
+                break;
+            case '!':
+                if (memchr(buffer, x, len)) return false;
+                break;
+            case '/':
+                if (memchr(buffer, x, len) == NULL) return false;
+                break;
+            case '(':
+                if (len == 0 || buffer[0] != x) return false;
+                break;
+            case ')':
+                if (len == 0 || buffer[len - 1] != x) return false;
+                break;
+            case '=':
+                if (n >= len || buffer[n] != x) return false;
+                break;
+            case '%':
+                for (i = 0, count = 0; i < len; i++) if (buffer[i] == x) count++;
+                if (count < n) return false;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if (len >= MAX_LENGTH) return false;
+
+    memcpy(candidate, buffer, len);
+    candidate[len] = '\0';
+    *strlen_candidate = len;
+
+    return true;
+}
+
+
+/**                         rules_dispose(rules_t*);
+ *
+ *  Requires:               - rules_load(rules_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that disposes the compiled rules.
+ *
+ *  @param rules:           rules_t struct that has to be disposed.
+ */
+void rules_dispose(rules_t *rules) {
+    free(rules->rules);
+    rules->rules = NULL;
+    rules->rules_cnt = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef RULES_H
+#define RULES_H
+
+/** Includes */
+#include "pbkdf2.h"
+
+/** Defines */
+/** Maximum size in bytes of the bytecode of a single rule */
+#define RULES_MAX_CODE                  96
+
+/** Size of the working buffer a rule is applied in (intermediate results may exceed MAX_LENGTH) */
+#define RULES_BUFFER_SIZE               256
+
+/** Maximum length of a line of the rule file */
+#define RULES_MAX_LINE                  256
+
+/**
+ * Definition of the structure rule_t, containing a rule compiled into bytecode:
+ *
+ *  - code:                 sequence of instructions, each made of the hashcat function character followed by its
+ *                          operands already decoded (positions as integers, characters as bytes).
+ *
+ *  - code_len:             number of bytes used in code.
+ */
+typedef struct {
+    uint8_t code[RULES_MAX_CODE];
+    uint8_t code_len;
+} rule_t;
+
+/**
+ * Definition of the structure rules_t, containing:
+ *
+ *  - rules:                dynamic array of compiled rules, in the order of the rule file.
+ *
+ *  - rules_cnt:            number of entries in rules.
+ *
+ *  - invalid:              number of lines of the rule file that could not be compiled and were skipped.
+ */
+typedef struct {
+    rule_t *rules;
+    uint32_t rules_cnt;
+    uint32_t invalid;
+} rules_t;
+
+/** Function declarations */
+int rules_compile(rule_t *rule, const char *text, uint32_t strlen_text);
+
+int rules_load(rules_t *rules, const char *path);
+
+bit_t rules_apply(const rule_t *rule, const unsigned char *word, uint32_t strlen_word,
+                  unsigned char candidate[MAX_LENGTH], uint32_t *strlen_candidate);
+
+void rules_dispose(rules_t *rules);
+
+#endif /* RULES_H */
@@ -0,0 +1,219 @@
+#include "watch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+
+
+/**                         watch_is_capture(const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Tells whether a file name is the one of a capture: ".cap", ".pcap" or ".pcapng" extension.
+ *
+ *  @param name:            file name, possibly preceded by its directory.
+ *  @return:                true if the file is a capture, false otherwise.
+ */
+bit_t watch_is_capture(const char *name) {
+    const char *base = strrchr(name, '/');
+    const char *extension = strrchr(name, '.');
+
+    if (extension == NULL || (base && extension < base)) return false;
+
+    return strcmp(extension + 1, "cap") == 0 || strcmp(extension + 1, "pcap") == 0 ||
+           strcmp(extension + 1, "pcapng") == 0;
+}
+
+
+/**                         [Private] watch_queue(watch_t*, const char*);
+ *
+ *  Requires:               - watch_open(watch_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Queues a capture of the directory, unless the file name is not the one of a capture or is
+ *                          hidden, as the temporary files of tools writing a capture before renaming it often are.
+ *
+ *  @param watch:           watch_t struct the capture has to be queued in.
+ *  @param name:            file name, relative to the directory.
+ *  @return:                0 on success, -1 on allocation failure (printed).
+ */
+static int watch_queue(watch_t *watch, const char *name) {
+    char *path, **pending;
+
+    if (name[0] == '.' || !watch_is_capture(name)) return 0;
+
+    path = (char *) malloc(strlen(watch->dir) + strlen(name) + 2);
+    pending = path ? (char **) realloc(watch->pending, (watch->pending_cnt + 1) * sizeof(char *)) : NULL;
+    if (pending == NULL) {
+        fprintf(stderr, "%s: %s\n", watch->dir, strerror(ENOMEM));
+        free(path);
+        return -1;
+    }
+
+    sprintf(path, "%s/%s", watch->dir, name);
+    watch->pending = pending;
+    watch->pending[watch->pending_cnt++] = path;
+
+    return 0;
+}
+
+
+/**                         [Private] watch_filter_capture(const struct dirent*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            scandir filter keeping the captures only, hidden files excluded.
+ *
+ *  @param entry:           directory entry that has to be evaluated.
+ *  @return:                1 if the entry is a capture, 0 otherwise.
+ */
+static int watch_filter_capture(const struct dirent *entry) {
+    return entry->d_name[0] != '.' && watch_is_capture(entry->d_name);
+}
+
+
+/**                         watch_open(watch_t*, const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - watch_next(watch_t*, char**, bit_t, const volatile sig_atomic_t*);
+ *                          - watch_close(watch_t*);
+ *
+ *  Description:            Starts watching a directory for captures, through inotify: a capture is reported once
+ *                          written and closed, or once moved into the directory, never while still being written.
+ *                          The captures already in the directory are queued first, in alphabetical order. The
+ *                          directory is watched before being listed, so that no capture is missed: one written in
+ *                          between may be reported twice.
+ *
+ *  @param watch:           watch_t struct that has to be initialized.
+ *  @param dir:             directory that has to be watched, which must outlive the watch.
+ *  @return:                0 on success, -1 on error (printed).
+ */
+int watch_open(watch_t *watch, const char *dir) {
+    struct dirent **entries;
+    int entries_cnt, rc = 0;
+
+    memset(watch, 0, sizeof(watch_t));
+    watch->dir = dir;
+
+    watch->fd = inotify_init1(IN_CLOEXEC);
+    if (watch->fd == -1) {
+        fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    if (inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) == -1) {
+        fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        close(watch->fd);
+        return -1;
+    }
+
+    entries_cnt = scandir(dir, &entries, watch_filter_capture, alphasort);
+    if (entries_cnt < 0) {
+        fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        close(watch->fd);
+        return -1;
+    }
+
+    for (int i = 0; i < entries_cnt; i++) {
+        if (rc == 0) rc = watch_queue(watch, entries[i]->d_name);
+        free(entries[i]);
+    }
+    free(entries);
+
+    if (rc == -1) watch_close(watch);
+
+    return rc;
+}
+
+
+/**                         watch_next(watch_t*, char**, bit_t, const volatile sig_atomic_t*);
+ *
+ *  Requires:               - watch_open(watch_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Returns the next capture of the directory, either queued or reported by inotify since the
+ *                          last call, optionally waiting for one to be written.
+ *
+ *  @param watch:           watch_t struct the capture has to be taken from.
+ *  @param path:            output name of the capture, directory included (malloc'ed, freed by the caller).
+ *  @param wait:            true if the function has to wait for a capture, false if it has to return at once.
+ *  @param interrupted:     flag set asynchronously (e.g. by a signal handler) to stop waiting.
+ *  @return:                1 if a capture is returned, 0 if none (not waiting, or interrupted), -1 on error.
+ */
+int watch_next(watch_t *watch, char **path, bit_t wait, const volatile sig_atomic_t *interrupted) {
+    char events[WATCH_EVENTS_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    struct pollfd pollfd = {watch->fd, POLLIN, 0};
+    ssize_t len;
+    int rc;
+
+    while (watch->pending_cnt == 0) {
+        rc = poll(&pollfd, 1, wait ? WATCH_POLL_MS : 0);
+        if (rc == -1 && errno != EINTR) {
+            fprintf(stderr, "%s: %s\n", watch->dir, strerror(errno));
+            return -1;
+        }
+
+        if (rc <= 0) {
+            if (!wait || *interrupted) return 0;
+            continue;
+        }
+
+        len = read(watch->fd, events, sizeof(events));
+        if (len == -1) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "%s: %s\n", watch->dir, strerror(errno));
+            return -1;
+        }
+
+        for (char *ptr = events; ptr < events + len; ptr += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *) ptr;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                fprintf(stderr, "%s: Too many captures at once, some of them have been missed\n", watch->dir);
+            }
+
+            if (event->len > 0 && !(event->mask & IN_ISDIR) && watch_queue(watch, event->name) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    *path = watch->pending[0];
+    memmove(&watch->pending[0], &watch->pending[1], (--watch->pending_cnt) * sizeof(char *));
+
+    return 1;
+}
+
+
+/**                         watch_close(watch_t*);
+ *
+ *  Requires:               - watch_open(watch_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that stops watching the directory and frees the captures still queued.
+ *
+ *  @param watch:           watch_t struct that has to be disposed.
+ */
+void watch_close(watch_t *watch) {
+    for (uint32_t i = 0; i < watch->pending_cnt; i++) {
+        free(watch->pending[i]);
+    }
+    free(watch->pending);
+
+    close(watch->fd);
+}
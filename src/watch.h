@@ -0,0 +1,42 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/** Includes */
+#include <signal.h>
+#include "sha1.h"
+
+/** Defines */
+/** Size of the buffer the inotify events are read in, room for a few dozen events */
+#define WATCH_EVENTS_BUFFER             4096
+
+/** Milliseconds between two checks of the interruption flag while waiting for a capture */
+#define WATCH_POLL_MS                   1000
+
+/**
+ * Definition of the structure watch_t, containing:
+ *
+ *  - fd:                   inotify instance the events of the directory are read from.
+ *
+ *  - dir:                  directory watched.
+ *
+ *  - pending:              array of [pending_cnt] names of captures found but not returned yet, oldest first.
+ *
+ *  - pending_cnt:          number of entries in pending.
+ */
+typedef struct {
+    int fd;
+    const char *dir;
+    char **pending;
+    uint32_t pending_cnt;
+} watch_t;
+
+/** Function declarations */
+bit_t watch_is_capture(const char *name);
+
+int watch_open(watch_t *watch, const char *dir);
+
+int watch_next(watch_t *watch, char **path, bit_t wait, const volatile sig_atomic_t *interrupted);
+
+void watch_close(watch_t *watch);
+
+#endif /* WATCH_H */
@@ -0,0 +1,658 @@
+#include "wordlist.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+
+/**                         [Private] wordlist_fill(wordlist_t*, wordlist_block_t*, uint64_t);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that reads synchronously from the wordlist file until either [length]
+ *                          bytes are stored in the block or the end of file is reached, retrying on short reads.
+ *
+ *  @param wordlist:        wordlist whose file descriptor has to be read.
+ *  @param block:           block whose data buffer has to be filled starting from its current length.
+ *  @param length:          number of bytes that need to be held by the block once the function returns.
+ *  @return:                0 on success (end of file included), -1 on read error.
+ */
+static int wordlist_fill(wordlist_t *wordlist, wordlist_block_t *block, uint64_t length) {
+    ssize_t nread;
+
+    while (block->length < length) {
+        if (wordlist->use_uring) {
+            nread = pread(wordlist->fd, block->data + block->length, length - block->length,
+                          (off_t) (block->offset + block->length));
+        } else {
+            nread = read(wordlist->fd, block->data + block->length, length - block->length);
+        }
+
+        if (nread < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        if (nread == 0) break;
+
+        block->length += nread;
+    }
+
+    return 0;
+}
+
+
+/**                         [Private] wordlist_read_ahead(void*);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Body of the read-ahead thread. Fills the blocks of the ring in order as soon as the consumer
+ *                          releases them, so that up to [WORDLIST_BLOCKS_IN_FLIGHT] blocks are read ahead of the
+ *                          consumer. Terminates on end of file, on read error or when asked to stop.
+ *
+ *  @param arg:             wordlist_t whose blocks have to be filled.
+ *  @return:                NULL.
+ */
+static void *wordlist_read_ahead(void *arg) {
+    wordlist_t *wordlist = (wordlist_t *) arg;
+    wordlist_block_t *block;
+    uint32_t index = 0;
+    uint64_t offset = 0;
+    bit_t error;
+
+    for (;;) {
+        block = &wordlist->blocks[index];
+
+        pthread_mutex_lock(&wordlist->mutex);
+        while (block->state != WORDLIST_BLOCK_FREE && !wordlist->stop) {
+            pthread_cond_wait(&wordlist->freed, &wordlist->mutex);
+        }
+        if (wordlist->stop) {
+            pthread_mutex_unlock(&wordlist->mutex);
+            break;
+        }
+        block->state = WORDLIST_BLOCK_PENDING;
+        pthread_mutex_unlock(&wordlist->mutex);
+
+        block->offset = offset;
+        block->length = 0;
+        error = wordlist_fill(wordlist, block, WORDLIST_BLOCK_SIZE) == -1 ? true : false;
+        offset += block->length;
+
+        pthread_mutex_lock(&wordlist->mutex);
+        block->error = error;
+        block->last = (error || block->length < WORDLIST_BLOCK_SIZE) ? true : false;
+        block->state = WORDLIST_BLOCK_FILLED;
+        pthread_cond_signal(&wordlist->filled);
+        pthread_mutex_unlock(&wordlist->mutex);
+
+        if (block->last) break;
+
+        index = (index + 1) % WORDLIST_BLOCKS_IN_FLIGHT;
+    }
+
+    return NULL;
+}
+
+#ifdef HAVE_LIBURING
+
+/**                         [Private] wordlist_uring_submit(wordlist_t*, wordlist_block_t*);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 - wordlist_uring_wait(wordlist_t*, wordlist_block_t*);
+ *
+ *  Description:            Utility function that queues an asynchronous read of the next [WORDLIST_BLOCK_SIZE] bytes
+ *                          of the file into the given block. Blocks past the end of file are marked as filled and empty.
+ *
+ *  @param wordlist:        wordlist owning the io_uring instance.
+ *  @param block:           free block that has to be filled.
+ */
+static void wordlist_uring_submit(wordlist_t *wordlist, wordlist_block_t *block) {
+    struct io_uring_sqe *sqe;
+
+    block->offset = wordlist->next_offset;
+    block->length = 0;
+    block->error = false;
+
+    if (wordlist->next_offset >= wordlist->file_size) {
+        block->last = true;
+        block->state = WORDLIST_BLOCK_FILLED;
+        return;
+    }
+
+    sqe = io_uring_get_sqe(&wordlist->ring);
+    io_uring_prep_read(sqe, wordlist->fd, block->data, WORDLIST_BLOCK_SIZE, block->offset);
+    io_uring_sqe_set_data(sqe, block);
+
+    block->state = WORDLIST_BLOCK_PENDING;
+    wordlist->next_offset += WORDLIST_BLOCK_SIZE;
+
+    io_uring_submit(&wordlist->ring);
+}
+
+
+/**                         [Private] wordlist_uring_wait(wordlist_t*, wordlist_block_t*);
+ *
+ *  Requires:               - wordlist_uring_submit(wordlist_t*, wordlist_block_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that reaps io_uring completions until the given block is filled. Reads
+ *                          complete out of order, so completions of other blocks are recorded along the way. Short
+ *                          reads that stop before the end of file are completed synchronously.
+ *
+ *  @param wordlist:        wordlist owning the io_uring instance.
+ *  @param block:           block the consumer is waiting for.
+ */
+static void wordlist_uring_wait(wordlist_t *wordlist, wordlist_block_t *block) {
+    struct io_uring_cqe *cqe;
+    wordlist_block_t *done;
+    uint64_t expected;
+    int rc;
+
+    while (block->state == WORDLIST_BLOCK_PENDING) {
+        rc = io_uring_wait_cqe(&wordlist->ring, &cqe);
+        if (rc == -EINTR) continue;
+        if (rc < 0) {
+            block->error = true;
+            block->last = true;
+            block->state = WORDLIST_BLOCK_FILLED;
+            return;
+        }
+
+        done = (wordlist_block_t *) io_uring_cqe_get_data(cqe);
+
+        if (cqe->res < 0) {
+            done->error = true;
+        } else {
+            done->length = cqe->res;
+            expected = wordlist->file_size - done->offset;
+            if (expected > WORDLIST_BLOCK_SIZE) expected = WORDLIST_BLOCK_SIZE;
+            if (done->length < expected && wordlist_fill(wordlist, done, expected) == -1) {
+                done->error = true;
+            }
+        }
+
+        io_uring_cqe_seen(&wordlist->ring, cqe);
+
+        done->last = (done->error || done->offset + done->length >= wordlist->file_size) ? true : false;
+        done->state = WORDLIST_BLOCK_FILLED;
+    }
+}
+
+#endif /* HAVE_LIBURING */
+
+
+/**                         wordlist_open(wordlist_t*, const char*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 - wordlist_next(wordlist_t*, unsigned char[MAX_LENGTH], uint32_t*);
+ *                          - wordlist_next_line(wordlist_t*, unsigned char*, uint32_t, uint32_t*);
+ *                          - wordlist_close(wordlist_t*);
+ *
+ *  Description:            Opens the wordlist file and starts prefetching its first [WORDLIST_BLOCKS_IN_FLIGHT] blocks.
+ *                          Regular files are read through asynchronous io_uring reads when the library is available
+ *                          (HAVE_LIBURING), otherwise a read-ahead thread keeps the ring of blocks filled, so that the
+ *                          consumer only waits on storage when it is faster than the disk.
+ *
+ *  @param wordlist:        wordlist_t struct that has to be initialized.
+ *  @param path:            name of the wordlist file.
+ *  @return:                0 on success, -1 if the file could not be opened.
+ */
+int wordlist_open(wordlist_t *wordlist, const char *path) {
+    struct stat st;
+    uint32_t i;
+
+    memset(wordlist, 0, sizeof(wordlist_t));
+    memset(&st, 0, sizeof(struct stat));
+    wordlist->path = path;
+
+    wordlist->fd = open(path, O_RDONLY);
+    if (wordlist->fd < 0) {
+        return -1;
+    }
+
+    if (fstat(wordlist->fd, &st) == 0 && S_ISDIR(st.st_mode)) {
+        close(wordlist->fd);
+        errno = EISDIR;
+        return -1;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(wordlist->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    for (i = 0; i < WORDLIST_BLOCKS_IN_FLIGHT; i++) {
+        wordlist->blocks[i].data = (unsigned char *) malloc(WORDLIST_BLOCK_SIZE);
+        wordlist->blocks[i].state = WORDLIST_BLOCK_FREE;
+    }
+
+#ifdef HAVE_LIBURING
+    if (S_ISREG(st.st_mode) && io_uring_queue_init(WORDLIST_BLOCKS_IN_FLIGHT, &wordlist->ring, 0) == 0) {
+        wordlist->use_uring = true;
+        wordlist->file_size = st.st_size;
+        wordlist->next_offset = 0;
+
+        for (i = 0; i < WORDLIST_BLOCKS_IN_FLIGHT; i++) {
+            wordlist_uring_submit(wordlist, &wordlist->blocks[i]);
+        }
+
+        return 0;
+    }
+#endif
+
+    pthread_mutex_init(&wordlist->mutex, NULL);
+    pthread_cond_init(&wordlist->filled, NULL);
+    pthread_cond_init(&wordlist->freed, NULL);
+
+    pthread_create(&wordlist->thread, NULL, wordlist_read_ahead, wordlist);
+
+    return 0;
+}
+
+
+/**                         [Private] wordlist_acquire(wordlist_t*);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 - wordlist_release(wordlist_t*);
+ *
+ *  Description:            Utility function that waits until the block the consumer is positioned on is filled.
+ *
+ *  @param wordlist:        wordlist whose current block has to be acquired.
+ *  @return:                the acquired block.
+ */
+static wordlist_block_t *wordlist_acquire(wordlist_t *wordlist) {
+    wordlist_block_t *block = &wordlist->blocks[wordlist->consumer_block];
+
+    if (!wordlist->acquired) {
+#ifdef HAVE_LIBURING
+        if (wordlist->use_uring) {
+            wordlist_uring_wait(wordlist, block);
+        } else
+#endif
+        {
+            pthread_mutex_lock(&wordlist->mutex);
+            while (block->state != WORDLIST_BLOCK_FILLED) {
+                pthread_cond_wait(&wordlist->filled, &wordlist->mutex);
+            }
+            pthread_mutex_unlock(&wordlist->mutex);
+        }
+
+        wordlist->acquired = true;
+        wordlist->consumer_offset = 0;
+    }
+
+    return block;
+}
+
+
+/**                         [Private] wordlist_release(wordlist_t*);
+ *
+ *  Requires:               - wordlist_acquire(wordlist_t*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that hands the fully consumed block back to the reader, which immediately
+ *                          starts refilling it with the data following the last block in flight.
+ *
+ *  @param wordlist:        wordlist whose current block has to be released.
+ */
+static void wordlist_release(wordlist_t *wordlist) {
+    wordlist_block_t *block = &wordlist->blocks[wordlist->consumer_block];
+
+#ifdef HAVE_LIBURING
+    if (wordlist->use_uring) {
+        block->state = WORDLIST_BLOCK_FREE;
+        wordlist_uring_submit(wordlist, block);
+    } else
+#endif
+    {
+        pthread_mutex_lock(&wordlist->mutex);
+        block->state = WORDLIST_BLOCK_FREE;
+        pthread_cond_signal(&wordlist->freed);
+        pthread_mutex_unlock(&wordlist->mutex);
+    }
+
+    wordlist->acquired = false;
+    wordlist->consumer_block = (wordlist->consumer_block + 1) % WORDLIST_BLOCKS_IN_FLIGHT;
+}
+
+
+/**                         [Private] wordlist_read_bytes(wordlist_t*, unsigned char*, uint32_t);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Utility function that copies the next [length] bytes of the wordlist into destination,
+ *                          crossing block boundaries if needed.
+ *
+ *  @param wordlist:        wordlist the bytes have to be read from.
+ *  @param destination:     output buffer of at least [length] bytes.
+ *  @param length:          number of bytes that have to be copied.
+ *  @return:                number of bytes copied (less than length only at the end of the wordlist), -1 on read error.
+ */
+static int64_t wordlist_read_bytes(wordlist_t *wordlist, unsigned char *destination, uint32_t length) {
+    wordlist_block_t *block;
+    uint64_t chunk_len;
+    uint32_t copied = 0;
+
+    while (copied < length && !wordlist->finished) {
+        block = wordlist_acquire(wordlist);
+
+        if (wordlist->consumer_offset == block->length) {
+            if (block->last) {
+                wordlist->finished = true;
+                if (block->error) {
+                    return -1;
+                }
+                break;
+            }
+            wordlist_release(wordlist);
+            continue;
+        }
+
+        chunk_len = block->length - wordlist->consumer_offset;
+        if (chunk_len > length - copied) chunk_len = length - copied;
+
+        memcpy(destination + copied, block->data + wordlist->consumer_offset, chunk_len);
+        wordlist->consumer_offset += chunk_len;
+        copied += chunk_len;
+    }
+
+    return copied;
+}
+
+
+/**                         [Private] wordlist_next_binary(wordlist_t*, unsigned char*, uint32_t, uint32_t*);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Reads the next record of a compiled wordlist: no line terminator has to be searched and
+ *                          the lengths have already been validated when the wordlist was compiled. Records hold
+ *                          passphrases or raw PSKs of PSK_HEX_LENGTH hex digits; the ones not fitting in the buffer
+ *                          are skipped, as longer lines are.
+ *
+ *  @param wordlist:        compiled wordlist the record has to be read from.
+ *  @param password:        output buffer, NULL terminated on success.
+ *  @param size:            size of the output buffer (at least MAX_LENGTH).
+ *  @param strlen_password: output length of the password.
+ *  @return:                1 if a record was read, 0 at the end of the wordlist, -1 on read error or corrupted record.
+ */
+static int wordlist_next_binary(wordlist_t *wordlist, unsigned char *password, uint32_t size,
+                                uint32_t *strlen_password) {
+    unsigned char length, skipped[PSK_HEX_LENGTH];
+    int64_t nread;
+
+    for (;;) {
+        nread = wordlist_read_bytes(wordlist, &length, 1);
+        if (nread != 1) {
+            return (int) nread;
+        }
+
+        if (length > PSK_HEX_LENGTH) {
+            return -1;
+        }
+
+        if (length < size) break;
+
+        if (wordlist_read_bytes(wordlist, skipped, length) != length) {
+            return -1;
+        }
+    }
+
+    if (wordlist_read_bytes(wordlist, password, length) != length) {
+        return -1;
+    }
+
+    password[length] = '\0';
+    *strlen_password = length;
+
+    return 1;
+}
+
+
+/**                         wordlist_next_line(wordlist_t*, unsigned char*, uint32_t, uint32_t*);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Replacement for fgets over the prefetched blocks: copies the next line of the wordlist into
+ *                          password, stripped of its line terminator ("\n" or "\r\n"). Lines may span two blocks.
+ *                          Lines not fitting in the buffer are skipped. Compiled wordlists, recognized by
+ *                          WORDLIST_BINARY_MAGIC, are read record by record instead.
+ *
+ *  @param wordlist:        wordlist the line has to be read from.
+ *  @param password:        output buffer, NULL terminated on success.
+ *  @param size:            size of the output buffer (at least MAX_LENGTH), longer lines are skipped.
+ *  @param strlen_password: output length of the line, terminator excluded.
+ *  @return:                1 if a line was read, 0 at the end of the wordlist, -1 on read error.
+ */
+int wordlist_next_line(wordlist_t *wordlist, unsigned char *password, uint32_t size, uint32_t *strlen_password) {
+    wordlist_block_t *block;
+    unsigned char *start, *new_line;
+    uint64_t chunk_len;
+    uint32_t length = 0;
+    bit_t overflow = false, cr = false;
+
+    if (!wordlist->started) {
+        wordlist->started = true;
+        block = wordlist_acquire(wordlist);
+
+        if (block->length >= WORDLIST_BINARY_MAGIC_LEN
+            && memcmp(block->data, WORDLIST_BINARY_MAGIC, WORDLIST_BINARY_MAGIC_LEN) == 0) {
+            wordlist->binary = true;
+            wordlist->consumer_offset = WORDLIST_BINARY_MAGIC_LEN;
+        }
+    }
+
+    if (wordlist->binary) {
+        return wordlist_next_binary(wordlist, password, size, strlen_password);
+    }
+
+    while (!wordlist->finished) {
+        block = wordlist_acquire(wordlist);
+
+        if (wordlist->consumer_offset == block->length) {
+            if (block->last) {
+                wordlist->finished = true;
+                if (block->error) {
+                    return -1;
+                }
+                break;
+            }
+            wordlist_release(wordlist);
+            continue;
+        }
+
+        start = block->data + wordlist->consumer_offset;
+        new_line = (unsigned char *) memchr(start, '\n', block->length - wordlist->consumer_offset);
+        chunk_len = (new_line ? new_line : block->data + block->length) - start;
+
+        if (overflow || (cr && chunk_len > 0)) {
+            overflow = true;
+        } else if (length + chunk_len < size) {
+            memcpy(password + length, start, chunk_len);
+            length += chunk_len;
+        } else if (length + chunk_len == size && start[chunk_len - 1] == '\r') {
+            /* Only the '\r' of a "\r\n" terminator does not fit, it is stripped anyway */
+            memcpy(password + length, start, chunk_len - 1);
+            length += chunk_len - 1;
+            cr = true;
+        } else {
+            overflow = true;
+        }
+
+        wordlist->consumer_offset += chunk_len;
+
+        if (new_line) {
+            wordlist->consumer_offset++;
+
+            if (overflow) {
+                length = 0;
+                overflow = false;
+                cr = false;
+                continue;
+            }
+
+            break;
+        }
+    }
+
+    if (wordlist->finished && (length == 0 || overflow)) {
+        return 0;
+    }
+
+    if (!cr && length > 0 && password[length - 1] == '\r') {
+        length--;
+    }
+
+    password[length] = '\0';
+    *strlen_password = length;
+
+    return 1;
+}
+
+
+/**                         wordlist_next(wordlist_t*, unsigned char[MAX_LENGTH], uint32_t*);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Reads the next passphrase of the wordlist: lines longer than MAX_LENGTH - 1 characters can
+ *                          not be valid passphrases and are skipped.
+ *
+ *  @param wordlist:        wordlist the line has to be read from.
+ *  @param password:        output buffer, NULL terminated on success.
+ *  @param strlen_password: output length of the line, terminator excluded.
+ *  @return:                1 if a line was read, 0 at the end of the wordlist, -1 on read error.
+ */
+int wordlist_next(wordlist_t *wordlist, unsigned char password[MAX_LENGTH], uint32_t *strlen_password) {
+    return wordlist_next_line(wordlist, password, MAX_LENGTH, strlen_password);
+}
+
+
+/**                         wordlist_close(wordlist_t*);
+ *
+ *  Requires:               - wordlist_open(wordlist_t*, const char*);
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Stops the reader, waiting for the reads still in flight, and disposes the blocks.
+ *
+ *  @param wordlist:        wordlist that has to be closed.
+ */
+void wordlist_close(wordlist_t *wordlist) {
+    uint32_t i;
+
+#ifdef HAVE_LIBURING
+    if (wordlist->use_uring) {
+        for (i = 0; i < WORDLIST_BLOCKS_IN_FLIGHT; i++) {
+            wordlist_uring_wait(wordlist, &wordlist->blocks[i]);
+        }
+        io_uring_queue_exit(&wordlist->ring);
+    } else
+#endif
+    {
+        pthread_mutex_lock(&wordlist->mutex);
+        wordlist->stop = true;
+        pthread_cond_broadcast(&wordlist->freed);
+        pthread_mutex_unlock(&wordlist->mutex);
+
+        pthread_join(wordlist->thread, NULL);
+
+        pthread_cond_destroy(&wordlist->freed);
+        pthread_cond_destroy(&wordlist->filled);
+        pthread_mutex_destroy(&wordlist->mutex);
+    }
+
+    for (i = 0; i < WORDLIST_BLOCKS_IN_FLIGHT; i++) {
+        free(wordlist->blocks[i].data);
+    }
+
+    close(wordlist->fd);
+}
+
+
+/**                         [Private] wordlist_filter_hidden(const struct dirent*);
+ *
+ *  Requires:               []
+ *
+ *  Allows:                 []
+ *
+ *  Description:            scandir filter discarding hidden entries (".", ".." included).
+ *
+ *  @param entry:           directory entry that has to be evaluated.
+ *  @return:                0 if the entry is hidden, 1 otherwise.
+ */
+static int wordlist_filter_hidden(const struct dirent *entry) {
+    return entry->d_name[0] != '.';
+}
+
+
+/**                         wordlist_expand_path(const char*, char***, uint32_t*);
+ *
+ *  Requires:               [*paths either NULL or allocated with malloc, holding *paths_cnt entries.]
+ *
+ *  Allows:                 []
+ *
+ *  Description:            Appends to the list of wordlists either the given file or, if path is a directory, every
+ *                          regular file it contains (hidden files excluded) in alphabetical order, so that a directory
+ *                          of wordlists is always processed in the same order.
+ *
+ *  @param path:            wordlist file or directory of wordlists.
+ *  @param paths:           dynamic array of wordlist names the result has to be appended to (names are malloc'ed).
+ *  @param paths_cnt:       number of entries in paths, updated by the function.
+ *  @return:                0 on success, -1 if path could not be accessed.
+ */
+int wordlist_expand_path(const char *path, char ***paths, uint32_t *paths_cnt) {
+    struct dirent **entries;
+    struct stat st;
+    char *name;
+    int entries_cnt, i;
+
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        *paths = (char **) realloc(*paths, (*paths_cnt + 1) * sizeof(char *));
+        (*paths)[(*paths_cnt)++] = strdup(path);
+        return 0;
+    }
+
+    entries_cnt = scandir(path, &entries, wordlist_filter_hidden, alphasort);
+    if (entries_cnt < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < entries_cnt; i++) {
+        name = (char *) malloc(strlen(path) + strlen(entries[i]->d_name) + 2);
+        sprintf(name, "%s/%s", path, entries[i]->d_name);
+
+        if (stat(name, &st) == 0 && S_ISREG(st.st_mode)) {
+            *paths = (char **) realloc(*paths, (*paths_cnt + 1) * sizeof(char *));
+            (*paths)[(*paths_cnt)++] = name;
+        } else {
+            free(name);
+        }
+
+        free(entries[i]);
+    }
+    free(entries);
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+#ifndef WORDLIST_H
+#define WORDLIST_H
+
+/** Includes */
+#include <pthread.h>
+#include "pbkdf2.h"
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/** Defines */
+/** Size in bytes of a single wordlist block read from storage */
+#define WORDLIST_BLOCK_SIZE             (4 * 1024 * 1024)
+
+/** Number of blocks kept in flight ahead of the consumer */
+#define WORDLIST_BLOCKS_IN_FLIGHT       4
+
+/** Block is owned by nobody and can be filled by the reader */
+#define WORDLIST_BLOCK_FREE             0
+
+/** Block is being filled by the reader (read-ahead thread or in flight in the io_uring) */
+#define WORDLIST_BLOCK_PENDING          1
+
+/** Block has been filled and can be consumed */
+#define WORDLIST_BLOCK_FILLED           2
+
+/** Magic number opening compiled wordlists, made of [1 byte length][password] records instead of text lines */
+#define WORDLIST_BINARY_MAGIC           "WPA2WL\x00\x01"
+
+/** Length of WORDLIST_BINARY_MAGIC */
+#define WORDLIST_BINARY_MAGIC_LEN       8
+
+/**
+ * Definition of the structure wordlist_block_t, containing:
+ *
+ *  - data:                 buffer of [WORDLIST_BLOCK_SIZE] bytes holding a contiguous slice of the wordlist file.
+ *
+ *  - offset:               offset in the file of the first byte held in data.
+ *
+ *  - length:               number of valid bytes in data.
+ *
+ *  - state:                one of WORDLIST_BLOCK_FREE, WORDLIST_BLOCK_PENDING or WORDLIST_BLOCK_FILLED.
+ *
+ *  - last:                 true if no more data follows this block (end of file or read error).
+ *
+ *  - error:                true if the read that filled this block failed.
+ */
+typedef struct {
+    unsigned char *data;
+    uint64_t offset;
+    uint64_t length;
+    uint8_t state;
+    bit_t last;
+    bit_t error;
+} wordlist_block_t;
+
+/**
+ * Definition of the structure wordlist_t, containing:
+ *
+ *  - path:                 name of the wordlist file, used for error reporting.
+ *
+ *  - fd:                   file descriptor of the wordlist file.
+ *
+ *  - blocks:               ring of [WORDLIST_BLOCKS_IN_FLIGHT] blocks shared between the reader and the consumer.
+ *
+ *  - consumer_block:       index in the ring of the block currently being consumed.
+ *
+ *  - consumer_offset:      offset of the next unread byte within the block currently being consumed.
+ *
+ *  - acquired:             true if the consumer owns blocks[consumer_block].
+ *
+ *  - finished:             true once the consumer went past the last block.
+ *
+ *  - started:              true once the format of the wordlist has been detected.
+ *
+ *  - binary:               true if the wordlist is in the compiled format (WORDLIST_BINARY_MAGIC) rather than text.
+ *
+ *  - thread:               read-ahead thread filling the blocks in ring order.
+ *
+ *  - mutex, filled, freed: synchronization between the read-ahead thread and the consumer.
+ *
+ *  - stop:                 set by wordlist_close in order to terminate the read-ahead thread.
+ *
+ *  - use_uring:            true if the blocks are filled by asynchronous reads submitted to an io_uring instead of by
+ *                          the read-ahead thread.
+ *
+ *  - ring, file_size, next_offset: io_uring instance, size of the file and offset of the next read to be submitted
+ *                          (only with HAVE_LIBURING).
+ */
+typedef struct {
+    const char *path;
+    int fd;
+    wordlist_block_t blocks[WORDLIST_BLOCKS_IN_FLIGHT];
+    uint32_t consumer_block;
+    uint64_t consumer_offset;
+    bit_t acquired;
+    bit_t finished;
+    bit_t started;
+    bit_t binary;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t filled;
+    pthread_cond_t freed;
+    bit_t stop;
+    bit_t use_uring;
+#ifdef HAVE_LIBURING
+    struct io_uring ring;
+    uint64_t file_size;
+    uint64_t next_offset;
+#endif
+} wordlist_t;
+
+/** Function declarations */
+int wordlist_open(wordlist_t *wordlist, const char *path);
+
+int wordlist_next_line(wordlist_t *wordlist, unsigned char *password, uint32_t size, uint32_t *strlen_password);
+
+int wordlist_next(wordlist_t *wordlist, unsigned char password[MAX_LENGTH], uint32_t *strlen_password);
+
+void wordlist_close(wordlist_t *wordlist);
+
+int wordlist_expand_path(const char *path, char ***paths, uint32_t *paths_cnt);
+
+#endif /* WORDLIST_H */